@@ -32,9 +32,12 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
-#if HAVE_THP
+#if HAVE_THP || HAVE_NUMA
 #include <sys/mman.h>
 #endif
+#if HAVE_NUMA
+#include <numa.h>
+#endif
 
 const int x264_bit_depth = BIT_DEPTH;
 
@@ -56,6 +59,7 @@ void x264_param_default( x264_param_t *param )
     param->i_lookahead_threads = X264_THREADS_AUTO;
     param->b_deterministic = 1;
     param->i_sync_lookahead = X264_SYNC_LOOKAHEAD_AUTO;
+    param->i_numa_node = -1;
 
     /* Video properties */
     param->i_csp           = X264_CHROMA_FORMAT ? X264_CHROMA_FORMAT : X264_CSP_I420;
@@ -117,6 +121,8 @@ void x264_param_default( x264_param_t *param )
     param->rc.psz_stat_out = "x264_2pass.log";
     param->rc.b_stat_read = 0;
     param->rc.psz_stat_in = "x264_2pass.log";
+    param->rc.b_stat_binary = 0;
+    param->rc.i_chunk_start = -1;
     param->rc.f_qcompress = 0.6;
     param->rc.f_qblur = 0.5;
     param->rc.f_complexity_blur = 20;
@@ -129,6 +135,10 @@ void x264_param_default( x264_param_t *param )
     param->i_log_level = X264_LOG_INFO;
     param->i_csv_log_level = 0;
     param->csv_filename = NULL;
+    param->psz_analysis_save = NULL;
+    param->psz_analysis_load = NULL;
+    param->psz_lookahead_save = NULL;
+    param->psz_lookahead_load = NULL;
 
     /* */
     param->analyse.intra = X264_ANALYSE_I4x4 | X264_ANALYSE_I8x8;
@@ -142,11 +152,13 @@ void x264_param_default( x264_param_t *param )
     param->analyse.i_me_range = 16;
     param->analyse.i_subpel_refine = 7;
     param->analyse.b_mixed_references = 1;
+    param->analyse.b_me_multiref = 0;
     param->analyse.b_chroma_me = 1;
     param->analyse.i_mv_range_thread = -1;
     param->analyse.i_mv_range = -1; // set from level_idc
     param->analyse.i_chroma_qp_offset = 0;
     param->analyse.b_fast_pskip = 1;
+    param->analyse.b_adaptive_partitions = 0;
     param->analyse.b_weighted_bipred = 1;
     param->analyse.i_weighted_pred = X264_WEIGHTP_SMART;
     param->analyse.b_dct_decimate = 1;
@@ -666,6 +678,12 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
         else
             p->i_sync_lookahead = atoi(value);
     }
+    OPT("frame-pool-budget")
+        p->i_frame_pool_budget = atoi(value);
+    OPT("huge-pages")
+        p->b_huge_pages = atobool(value);
+    OPT("numa-node")
+        p->i_numa_node = atoi(value);
     OPT2("deterministic", "n-deterministic")
         p->b_deterministic = atobool(value);
     OPT("cpu-independent")
@@ -893,6 +911,14 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
         p->i_csv_log_level = atoi(value);
     OPT("csv")
         p->csv_filename = strdup(value);
+    OPT("analysis-save")
+        p->psz_analysis_save = strdup(value);
+    OPT("analysis-load")
+        p->psz_analysis_load = strdup(value);
+    OPT("lookahead-save")
+        p->psz_lookahead_save = strdup(value);
+    OPT("lookahead-load")
+        p->psz_lookahead_load = strdup(value);
     OPT("dump-yuv")
         p->psz_dump_yuv = strdup(value);
     OPT2("analyse", "partitions")
@@ -949,10 +975,14 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
         p->analyse.b_chroma_me = atobool(value);
     OPT("mixed-refs")
         p->analyse.b_mixed_references = atobool(value);
+    OPT("me-multiref")
+        p->analyse.b_me_multiref = atobool(value);
     OPT("trellis")
         p->analyse.i_trellis = atoi(value);
     OPT("fast-pskip")
         p->analyse.b_fast_pskip = atobool(value);
+    OPT("adaptive-partitions")
+        p->analyse.b_adaptive_partitions = atobool(value);
     OPT("dct-decimate")
         p->analyse.b_dct_decimate = atobool(value);
     OPT("deadzone-inter")
@@ -1013,6 +1043,10 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
         p->rc.psz_stat_in = strdup(value);
         p->rc.psz_stat_out = strdup(value);
     }
+    OPT("stats-binary")
+        p->rc.b_stat_binary = atobool(value);
+    OPT("chunk-start")
+        p->rc.i_chunk_start = atoi(value);
     OPT("qcomp")
         p->rc.f_qcompress = atof(value);
     OPT("mbtree")
@@ -1250,6 +1284,95 @@ void x264_free( void *p )
     }
 }
 
+/****************************************************************************
+ * x264_malloc_placed:
+ *  like x264_malloc, but optionally backed by explicit huge pages and/or bound
+ *  to a NUMA node.  *pi_mapped is set to the mapping size to pass to
+ *  x264_free_placed, or 0 if the buffer came from x264_malloc.
+ ****************************************************************************/
+void *x264_malloc_placed( int64_t i_size, int b_huge_pages, int i_numa_node, int64_t *pi_mapped )
+{
+    *pi_mapped = 0;
+#if HAVE_THP || HAVE_NUMA
+    if( b_huge_pages || i_numa_node >= 0 )
+    {
+        uint8_t *buf = MAP_FAILED;
+        size_t map_size = 0;
+#ifdef MAP_HUGETLB
+#define HUGE_PAGE_SIZE 2*1024*1024
+        if( b_huge_pages )
+        {
+            /* Explicit huge pages need a preallocated hugetlbfs pool; fall back silently if it's empty. */
+            map_size = (i_size + HUGE_PAGE_SIZE - 1) & ~(int64_t)(HUGE_PAGE_SIZE - 1);
+            buf = mmap( NULL, map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0 );
+        }
+#undef HUGE_PAGE_SIZE
+#endif
+        if( buf == MAP_FAILED && i_numa_node >= 0 )
+        {
+            map_size = (i_size + 4095) & ~(int64_t)4095;
+            buf = mmap( NULL, map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+#if HAVE_THP
+            if( buf != MAP_FAILED && b_huge_pages )
+                madvise( buf, map_size, MADV_HUGEPAGE );
+#endif
+        }
+        if( buf != MAP_FAILED )
+        {
+#if HAVE_NUMA
+            /* Bind before first touch so that the pages are faulted in on the requested node. */
+            if( i_numa_node >= 0 )
+                numa_tonode_memory( buf, map_size, i_numa_node );
+#endif
+            *pi_mapped = map_size;
+            return buf;
+        }
+    }
+#endif
+    return x264_malloc( i_size );
+}
+
+/****************************************************************************
+ * x264_free_placed:
+ ****************************************************************************/
+void x264_free_placed( void *p, int64_t i_mapped )
+{
+#if HAVE_THP || HAVE_NUMA
+    if( i_mapped )
+    {
+        munmap( p, i_mapped );
+        return;
+    }
+#endif
+    x264_free( p );
+}
+
+/****************************************************************************
+ * x264_numa_max_node:
+ ****************************************************************************/
+int x264_numa_max_node( void )
+{
+#if HAVE_NUMA
+    if( numa_available() >= 0 )
+        return numa_max_node();
+#endif
+    return -1;
+}
+
+/****************************************************************************
+ * x264_numa_bind_thread:
+ ****************************************************************************/
+void x264_numa_bind_thread( int i_numa_node )
+{
+#if HAVE_NUMA
+    if( i_numa_node >= 0 )
+    {
+        numa_run_on_node( i_numa_node );
+        numa_set_preferred( i_numa_node );
+    }
+#endif
+}
+
 /****************************************************************************
  * x264_reduce_fraction:
  ****************************************************************************/
@@ -1351,6 +1474,8 @@ char *x264_param2string( x264_param_t *p, int b_res )
     if( p->analyse.b_psy )
         s += sprintf( s, " psy_rd=%.2f:%.2f", p->analyse.f_psy_rd, p->analyse.f_psy_trellis );
     s += sprintf( s, " mixed_ref=%d", p->analyse.b_mixed_references );
+    if( p->analyse.b_me_multiref )
+        s += sprintf( s, " me_multiref=1" );
     s += sprintf( s, " me_range=%d", p->analyse.i_me_range );
     s += sprintf( s, " chroma_me=%d", p->analyse.b_chroma_me );
     s += sprintf( s, " trellis=%d", p->analyse.i_trellis );
@@ -1358,6 +1483,8 @@ char *x264_param2string( x264_param_t *p, int b_res )
     s += sprintf( s, " cqm=%d", p->i_cqm_preset );
     s += sprintf( s, " deadzone=%d,%d", p->analyse.i_luma_deadzone[0], p->analyse.i_luma_deadzone[1] );
     s += sprintf( s, " fast_pskip=%d", p->analyse.b_fast_pskip );
+    if( p->analyse.b_adaptive_partitions )
+        s += sprintf( s, " adaptive_partitions=1" );
     s += sprintf( s, " chroma_qp_offset=%d", p->analyse.i_chroma_qp_offset );
     s += sprintf( s, " threads=%d", p->i_threads );
     s += sprintf( s, " lookahead_threads=%d", p->i_lookahead_threads );
@@ -79,6 +79,15 @@ do {\
         *preallocs[prealloc_idx] += (intptr_t)ptr;\
 } while(0)
 
+#define PREALLOC_END_PLACED( ptr, mapped, b_huge_pages, i_numa_node )\
+do {\
+    ptr = x264_malloc_placed( prealloc_size, b_huge_pages, i_numa_node, &mapped );\
+    if( !ptr )\
+        goto fail;\
+    while( prealloc_idx-- )\
+        *preallocs[prealloc_idx] += (intptr_t)ptr;\
+} while(0)
+
 #define ARRAY_SIZE(array)  (sizeof(array)/sizeof(array[0]))
 
 #define X264_BFRAME_MAX 16
@@ -87,6 +96,7 @@ do {\
 #define X264_LOOKAHEAD_THREAD_MAX 16
 #define X264_PCM_COST (FRAME_SIZE(256*BIT_DEPTH)+16)
 #define X264_LOOKAHEAD_MAX 250
+#define X264_PART_STAT_BUCKETS 24 /* half-octaves of 16x16 cost/lambda */
 #define QP_BD_OFFSET (6*(BIT_DEPTH-8))
 #define QP_MAX_SPEC (51+QP_BD_OFFSET)
 #define QP_MAX (QP_MAX_SPEC+18)
@@ -132,6 +142,9 @@ do {\
 #   define PARAM_INTERLACED 0
 #endif
 
+/* esa and tesa, which need the fullpel mv costs and the integral images */
+#define ME_EXHAUSTIVE( method ) ((method) == X264_ME_ESA || (method) == X264_ME_TESA)
+
 #ifdef CHROMA_FORMAT
 #    define CHROMA_H_SHIFT (CHROMA_FORMAT == CHROMA_420 || CHROMA_FORMAT == CHROMA_422)
 #    define CHROMA_V_SHIFT (CHROMA_FORMAT == CHROMA_420)
@@ -253,12 +266,21 @@ static const uint8_t x264_scan8[16*3 + 3] =
  * you have to use x264_free for buffers allocated with x264_malloc */
 void *x264_malloc( int );
 void  x264_free( void * );
+/* x264_malloc_placed: huge page and/or NUMA node backed allocation, see common.c */
+void *x264_malloc_placed( int64_t i_size, int b_huge_pages, int i_numa_node, int64_t *pi_mapped );
+void  x264_free_placed( void *p, int64_t i_mapped );
+/* x264_numa_max_node: highest usable NUMA node, or -1 if NUMA is unavailable */
+int   x264_numa_max_node( void );
+/* x264_numa_bind_thread: run the calling thread on, and prefer memory from, the given node (if >= 0) */
+void  x264_numa_bind_thread( int i_numa_node );
 
 /* x264_slurp_file: malloc space for the whole file and read it */
 char *x264_slurp_file( const char *filename );
 
 /* mdate: return the current date in microsecond */
 int64_t x264_mdate( void );
+/* timestamp for per-stage timers, zero (and free) unless they are enabled */
+#define x264_stage_time(h) ((h)->param.i_csv_log_level >= 2 ? x264_mdate() : 0)
 
 /* x264_param2string: return a (malloced) string containing most of
  * the encoding options */
@@ -448,6 +470,15 @@ typedef struct x264_lookahead_t
 
 typedef struct x264_ratecontrol_t   x264_ratecontrol_t;
 
+/* Caller-provided output ring for escaped NALs, shared by all slice threads */
+typedef struct
+{
+    x264_pthread_mutex_t mutex;
+    uint8_t *p_buffer;
+    int      i_size;
+    int      i_pos;     /* offset the next NAL will be written at */
+} x264_nal_ring_t;
+
 typedef struct x264_left_table_t
 {
     uint8_t intra[4];
@@ -479,18 +510,66 @@ typedef struct
     int i_mb_field[3];
     /* Adaptive direct mv pred */
     int i_direct_score[2];
+    /* Adaptive partition decision */
+    int i_part_search;      /* P MBs whose sub-16x16 partitions were searched */
+    int i_part_skip;        /* P MBs whose search was skipped */
+    int i_part_probe;       /* searches run in contexts that would be skipped */
+    int i_part_probe_split; /* probes that ended in a split partition */
     /* Metrics */
     int64_t i_ssd[3];
     double f_ssim;
     int i_ssim_cnt;
+    /* Frame threading stalls on reference rows */
+    int64_t i_stall_time;
+    int i_stall_count;
+    int i_stall_mvy_range; /* smallest vertical mv range that was available when a stall began */
 } x264_frame_stat_t;
 
+/* Current frame wall-clock stage times in microseconds */
+typedef struct
+{
+    int64_t i_analyse;
+    int64_t i_encode;
+    int64_t i_entropy;
+    int64_t i_filter;
+    int64_t i_wait;
+} x264_frame_time_t;
+
 struct x264_t
 {
     /* encoder parameters */
     x264_param_t    param;
 
     FILE            *csvfh;
+
+    /* --analysis-save/--analysis-load */
+    struct
+    {
+        FILE        *fh_save;
+        FILE        *fh_load;
+        int64_t     *p_offset;      /* file offset of each loaded frame, -1 if missing */
+        int         i_offsets;
+        int         i_width;        /* resolution of the loaded analysis */
+        int         i_height;
+        int         i_mb_width;
+        int         i_mb_height;
+        x264_analysis_mb_t *p_buffer; /* one frame of loaded records */
+    } analysis;
+
+    /* --lookahead-save/--lookahead-load */
+    struct
+    {
+        FILE        *fh_save;
+        FILE        *fh_load;
+        uint8_t     *p_map;         /* the loaded file, if it could be mapped */
+        int64_t     i_map_size;
+        int64_t     *p_offset;      /* file offset of each loaded frame's record, -1 if missing */
+        int8_t      *p_type;        /* type of each loaded frame */
+        int         i_frames;
+        int         i_record_size;
+        int         b_planned;      /* records hold VBV lookahead plans */
+        uint8_t     *p_record;      /* record being written */
+    } lookahead_cache;
     x264_t          *thread[X264_THREAD_MAX+1];
     x264_t          *lookahead_thread[X264_LOOKAHEAD_THREAD_MAX];
     int             b_thread_active;
@@ -517,6 +596,7 @@ struct x264_t
 
     uint8_t *nal_buffer;
     int      nal_buffer_size;
+    x264_nal_ring_t *nal_ring;
 
     x264_t          *reconfig_h;
     int             reconfig;
@@ -594,6 +674,9 @@ struct x264_t
         /* Unused blank frames (for duplicates) */
         x264_frame_t **blank_unused;
 
+        /* Accounting and budget for the unused lists */
+        x264_frame_pool_t *pool;
+
         /* frames used for reference + sentinels */
         x264_frame_t *reference[X264_REF_MAX+2];
 
@@ -616,6 +699,7 @@ struct x264_t
         int64_t i_largest_pts;
         int64_t i_second_largest_pts;
         int b_have_lowres;  /* Whether 1/2 resolution luma planes are being used */
+        int b_have_lowres_mvs; /* Whether fenc->lowres_mvs are set, by the lookahead or its cache */
         int b_have_sub8x8_esa;
     } frames;
 
@@ -894,6 +978,15 @@ struct x264_t
         uint64_t i_mb_psy_energy;
         uint64_t i_mb_res_energy;
 
+        /* --adaptive-partitions: outcomes of the sub-16x16 partition searches of
+         * P macroblocks, by number of split neighbours and bucket of 16x16 cost */
+        struct
+        {
+            uint16_t i_search;  /* searches run, halved as it saturates */
+            uint16_t i_split;   /* searches that ended in a split partition */
+            uint16_t i_skip;    /* searches skipped since the last probe */
+        } part_stat[3][X264_PART_STAT_BUCKETS];
+
     } mb;
 
     /* rate control encoding only */
@@ -931,9 +1024,20 @@ struct x264_t
         int     i_direct_frames[2];
         /* num p-frames weighted */
         int     i_wpred[2];
+        /* adaptive partition decision */
+        int64_t i_part_search;
+        int64_t i_part_skip;
+        int64_t i_part_probe;
+        int64_t i_part_probe_split;
+        /* frame threading stalls */
+        int64_t i_stall_time;
+        int64_t i_stall_count;
+        int     i_stall_frames;
+        int     i_stall_mvy_range;
 
         /* Current frame stats */
         x264_frame_stat_t frame;
+        x264_frame_time_t frame_time;
     } stat;
 
     /* 0 = luma 4x4, 1 = luma 8x8, 2 = chroma 4x4, 3 = chroma 8x8 */
@@ -69,6 +69,7 @@ const x264_cpu_name_t x264_cpu_names[] =
     {"FMA4",        AVX|X264_CPU_FMA4},
     {"FMA3",        AVX|X264_CPU_FMA3},
     {"AVX2",        AVX|X264_CPU_FMA3|X264_CPU_AVX2},
+    {"AVX512",      AVX|X264_CPU_FMA3|X264_CPU_AVX2|X264_CPU_AVX512},
 #undef AVX
 #undef SSE2
 #undef MMX2
@@ -128,6 +129,7 @@ uint32_t x264_cpu_detect( void )
     uint32_t eax, ebx, ecx, edx;
     uint32_t vendor[4] = {0};
     uint32_t max_extended_cap, max_basic_cap;
+    uint32_t xcr0 = 0;
     int cache;
 
 #if !ARCH_X86_64
@@ -165,8 +167,8 @@ uint32_t x264_cpu_detect( void )
     if( (ecx&0x18000000) == 0x18000000 )
     {
         /* Check for OS support */
-        x264_cpu_xgetbv( 0, &eax, &edx );
-        if( (eax&0x6) == 0x6 )
+        x264_cpu_xgetbv( 0, &xcr0, &edx );
+        if( (xcr0&0x6) == 0x6 )
         {
             cpu |= X264_CPU_AVX;
             if( ecx&0x00001000 )
@@ -180,6 +182,9 @@ uint32_t x264_cpu_detect( void )
         /* AVX2 requires OS support, but BMI1/2 don't. */
         if( (cpu&X264_CPU_AVX) && (ebx&0x00000020) )
             cpu |= X264_CPU_AVX2;
+        /* AVX-512 F, DQ, CD, BW and VL, plus OS support for the opmask and zmm state. */
+        if( (cpu&X264_CPU_AVX2) && (xcr0&0xe0) == 0xe0 && (ebx&0xd0030000) == 0xd0030000 )
+            cpu |= X264_CPU_AVX512;
         if( ebx&0x00000008 )
         {
             cpu |= X264_CPU_BMI1;
@@ -200,15 +200,21 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         PREALLOC( frame->i_row_bits, i_lines/16 * sizeof(int) );
         PREALLOC( frame->f_row_qp, i_lines/16 * sizeof(float) );
         PREALLOC( frame->f_row_qscale, i_lines/16 * sizeof(float) );
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
             PREALLOC( frame->buffer[3], frame->i_stride[0] * (frame->i_lines[0] + 2*i_padv) * sizeof(uint16_t) << h->frames.b_have_sub8x8_esa );
         if( PARAM_INTERLACED )
             PREALLOC( frame->field, i_mb_count * sizeof(uint8_t) );
         if( h->param.analyse.b_mb_info )
             PREALLOC( frame->effective_qp, i_mb_count * sizeof(uint8_t) );
+        if( h->param.psz_analysis_save )
+            PREALLOC( frame->analysis, i_mb_count * sizeof(x264_analysis_mb_t) );
     }
     else /* fenc frame */
     {
+        if( h->frames.b_have_lowres_mvs )
+            for( int j = 0; j <= !!h->param.i_bframe; j++ )
+                for( int i = 0; i <= h->param.i_bframe; i++ )
+                    PREALLOC( frame->lowres_mvs[j][i], 2*h->mb.i_mb_count*sizeof(int16_t) );
         if( h->frames.b_have_lowres )
         {
             int luma_plane_size = align_plane_size( frame->i_stride_lowres * (frame->i_lines[0]/2 + 2*PADV), disalign );
@@ -217,10 +223,7 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
 
             for( int j = 0; j <= !!h->param.i_bframe; j++ )
                 for( int i = 0; i <= h->param.i_bframe; i++ )
-                {
-                    PREALLOC( frame->lowres_mvs[j][i], 2*h->mb.i_mb_count*sizeof(int16_t) );
                     PREALLOC( frame->lowres_mv_costs[j][i], h->mb.i_mb_count*sizeof(int) );
-                }
             PREALLOC( frame->i_propagate_cost, (i_mb_count+7) * sizeof(uint16_t) );
             for( int j = 0; j <= h->param.i_bframe+1; j++ )
                 for( int i = 0; i <= h->param.i_bframe+1; i++ )
@@ -234,9 +237,12 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
             if( h->frames.b_have_lowres )
                 PREALLOC( frame->i_inv_qscale_factor, (h->mb.i_mb_count+3) * sizeof(uint16_t) );
         }
+        if( h->param.psz_analysis_load )
+            PREALLOC( frame->analysis, i_mb_count * sizeof(x264_analysis_mb_t) );
     }
 
-    PREALLOC_END( frame->base );
+    PREALLOC_END_PLACED( frame->base, frame->i_base_mapped, h->param.b_huge_pages, h->param.i_numa_node );
+    frame->i_alloc_size = sizeof(x264_frame_t) + prealloc_size;
 
     if( i_csp == X264_CSP_NV12 || i_csp == X264_CSP_NV16 )
     {
@@ -271,7 +277,7 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         M32( frame->mv16x16[0] ) = 0;
         frame->mv16x16++;
 
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
             frame->integral = (uint16_t*)frame->buffer[3] + frame->i_stride[0] * i_padv + PADH;
     }
     else
@@ -317,7 +323,7 @@ void x264_frame_delete( x264_frame_t *frame )
      * so freeing those pointers would cause a double free later. */
     if( !frame->b_duplicate )
     {
-        x264_free( frame->base );
+        x264_free_placed( frame->base, frame->i_base_mapped );
 
         if( frame->param && frame->param->param_free )
             frame->param->param_free( frame->param );
@@ -406,6 +412,10 @@ int x264_frame_copy_picture( x264_t *h, x264_frame_t *dst, x264_picture_t *src )
     dst->mb_info    = h->param.analyse.b_mb_info ? src->prop.mb_info : NULL;
     dst->mb_info_free = h->param.analyse.b_mb_info ? src->prop.mb_info_free : NULL;
 
+    /* Zero-copy input: the image was written directly into this frame. */
+    if( (pixel*)src->img.plane[0] == dst->plane[0] )
+        return 0;
+
     uint8_t *pix[3];
     int stride[3];
     if( i_csp == X264_CSP_V210 )
@@ -681,12 +691,23 @@ void x264_frame_cond_broadcast( x264_frame_t *frame, int i_lines_completed )
     x264_pthread_mutex_unlock( &frame->mutex );
 }
 
-void x264_frame_cond_wait( x264_frame_t *frame, int i_lines_completed )
+/* Returns the time in microseconds spent blocked (at least 1 if it blocked at all),
+ * and the number of lines that were available when it started to block. */
+int64_t x264_frame_cond_wait( x264_frame_t *frame, int i_lines_completed, int *pi_lines_available )
 {
+    int64_t i_stall = 0;
     x264_pthread_mutex_lock( &frame->mutex );
-    while( frame->i_lines_completed < i_lines_completed )
-        x264_pthread_cond_wait( &frame->cv, &frame->mutex );
+    if( frame->i_lines_completed < i_lines_completed )
+    {
+        int64_t i_start = x264_mdate();
+        if( pi_lines_available )
+            *pi_lines_available = frame->i_lines_completed;
+        while( frame->i_lines_completed < i_lines_completed )
+            x264_pthread_cond_wait( &frame->cv, &frame->mutex );
+        i_stall = X264_MAX( x264_mdate() - i_start, 1 );
+    }
     x264_pthread_mutex_unlock( &frame->mutex );
+    return i_stall;
 }
 
 void x264_threadslice_cond_broadcast( x264_t *h, int pass )
@@ -765,24 +786,79 @@ void x264_frame_push_unused( x264_t *h, x264_frame_t *frame )
     assert( frame->i_reference_count > 0 );
     frame->i_reference_count--;
     if( frame->i_reference_count == 0 )
+    {
+        /* The caller may still read the frame after releasing it (frame_end reads
+         * fenc), so it is always pooled here; x264_frame_pop_unused evicts. */
+        x264_frame_pool_t *pool = h->frames.pool;
+        x264_pthread_mutex_lock( &pool->mutex );
         x264_frame_push( h->frames.unused[frame->b_fdec], frame );
+        pool->stats.i_pooled_bytes += frame->i_alloc_size;
+        x264_pthread_mutex_unlock( &pool->mutex );
+    }
+}
+
+/* Takes one idle frame out of the pool if it holds more than the budget. */
+static x264_frame_t *x264_frame_pool_evict( x264_t *h )
+{
+    x264_frame_pool_t *pool = h->frames.pool;
+    x264_frame_t *frame = NULL;
+    x264_pthread_mutex_lock( &pool->mutex );
+    if( pool->stats.i_budget && pool->stats.i_pooled_bytes > pool->stats.i_budget )
+        for( int i = 0; i < 2 && !frame; i++ )
+            if( h->frames.unused[i][0] )
+            {
+                frame = x264_frame_shift( h->frames.unused[i] );
+                pool->stats.i_evictions[i]++;
+                pool->stats.i_bytes[i] -= frame->i_alloc_size;
+                pool->stats.i_frames[i]--;
+                pool->stats.i_pooled_bytes -= frame->i_alloc_size;
+            }
+    x264_pthread_mutex_unlock( &pool->mutex );
+    return frame;
+}
+
+static void x264_frame_pool_alloc( x264_frame_pool_t *pool, int i_type, int64_t i_size )
+{
+    x264_frame_pool_stats_t *stats = &pool->stats;
+    x264_pthread_mutex_lock( &pool->mutex );
+    stats->i_allocs[i_type]++;
+    stats->i_frames[i_type]++;
+    stats->i_bytes[i_type] += i_size;
+    stats->i_peak_bytes = X264_MAX( stats->i_peak_bytes, stats->i_bytes[0] + stats->i_bytes[1] + stats->i_bytes[2] );
+    x264_pthread_mutex_unlock( &pool->mutex );
 }
 
 x264_frame_t *x264_frame_pop_unused( x264_t *h, int b_fdec )
 {
-    x264_frame_t *frame;
+    x264_frame_pool_t *pool = h->frames.pool;
+    x264_frame_t *frame = NULL;
+    x264_frame_t *evicted;
+    x264_pthread_mutex_lock( &pool->mutex );
     if( h->frames.unused[b_fdec][0] )
+    {
         frame = x264_frame_pop( h->frames.unused[b_fdec] );
-    else
-        frame = x264_frame_new( h, b_fdec );
+        pool->stats.i_reuses[b_fdec]++;
+        pool->stats.i_pooled_bytes -= frame->i_alloc_size;
+    }
+    x264_pthread_mutex_unlock( &pool->mutex );
+    /* Frames are only popped by the main thread between frames, once every
+     * earlier release has finished with its frame, so it is safe to free here. */
+    while( (evicted = x264_frame_pool_evict( h )) )
+        x264_frame_delete( evicted );
     if( !frame )
-        return NULL;
+    {
+        frame = x264_frame_new( h, b_fdec );
+        if( !frame )
+            return NULL;
+        x264_frame_pool_alloc( pool, b_fdec, frame->i_alloc_size );
+    }
     frame->b_last_minigop_bframe = 0;
     frame->i_reference_count = 1;
     frame->b_intra_calculated = 0;
     frame->b_scenecut = 1;
     frame->b_keyframe = 0;
     frame->b_corrupt = 0;
+    frame->i_lookahead_time = 0;
     frame->i_slice_count = h->param.b_sliced_threads ? h->param.i_threads : 1;
 
     memset( frame->weight, 0, sizeof(frame->weight) );
@@ -803,16 +879,46 @@ x264_frame_t *x264_frame_pop_blank_unused( x264_t *h )
 {
     x264_frame_t *frame;
     if( h->frames.blank_unused[0] )
+    {
         frame = x264_frame_pop( h->frames.blank_unused );
+        x264_pthread_mutex_lock( &h->frames.pool->mutex );
+        h->frames.pool->stats.i_reuses[X264_FRAME_POOL_BLANK]++;
+        x264_pthread_mutex_unlock( &h->frames.pool->mutex );
+    }
     else
+    {
         frame = x264_malloc( sizeof(x264_frame_t) );
-    if( !frame )
-        return NULL;
+        if( !frame )
+            return NULL;
+        x264_frame_pool_alloc( h->frames.pool, X264_FRAME_POOL_BLANK, sizeof(x264_frame_t) );
+    }
     frame->b_duplicate = 1;
     frame->i_reference_count = 1;
     return frame;
 }
 
+int x264_frame_pool_init( x264_t *h )
+{
+    CHECKED_MALLOCZERO( h->frames.pool, sizeof(x264_frame_pool_t) );
+    if( x264_pthread_mutex_init( &h->frames.pool->mutex, NULL ) )
+        goto fail;
+    h->frames.pool->stats.i_budget = (int64_t)h->param.i_frame_pool_budget << 20;
+    return 0;
+fail:
+    x264_free( h->frames.pool );
+    h->frames.pool = NULL;
+    return -1;
+}
+
+void x264_frame_pool_delete( x264_t *h )
+{
+    if( !h->frames.pool )
+        return;
+    x264_pthread_mutex_destroy( &h->frames.pool->mutex );
+    x264_free( h->frames.pool );
+    h->frames.pool = NULL;
+}
+
 void x264_weight_scale_plane( x264_t *h, pixel *dst, intptr_t i_dst_stride, pixel *src, intptr_t i_src_stride,
                               int i_width, int i_height, x264_weight_t *w )
 {
@@ -32,6 +32,15 @@
 #define PADH 32
 #define PADV 32
 
+/* per-macroblock record of --analysis-save/--analysis-load */
+typedef struct
+{
+    int8_t  i_type;
+    int8_t  i_partition;
+    int8_t  i_ref[2];       /* -1 if the list is unused */
+    int16_t mv[2][2];       /* of the top-left partition */
+} x264_analysis_mb_t;
+
 typedef struct x264_frame
 {
     /* */
@@ -91,6 +100,9 @@ typedef struct x264_frame
     x264_weight_t weight[X264_REF_MAX][3]; /* [ref_index][plane] */
     pixel *weighted[X264_REF_MAX]; /* plane[0] weighted of the reference frames */
     int b_duplicate;
+    int64_t i_alloc_size; /* bytes allocated by x264_frame_new, for frame pool accounting */
+    int64_t i_lookahead_time; /* wall-clock microseconds of slicetype decisions attributed to this frame */
+    int64_t i_base_mapped; /* mapping size if base was mmapped by x264_malloc_placed, else 0 */
     struct x264_frame *orig;
 
     /* motion data */
@@ -101,6 +113,8 @@ typedef struct x264_frame
     int16_t (*lowres_mvs[2][X264_BFRAME_MAX+1])[2];
     uint8_t *field;
     uint8_t *effective_qp;
+    x264_analysis_mb_t *analysis; /* saved modes of fdec frames, loaded hints of fenc frames */
+    int     b_analysis;           /* fenc: analysis holds valid hints */
 
     /* Stored as (lists_used << LOWRES_COST_SHIFT) + (cost).
      * Doesn't need special addressing for intra cost because
@@ -184,6 +198,13 @@ typedef struct x264_frame
 #endif
 } x264_frame_t;
 
+/* frame pool accounting, shared by all thread contexts */
+typedef struct
+{
+    x264_pthread_mutex_t    mutex;
+    x264_frame_pool_stats_t stats;
+} x264_frame_pool_t;
+
 /* synchronized frame list */
 typedef struct
 {
@@ -240,7 +261,7 @@ void          x264_frame_init_lowres( x264_t *h, x264_frame_t *frame );
 void          x264_deblock_init( int cpu, x264_deblock_function_t *pf, int b_mbaff );
 
 void          x264_frame_cond_broadcast( x264_frame_t *frame, int i_lines_completed );
-void          x264_frame_cond_wait( x264_frame_t *frame, int i_lines_completed );
+int64_t       x264_frame_cond_wait( x264_frame_t *frame, int i_lines_completed, int *pi_lines_available );
 int           x264_frame_new_slice( x264_t *h, x264_frame_t *frame );
 
 void          x264_threadslice_cond_broadcast( x264_t *h, int pass );
@@ -256,6 +277,8 @@ x264_frame_t *x264_frame_pop_blank_unused( x264_t *h );
 void x264_weight_scale_plane( x264_t *h, pixel *dst, intptr_t i_dst_stride, pixel *src, intptr_t i_src_stride,
                               int i_width, int i_height, x264_weight_t *w );
 x264_frame_t *x264_frame_pop_unused( x264_t *h, int b_fdec );
+int           x264_frame_pool_init( x264_t *h );
+void          x264_frame_pool_delete( x264_t *h );
 void          x264_frame_delete_list( x264_frame_t **list );
 
 int           x264_sync_frame_list_init( x264_sync_frame_list_t *slist, int nelem );
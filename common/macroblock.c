@@ -385,7 +385,7 @@ int x264_macroblock_thread_allocate( x264_t *h, int b_lookahead )
         int buf_hpel = (h->thread[0]->fdec->i_width[0]+48+32) * sizeof(int16_t);
         int buf_ssim = h->param.analyse.b_ssim * 8 * (h->param.i_width/4+3) * sizeof(int);
         int me_range = X264_MIN(h->param.analyse.i_me_range, h->param.analyse.i_mv_range);
-        int buf_tesa = (h->param.analyse.i_me_method >= X264_ME_ESA) *
+        int buf_tesa = ME_EXHAUSTIVE( h->param.analyse.i_me_method ) *
             ((me_range*2+24) * sizeof(int16_t) + (me_range+4) * (me_range+1) * 4 * sizeof(mvsad_t));
         scratch_size = X264_MAX3( buf_hpel, buf_ssim, buf_tesa );
     }
@@ -396,7 +396,7 @@ int x264_macroblock_thread_allocate( x264_t *h, int b_lookahead )
     else
         h->scratch_buffer = NULL;
 
-    int buf_lookahead_threads = (h->mb.i_mb_height + (4 + 32) * h->param.i_lookahead_threads) * sizeof(int) * 2;
+    int buf_lookahead_threads = ((h->mb.i_mb_height + 4 + 32) * h->param.i_lookahead_threads * 2 + h->mb.i_mb_height) * sizeof(int);
     int buf_mbtree2 = buf_mbtree * 12; /* size of the internal propagate_list asm buffer */
     scratch_size = X264_MAX( buf_lookahead_threads, buf_mbtree2 );
     CHECKED_MALLOC( h->scratch_buffer2, scratch_size );
@@ -313,6 +313,43 @@ void x264_plane_copy_swap_c( pixel *dst, intptr_t i_dst,
         }
 }
 
+void x264_plane_copy_lshift_c( uint16_t *dst, intptr_t i_dst,
+                               uint8_t *src, intptr_t i_src, int w, int h, int shift )
+{
+    for( int y=0; y<h; y++, dst+=i_dst, src+=i_src )
+        for( int x=0; x<w; x++ )
+            dst[x] = src[x] << shift;
+}
+
+#define SCALE_H( name, type, shift )\
+void x264_##name##_c( int16_t *dst, type *src, int16_t *coef, int *pos, int taps, int width )\
+{\
+    for( int x = 0; x < width; x++, coef += taps )\
+    {\
+        int sum = 1 << (shift-1);\
+        for( int t = 0; t < taps; t++ )\
+            sum += coef[t] * src[pos[x]+t];\
+        dst[x] = x264_clip3( sum >> shift, -32768, 32767 );\
+    }\
+}
+
+#define SCALE_V( name, type, shift, max )\
+void x264_##name##_c( type *dst, int16_t **rows, int16_t *coef, int taps, int width )\
+{\
+    for( int x = 0; x < width; x++ )\
+    {\
+        int sum = 1 << (shift-1);\
+        for( int t = 0; t < taps; t++ )\
+            sum += coef[t] * rows[t][x];\
+        dst[x] = x264_clip3( sum >> shift, 0, max );\
+    }\
+}
+
+SCALE_H( scale_h_8, uint8_t, 8 )
+SCALE_H( scale_h_16, uint16_t, 16 )
+SCALE_V( scale_v_8, uint8_t, 20, 255 )
+SCALE_V( scale_v_16, uint16_t, 12, 65535 )
+
 void x264_plane_copy_interleave_c( pixel *dst,  intptr_t i_dst,
                                    pixel *srcu, intptr_t i_srcu,
                                    pixel *srcv, intptr_t i_srcv, int w, int h )
@@ -627,11 +664,17 @@ void x264_mc_init( int cpu, x264_mc_functions_t *pf, int cpu_independent )
 
     pf->plane_copy = x264_plane_copy_c;
     pf->plane_copy_swap = x264_plane_copy_swap_c;
+    pf->plane_copy_lshift = x264_plane_copy_lshift_c;
     pf->plane_copy_interleave = x264_plane_copy_interleave_c;
     pf->plane_copy_deinterleave = x264_plane_copy_deinterleave_c;
     pf->plane_copy_deinterleave_rgb = x264_plane_copy_deinterleave_rgb_c;
     pf->plane_copy_deinterleave_v210 = x264_plane_copy_deinterleave_v210_c;
 
+    pf->scale_h_8  = x264_scale_h_8_c;
+    pf->scale_h_16 = x264_scale_h_16_c;
+    pf->scale_v_8  = x264_scale_v_8_c;
+    pf->scale_v_16 = x264_scale_v_16_c;
+
     pf->hpel_filter = hpel_filter;
 
     pf->prefetch_fenc_420 = prefetch_fenc_null;
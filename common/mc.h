@@ -89,6 +89,8 @@ typedef struct
 
     void (*plane_copy)( pixel *dst, intptr_t i_dst, pixel *src, intptr_t i_src, int w, int h );
     void (*plane_copy_swap)( pixel *dst, intptr_t i_dst, pixel *src, intptr_t i_src, int w, int h );
+    /* widens 8-bit samples to 16 bits, shifted left; used by the cli's depth filter */
+    void (*plane_copy_lshift)( uint16_t *dst, intptr_t i_dst, uint8_t *src, intptr_t i_src, int w, int h, int shift );
     void (*plane_copy_interleave)( pixel *dst,  intptr_t i_dst, pixel *srcu, intptr_t i_srcu,
                                    pixel *srcv, intptr_t i_srcv, int w, int h );
     /* may write up to 15 pixels off the end of each plane */
@@ -102,6 +104,17 @@ typedef struct
     void (*hpel_filter)( pixel *dsth, pixel *dstv, pixel *dstc, pixel *src,
                          intptr_t i_stride, int i_width, int i_height, int16_t *buf );
 
+    /* separable scaler of the cli's resize filter.  Each output sample has taps
+     * 14-bit coefficients that sum to 1<<14.  The horizontal pass filters the
+     * samples from src[pos[x]] on into intermediates with 6 fractional bits of
+     * 8-bit input or the top 14 bits of 16-bit input; the vertical pass filters
+     * one intermediate of each of the rows.  Taps that are multiples of 8
+     * (horizontal) or 2 (vertical) take the fast paths. */
+    void (*scale_h_8) ( int16_t *dst, uint8_t *src, int16_t *coef, int *pos, int taps, int width );
+    void (*scale_h_16)( int16_t *dst, uint16_t *src, int16_t *coef, int *pos, int taps, int width );
+    void (*scale_v_8) ( uint8_t *dst, int16_t **rows, int16_t *coef, int taps, int width );
+    void (*scale_v_16)( uint16_t *dst, int16_t **rows, int16_t *coef, int taps, int width );
+
     /* prefetch the next few macroblocks of fenc or fdec */
     void (*prefetch_fenc)    ( pixel *pix_y, intptr_t stride_y, pixel *pix_uv, intptr_t stride_uv, int mb_x );
     void (*prefetch_fenc_420)( pixel *pix_y, intptr_t stride_y, pixel *pix_uv, intptr_t stride_uv, int mb_x );
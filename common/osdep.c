@@ -94,6 +94,18 @@ int x264_threading_init( void )
 }
 #endif
 
+#if HAVE_THREAD && !(defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ > 0))
+int x264_atomic_fetch_add( int *val, int add )
+{
+    static x264_pthread_mutex_t mutex = X264_PTHREAD_MUTEX_INITIALIZER;
+    x264_pthread_mutex_lock( &mutex );
+    int res = *val;
+    *val += add;
+    x264_pthread_mutex_unlock( &mutex );
+    return res;
+}
+#endif
+
 #ifdef _WIN32
 /* Functions for dealing with Unicode on Windows. */
 FILE *x264_fopen( const char *filename, const char *mode )
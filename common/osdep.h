@@ -198,6 +198,7 @@ static inline int x264_pthread_create( x264_pthread_t *t, void *a, void *(*f)(vo
 #define x264_pthread_cond_init       pthread_cond_init
 #define x264_pthread_cond_destroy    pthread_cond_destroy
 #define x264_pthread_cond_broadcast  pthread_cond_broadcast
+#define x264_pthread_cond_signal     pthread_cond_signal
 #define x264_pthread_cond_wait       pthread_cond_wait
 #define x264_pthread_attr_t          pthread_attr_t
 #define x264_pthread_attr_init       pthread_attr_init
@@ -224,6 +225,7 @@ static inline int x264_pthread_create( x264_pthread_t *t, void *a, void *(*f)(vo
 #define x264_pthread_cond_init(c,f)  0
 #define x264_pthread_cond_destroy(c)
 #define x264_pthread_cond_broadcast(c)
+#define x264_pthread_cond_signal(c)
 #define x264_pthread_cond_wait(c,m)
 #define x264_pthread_attr_t          int
 #define x264_pthread_attr_init(a)    0
@@ -256,6 +258,22 @@ static ALWAYS_INLINE int x264_pthread_fetch_and_add( int *val, int add, x264_pth
 #endif
 }
 
+/* Adds to *val and returns its previous value, as one atomic operation that is
+ * also a full memory barrier.  Lets progress counters be published and polled
+ * without a lock; only threads that have to sleep take the mutex. */
+#if HAVE_THREAD && defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ > 0)
+#define x264_atomic_fetch_add( val, add ) __sync_fetch_and_add( val, add )
+#elif HAVE_THREAD
+int x264_atomic_fetch_add( int *val, int add );
+#else
+static ALWAYS_INLINE int x264_atomic_fetch_add( int *val, int add )
+{
+    int res = *val;
+    *val += add;
+    return res;
+}
+#endif
+
 #define WORD_SIZE sizeof(void*)
 
 #define asm __asm__
@@ -1352,6 +1352,19 @@ void x264_pixel_init( int cpu, x264_pixel_function_t *pixf )
         pixf->sa8d_satd[PIXEL_16x16] = x264_pixel_sa8d_satd_16x16_avx2;
 #endif
     }
+#if HAVE_AVX512
+    if( cpu&X264_CPU_AVX512 )
+    {
+        INIT2( sad_x3, _avx512 );
+        INIT2( sad_x4, _avx512 );
+        INIT2( satd, _avx512 );
+        pixf->var[PIXEL_16x16] = x264_pixel_var_16x16_avx512;
+#if ARCH_X86_64
+        pixf->sa8d[PIXEL_16x16] = x264_pixel_sa8d_16x16_avx512;
+        pixf->hadamard_ac[PIXEL_16x16] = x264_pixel_hadamard_ac_16x16_avx512;
+#endif
+    }
+#endif
 #endif //HAVE_MMX
 
 #if HAVE_ARMV6
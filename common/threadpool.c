@@ -32,6 +32,34 @@ typedef struct
     void *ret;
 } x264_threadpool_job_t;
 
+/* Each worker owns a queue of jobs; idle workers steal from the others, so
+ * running and finishing jobs only contends on the queues involved.  Jobs are
+ * not necessarily started in submission order: a job queued behind a busy
+ * worker may be stolen after one submitted later.  Frame jobs do not rely on
+ * the order, only on every queued job starting without waiting for another
+ * to finish, as they block on the rows of frames submitted before them.  That
+ * holds because the encoder never has more jobs outstanding than the pool has
+ * workers, and a worker without a job of its own takes any queued one. */
+typedef struct
+{
+    x264_threadpool_t      *pool;
+    int                    id;
+    x264_pthread_mutex_t   mutex;   /* protects the queue */
+    x264_threadpool_job_t  **queue; /* circular, pool->threads entries */
+    int                    i_head;
+    int                    i_size;
+
+    /* protected by pool->sleep_mutex */
+    int                    b_sleeping;
+    int64_t                i_sleep_start;
+    x264_pthread_cond_t    cv_wake;
+
+    /* only written by the worker itself */
+    int                    i_jobs;
+    int                    i_steals;
+    int64_t                i_idle_time;
+} x264_threadpool_worker_t;
+
 struct x264_threadpool_t
 {
     int            exit;
@@ -39,34 +67,85 @@ struct x264_threadpool_t
     x264_pthread_t *thread_handle;
     void           (*init_func)(void *);
     void           *init_arg;
+    int64_t        i_start_time;
+
+    x264_threadpool_worker_t *workers;
+    /* taken when queueing a job and before going to sleep, so a worker can't
+       miss a job queued after it last looked */
+    x264_pthread_mutex_t sleep_mutex;
+    int            next_worker;
 
     /* requires a synchronized list structure and associated methods,
        so use what is already implemented for frames */
     x264_sync_frame_list_t uninit; /* list of jobs that are awaiting use */
-    x264_sync_frame_list_t run;    /* list of jobs that are queued for processing by the pool */
     x264_sync_frame_list_t done;   /* list of jobs that have finished processing */
 };
 
-static void *x264_threadpool_thread( x264_threadpool_t *pool )
+static x264_threadpool_job_t *x264_threadpool_queue_shift( x264_threadpool_worker_t *w )
+{
+    x264_threadpool_job_t *job = NULL;
+    x264_pthread_mutex_lock( &w->mutex );
+    if( w->i_size )
+    {
+        job = w->queue[w->i_head];
+        w->i_head = (w->i_head + 1) % w->pool->threads;
+        w->i_size--;
+    }
+    x264_pthread_mutex_unlock( &w->mutex );
+    return job;
+}
+
+static void x264_threadpool_queue_push( x264_threadpool_worker_t *w, x264_threadpool_job_t *job )
 {
+    x264_pthread_mutex_lock( &w->mutex );
+    w->queue[(w->i_head + w->i_size) % w->pool->threads] = job;
+    w->i_size++;
+    x264_pthread_mutex_unlock( &w->mutex );
+}
+
+/* own queue first, then steal from the others starting with the next worker */
+static x264_threadpool_job_t *x264_threadpool_take( x264_threadpool_worker_t *w )
+{
+    x264_threadpool_t *pool = w->pool;
+    x264_threadpool_job_t *job = x264_threadpool_queue_shift( w );
+    for( int i = 1; !job && i < pool->threads; i++ )
+    {
+        job = x264_threadpool_queue_shift( &pool->workers[(w->id + i) % pool->threads] );
+        if( job )
+            w->i_steals++;
+    }
+    return job;
+}
+
+static void *x264_threadpool_thread( x264_threadpool_worker_t *w )
+{
+    x264_threadpool_t *pool = w->pool;
+
     if( pool->init_func )
         pool->init_func( pool->init_arg );
 
     while( !pool->exit )
     {
-        x264_threadpool_job_t *job = NULL;
-        x264_pthread_mutex_lock( &pool->run.mutex );
-        while( !pool->exit && !pool->run.i_size )
-            x264_pthread_cond_wait( &pool->run.cv_fill, &pool->run.mutex );
-        if( pool->run.i_size )
+        x264_threadpool_job_t *job = x264_threadpool_take( w );
+        if( !job )
         {
-            job = (void*)x264_frame_shift( pool->run.list );
-            pool->run.i_size--;
+            x264_pthread_mutex_lock( &pool->sleep_mutex );
+            job = x264_threadpool_take( w );
+            if( !job && !pool->exit )
+            {
+                w->b_sleeping = 1;
+                w->i_sleep_start = x264_mdate();
+                while( w->b_sleeping && !pool->exit )
+                    x264_pthread_cond_wait( &w->cv_wake, &pool->sleep_mutex );
+                w->b_sleeping = 0;
+                w->i_idle_time += x264_mdate() - w->i_sleep_start;
+            }
+            x264_pthread_mutex_unlock( &pool->sleep_mutex );
+            if( !job )
+                continue;
         }
-        x264_pthread_mutex_unlock( &pool->run.mutex );
-        if( !job )
-            continue;
         job->ret = (void*)x264_stack_align( job->func, job->arg ); /* execute the function */
+        w->i_jobs++;
         x264_sync_frame_list_push( &pool->done, (void*)job );
     }
     return NULL;
@@ -85,14 +164,27 @@ int x264_threadpool_init( x264_threadpool_t **p_pool, int threads,
     pool->init_func = init_func;
     pool->init_arg  = init_arg;
     pool->threads   = threads;
+    pool->i_start_time = x264_mdate();
 
     CHECKED_MALLOC( pool->thread_handle, pool->threads * sizeof(x264_pthread_t) );
+    CHECKED_MALLOCZERO( pool->workers, pool->threads * sizeof(x264_threadpool_worker_t) );
 
     if( x264_sync_frame_list_init( &pool->uninit, pool->threads ) ||
-        x264_sync_frame_list_init( &pool->run, pool->threads ) ||
-        x264_sync_frame_list_init( &pool->done, pool->threads ) )
+        x264_sync_frame_list_init( &pool->done, pool->threads ) ||
+        x264_pthread_mutex_init( &pool->sleep_mutex, NULL ) )
         goto fail;
 
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->id = i;
+        CHECKED_MALLOCZERO( w->queue, pool->threads * sizeof(x264_threadpool_job_t*) );
+        if( x264_pthread_mutex_init( &w->mutex, NULL ) ||
+            x264_pthread_cond_init( &w->cv_wake, NULL ) )
+            goto fail;
+    }
+
     for( int i = 0; i < pool->threads; i++ )
     {
        x264_threadpool_job_t *job;
@@ -100,7 +192,7 @@ int x264_threadpool_init( x264_threadpool_t **p_pool, int threads,
        x264_sync_frame_list_push( &pool->uninit, (void*)job );
     }
     for( int i = 0; i < pool->threads; i++ )
-        if( x264_pthread_create( pool->thread_handle+i, NULL, (void*)x264_threadpool_thread, pool ) )
+        if( x264_pthread_create( pool->thread_handle+i, NULL, (void*)x264_threadpool_thread, pool->workers+i ) )
             goto fail;
 
     return 0;
@@ -113,7 +205,27 @@ void x264_threadpool_run( x264_threadpool_t *pool, void *(*func)(void *), void *
     x264_threadpool_job_t *job = (void*)x264_sync_frame_list_pop( &pool->uninit );
     job->func = func;
     job->arg  = arg;
-    x264_sync_frame_list_push( &pool->run, (void*)job );
+
+    /* prefer waking a sleeping worker over queueing behind a busy one */
+    x264_pthread_mutex_lock( &pool->sleep_mutex );
+    x264_threadpool_worker_t *w = &pool->workers[pool->next_worker];
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_worker_t *t = &pool->workers[(pool->next_worker + i) % pool->threads];
+        if( t->b_sleeping )
+        {
+            w = t;
+            break;
+        }
+    }
+    pool->next_worker = (w->id + 1) % pool->threads;
+    x264_threadpool_queue_push( w, job );
+    if( w->b_sleeping )
+    {
+        w->b_sleeping = 0;
+        x264_pthread_cond_signal( &w->cv_wake );
+    }
+    x264_pthread_mutex_unlock( &pool->sleep_mutex );
 }
 
 void *x264_threadpool_wait( x264_threadpool_t *pool, void *arg )
@@ -142,6 +254,24 @@ void *x264_threadpool_wait( x264_threadpool_t *pool, void *arg )
     return ret;
 }
 
+void x264_threadpool_stats( x264_threadpool_t *pool, x264_threadpool_stats_t *stats )
+{
+    int64_t now = x264_mdate();
+    memset( stats, 0, sizeof(x264_threadpool_stats_t) );
+    x264_pthread_mutex_lock( &pool->sleep_mutex );
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_worker_t *w = &pool->workers[i];
+        stats->i_jobs      += w->i_jobs;
+        stats->i_steals    += w->i_steals;
+        stats->i_idle_time += w->i_idle_time;
+        if( w->b_sleeping )
+            stats->i_idle_time += now - w->i_sleep_start;
+    }
+    x264_pthread_mutex_unlock( &pool->sleep_mutex );
+    stats->i_wall_time = (now - pool->i_start_time) * pool->threads;
+}
+
 static void x264_threadpool_list_delete( x264_sync_frame_list_t *slist )
 {
     for( int i = 0; slist->list[i]; i++ )
@@ -154,16 +284,27 @@ static void x264_threadpool_list_delete( x264_sync_frame_list_t *slist )
 
 void x264_threadpool_delete( x264_threadpool_t *pool )
 {
-    x264_pthread_mutex_lock( &pool->run.mutex );
+    x264_pthread_mutex_lock( &pool->sleep_mutex );
     pool->exit = 1;
-    x264_pthread_cond_broadcast( &pool->run.cv_fill );
-    x264_pthread_mutex_unlock( &pool->run.mutex );
+    for( int i = 0; i < pool->threads; i++ )
+        x264_pthread_cond_signal( &pool->workers[i].cv_wake );
+    x264_pthread_mutex_unlock( &pool->sleep_mutex );
     for( int i = 0; i < pool->threads; i++ )
         x264_pthread_join( pool->thread_handle[i], NULL );
 
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_worker_t *w = &pool->workers[i];
+        for( int j = 0; j < w->i_size; j++ )
+            x264_free( w->queue[(w->i_head + j) % pool->threads] );
+        x264_free( w->queue );
+        x264_pthread_mutex_destroy( &w->mutex );
+        x264_pthread_cond_destroy( &w->cv_wake );
+    }
+    x264_pthread_mutex_destroy( &pool->sleep_mutex );
     x264_threadpool_list_delete( &pool->uninit );
-    x264_threadpool_list_delete( &pool->run );
     x264_threadpool_list_delete( &pool->done );
+    x264_free( pool->workers );
     x264_free( pool->thread_handle );
     x264_free( pool );
 }
@@ -28,16 +28,26 @@
 
 typedef struct x264_threadpool_t x264_threadpool_t;
 
+typedef struct
+{
+    int     i_jobs;      /* jobs executed */
+    int     i_steals;    /* jobs taken from another worker's queue */
+    int64_t i_idle_time; /* time workers spent waiting for jobs, in microseconds */
+    int64_t i_wall_time; /* pool lifetime times the number of workers, in microseconds */
+} x264_threadpool_stats_t;
+
 #if HAVE_THREAD
 int   x264_threadpool_init( x264_threadpool_t **p_pool, int threads,
                             void (*init_func)(void *), void *init_arg );
 void  x264_threadpool_run( x264_threadpool_t *pool, void *(*func)(void *), void *arg );
 void *x264_threadpool_wait( x264_threadpool_t *pool, void *arg );
+void  x264_threadpool_stats( x264_threadpool_t *pool, x264_threadpool_stats_t *stats );
 void  x264_threadpool_delete( x264_threadpool_t *pool );
 #else
 #define x264_threadpool_init(p,t,f,a) -1
 #define x264_threadpool_run(p,f,a)
 #define x264_threadpool_wait(p,a)     NULL
+#define x264_threadpool_stats(p,s)    memset( s, 0, sizeof(x264_threadpool_stats_t) )
 #define x264_threadpool_delete(p)
 #endif
 
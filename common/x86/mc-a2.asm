@@ -39,6 +39,16 @@ filt_mul51: times 16 db -5, 1
 hpel_shuf: times 2 db 0,8,1,9,2,10,3,11,4,12,5,13,6,14,7,15
 deinterleave_shuf: times 2 db 0,2,4,6,8,10,12,14,1,3,5,7,9,11,13,15
 
+; rounding of the native scaler, see x264_scale_*_c.  16-bit samples are
+; filtered with their sign bit flipped, which the horizontal rounding undoes
+; as the coefficients sum to 1<<14, and the vertical results are offset by
+; -0x8000 so that they saturate to the unsigned range as signed words.
+scale_h8_round:  times 8 dd 1<<7
+scale_h16_round: times 8 dd (1<<29) + (1<<15)
+scale_v8_round:  times 8 dd 1<<19
+scale_v16_round: times 8 dd (1<<11) - (0x8000<<12)
+scale_pw_8000:   times 16 dw 0x8000
+
 %if HIGH_BIT_DEPTH
 copy_swap_shuf: times 2 db 2,3,0,1,6,7,4,5,10,11,8,9,14,15,12,13
 v210_mask: times 4 dq 0xc00ffc003ff003ff
@@ -1000,6 +1010,257 @@ PLANE_COPY_CORE 0
 INIT_YMM avx2
 PLANE_COPY_CORE 1
 
+;-----------------------------------------------------------------------------
+; void plane_copy_lshift_core( uint16_t *dst, intptr_t i_dst, uint8_t *src, intptr_t i_src,
+;                              int w, int h, int shift )
+;-----------------------------------------------------------------------------
+; assumes w is a multiple of mmsize/2; strides are in elements
+%macro PLANE_COPY_LSHIFT 0
+cglobal plane_copy_lshift_core, 7,7,3
+    movd      xm2, r6d
+%if mmsize == 16
+    pxor       m1, m1
+%endif
+    add        r1, r1
+    movsxdifnidn r4, r4d
+    lea        r0, [r0+2*r4]
+    add        r2, r4
+    neg        r4
+.loopy:
+    mov        r6, r4
+.loopx:
+%if mmsize == 32
+    pmovzxbw   m0, [r2+r6]
+%else
+    movh       m0, [r2+r6]
+    punpcklbw  m0, m1
+%endif
+    psllw      m0, xm2
+    movu [r0+2*r6], m0
+    add        r6, mmsize/2
+    jl .loopx
+    add        r0, r1
+    add        r2, r3
+    dec       r5d
+    jg .loopy
+    RET
+%endmacro
+
+INIT_XMM sse2
+PLANE_COPY_LSHIFT
+INIT_YMM avx2
+PLANE_COPY_LSHIFT
+
+%if ARCH_X86_64
+; loads the 8 taps at r10 of the samples from %2, and from %3 into the high lane, as words
+%macro SCALE_H_LOAD 3-4 ; dst, src, bits, src2
+%if mmsize == 32
+%if %3 == 8
+    movq      xm%1, [%2+r10]
+    movhps    xm%1, [%4+r10]
+    pmovzxbw   m%1, xm%1
+%else
+    movu      xm%1, [%2+r10*2]
+    vinserti128 m%1, m%1, [%4+r10*2], 1
+    pxor       m%1, m7
+%endif
+%elif %3 == 8
+    movh       m%1, [%2+r10]
+    punpcklbw  m%1, m7
+%else
+    movu       m%1, [%2+r10*2]
+    pxor       m%1, m7
+%endif
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void scale_h_8_core( int16_t *dst, uint8_t *src, int16_t *coef, int *pos, int taps, int width )
+; void scale_h_16_core( int16_t *dst, uint16_t *src, int16_t *coef, int *pos, int taps, int width )
+;-----------------------------------------------------------------------------
+; taps must be a multiple of 8 and width a multiple of 4.  Filters 4 outputs
+; at a time, 8 taps each per step, and sums the products across the vectors
+; at the end.
+%macro SCALE_H 1 ; bits of the input
+cglobal scale_h_%1_core, 6,14,8
+    movsxdifnidn r4, r4d
+    lea       r11, [r4*2]     ; bytes of coefficients per output
+    lea       r12, [r11*3]
+    mova       m6, [scale_h%1_round]
+%if %1 == 8
+    pxor       m7, m7
+%else
+    mova       m7, [scale_pw_8000]
+%endif
+.loopx:
+    movsxd     r6, dword [r3+ 0]
+    movsxd     r7, dword [r3+ 4]
+    movsxd     r8, dword [r3+ 8]
+    movsxd     r9, dword [r3+12]
+%if %1 == 8
+    add        r6, r1
+    add        r7, r1
+    add        r8, r1
+    add        r9, r1
+%else
+    lea        r6, [r1+r6*2]
+    lea        r7, [r1+r7*2]
+    lea        r8, [r1+r8*2]
+    lea        r9, [r1+r9*2]
+%endif
+    pxor       m0, m0
+    pxor       m1, m1
+%if mmsize == 16
+    pxor       m2, m2
+    pxor       m3, m3
+%endif
+    xor       r10d, r10d
+    mov       r13, r2
+.loopt:
+%if mmsize == 32
+    ; outputs 0 and 1 in the lanes of m0, 2 and 3 in those of m1
+    SCALE_H_LOAD 4, r6, %1, r7
+    movu      xm5, [r13]
+    vinserti128 m5, m5, [r13+r11], 1
+    pmaddwd    m4, m5
+    paddd      m0, m4
+    SCALE_H_LOAD 4, r8, %1, r9
+    movu      xm5, [r13+r11*2]
+    vinserti128 m5, m5, [r13+r12], 1
+    pmaddwd    m4, m5
+    paddd      m1, m4
+%else
+    SCALE_H_LOAD 4, r6, %1
+    movu       m5, [r13]
+    pmaddwd    m4, m5
+    paddd      m0, m4
+    SCALE_H_LOAD 4, r7, %1
+    movu       m5, [r13+r11]
+    pmaddwd    m4, m5
+    paddd      m1, m4
+    SCALE_H_LOAD 4, r8, %1
+    movu       m5, [r13+r11*2]
+    pmaddwd    m4, m5
+    paddd      m2, m4
+    SCALE_H_LOAD 4, r9, %1
+    movu       m5, [r13+r12]
+    pmaddwd    m4, m5
+    paddd      m3, m4
+%endif
+    add       r13, 16
+    add       r10, 8
+    cmp       r10, r4
+    jl .loopt
+%if mmsize == 32
+    phaddd     m0, m1
+    phaddd     m0, m0
+    vextracti128 xm1, m0, 1
+    punpckldq xm0, xm1
+%else
+    punpckldq  m4, m0, m1
+    punpckhdq  m0, m1
+    paddd      m0, m4
+    punpckldq  m4, m2, m3
+    punpckhdq  m2, m3
+    paddd      m2, m4
+    punpcklqdq m4, m0, m2
+    punpckhqdq m0, m2
+    paddd      m0, m4
+%endif
+    paddd     xm0, xm6
+    psrad     xm0, %1
+    packssdw  xm0, xm0
+    movq     [r0], xm0
+    add        r0, 8
+    add        r3, 16
+    lea        r2, [r2+r11*4]
+    sub       r5d, 4
+    jg .loopx
+    RET
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void scale_v_8_core( uint8_t *dst, int16_t **rows, int16_t *coef, int taps, int width )
+; void scale_v_16_core( uint16_t *dst, int16_t **rows, int16_t *coef, int taps, int width )
+;-----------------------------------------------------------------------------
+; taps must be even and width at least mmsize/2.  Filters pairs of rows with
+; interleaved samples; the last vector of the row is moved back to end at
+; width, overlapping the one before it.
+%macro SCALE_V 1 ; bits of the output
+cglobal scale_v_%1_core, 5,8,8
+    movsxdifnidn r3, r3d
+    movsxdifnidn r4, r4d
+    lea        r1, [r1+r3*gprsize]
+    lea        r2, [r2+r3*2]
+    neg        r3
+    lea        r7, [r4-mmsize/2]
+    xor       r5d, r5d
+    mova       m6, [scale_v%1_round]
+%if %1 == 16
+    mova       m7, [scale_pw_8000]
+%endif
+.loopx:
+    mova       m0, m6
+    mova       m1, m6
+    mov        r6, r3
+.loopt:
+    mov        r4, [r1+r6*gprsize]
+    movu       m2, [r4+r5*2]
+    mov        r4, [r1+r6*gprsize+gprsize]
+    movu       m3, [r4+r5*2]
+%if mmsize == 32
+    vpbroadcastd m4, [r2+r6*2]
+%else
+    movd       m4, [r2+r6*2]
+    pshufd     m4, m4, 0
+%endif
+    punpckhwd  m5, m2, m3
+    punpcklwd  m2, m3
+    pmaddwd    m2, m4
+    pmaddwd    m5, m4
+    paddd      m0, m2
+    paddd      m1, m5
+    add        r6, 2
+    jl .loopt
+%if %1 == 8
+    psrad      m0, 20
+    psrad      m1, 20
+    packssdw   m0, m1
+    packuswb   m0, m0
+%if mmsize == 32
+    vpermq     m0, m0, q3120
+    movu  [r0+r5], xm0
+%else
+    movh  [r0+r5], m0
+%endif
+%else
+    psrad      m0, 12
+    psrad      m1, 12
+    packssdw   m0, m1
+    pxor       m0, m7
+    movu [r0+r5*2], m0
+%endif
+    cmp        r5, r7
+    jge .end
+    add        r5, mmsize/2
+    cmp        r5, r7
+    cmovg      r5, r7
+    jmp .loopx
+.end:
+    RET
+%endmacro
+
+INIT_XMM sse2
+SCALE_H 8
+SCALE_H 16
+SCALE_V 8
+SCALE_V 16
+INIT_YMM avx2
+SCALE_H 8
+SCALE_H 16
+SCALE_V 8
+SCALE_V 16
+%endif ; ARCH_X86_64
+
 %macro INTERLEAVE 4-5 ; dst, srcu, srcv, is_aligned, nt_hint
 %if HIGH_BIT_DEPTH
 %assign x 0
@@ -96,6 +96,23 @@ void x264_plane_copy_c( pixel *, intptr_t, pixel *, intptr_t, int w, int h );
 void x264_plane_copy_swap_core_ssse3( pixel *, intptr_t, pixel *, intptr_t, int w, int h );
 void x264_plane_copy_swap_core_avx2 ( pixel *, intptr_t, pixel *, intptr_t, int w, int h );
 void x264_plane_copy_swap_c( pixel *, intptr_t, pixel *, intptr_t, int w, int h );
+void x264_plane_copy_lshift_core_sse2( uint16_t *, intptr_t, uint8_t *, intptr_t, int w, int h, int shift );
+void x264_plane_copy_lshift_core_avx2( uint16_t *, intptr_t, uint8_t *, intptr_t, int w, int h, int shift );
+void x264_plane_copy_lshift_c( uint16_t *, intptr_t, uint8_t *, intptr_t, int w, int h, int shift );
+#if ARCH_X86_64
+void x264_scale_h_8_core_sse2 ( int16_t *, uint8_t *, int16_t *, int *, int taps, int width );
+void x264_scale_h_8_core_avx2 ( int16_t *, uint8_t *, int16_t *, int *, int taps, int width );
+void x264_scale_h_8_c( int16_t *, uint8_t *, int16_t *, int *, int taps, int width );
+void x264_scale_h_16_core_sse2( int16_t *, uint16_t *, int16_t *, int *, int taps, int width );
+void x264_scale_h_16_core_avx2( int16_t *, uint16_t *, int16_t *, int *, int taps, int width );
+void x264_scale_h_16_c( int16_t *, uint16_t *, int16_t *, int *, int taps, int width );
+void x264_scale_v_8_core_sse2 ( uint8_t *, int16_t **, int16_t *, int taps, int width );
+void x264_scale_v_8_core_avx2 ( uint8_t *, int16_t **, int16_t *, int taps, int width );
+void x264_scale_v_8_c( uint8_t *, int16_t **, int16_t *, int taps, int width );
+void x264_scale_v_16_core_sse2( uint16_t *, int16_t **, int16_t *, int taps, int width );
+void x264_scale_v_16_core_avx2( uint16_t *, int16_t **, int16_t *, int taps, int width );
+void x264_scale_v_16_c( uint16_t *, int16_t **, int16_t *, int taps, int width );
+#endif
 void x264_plane_copy_interleave_core_mmx2( pixel *dst,  intptr_t i_dst,
                                            pixel *srcu, intptr_t i_srcu,
                                            pixel *srcv, intptr_t i_srcv, int w, int h );
@@ -555,6 +572,56 @@ static void x264_plane_copy_swap_##cpu( pixel *dst, intptr_t i_dst, pixel *src,
 PLANE_COPY_SWAP(16, ssse3)
 PLANE_COPY_SWAP(32, avx2)
 
+/* the asm handles whole vectors of each row; the remaining columns are done in C */
+#define PLANE_COPY_LSHIFT(align, cpu)\
+static void x264_plane_copy_lshift_##cpu( uint16_t *dst, intptr_t i_dst, uint8_t *src, intptr_t i_src, int w, int h, int shift )\
+{\
+    int c_w = w & ~((align)/2-1);\
+    if( c_w )\
+        x264_plane_copy_lshift_core_##cpu( dst, i_dst, src, i_src, c_w, h, shift );\
+    if( c_w < w )\
+        x264_plane_copy_lshift_c( dst+c_w, i_dst, src+c_w, i_src, w-c_w, h, shift );\
+}
+
+PLANE_COPY_LSHIFT(16, sse2)
+PLANE_COPY_LSHIFT(32, avx2)
+
+#if ARCH_X86_64
+/* the asm filters groups of 4 outputs with a multiple of 8 taps; the last
+ * group of a width that isn't a multiple of 4 is redone ending at width */
+#define SCALE_H(bits, cpu)\
+static void x264_scale_h_##bits##_##cpu( int16_t *dst, uint##bits##_t *src, int16_t *coef, int *pos, int taps, int width )\
+{\
+    if( (taps&7) || width < 4 )\
+    {\
+        x264_scale_h_##bits##_c( dst, src, coef, pos, taps, width );\
+        return;\
+    }\
+    x264_scale_h_##bits##_core_##cpu( dst, src, coef, pos, taps, width&~3 );\
+    if( width&3 )\
+        x264_scale_h_##bits##_core_##cpu( dst+width-4, src, coef+(width-4)*taps, pos+width-4, taps, 4 );\
+}
+
+/* the asm filters pairs of rows and needs at least one whole vector */
+#define SCALE_V(bits, align, cpu)\
+static void x264_scale_v_##bits##_##cpu( uint##bits##_t *dst, int16_t **rows, int16_t *coef, int taps, int width )\
+{\
+    if( (taps&1) || width < (align)/2 )\
+        x264_scale_v_##bits##_c( dst, rows, coef, taps, width );\
+    else\
+        x264_scale_v_##bits##_core_##cpu( dst, rows, coef, taps, width );\
+}
+
+SCALE_H(8, sse2)
+SCALE_H(8, avx2)
+SCALE_H(16, sse2)
+SCALE_H(16, avx2)
+SCALE_V(8, 16, sse2)
+SCALE_V(8, 32, avx2)
+SCALE_V(16, 16, sse2)
+SCALE_V(16, 32, avx2)
+#endif // ARCH_X86_64
+
 #define PLANE_INTERLEAVE(cpu) \
 static void x264_plane_copy_interleave_##cpu( pixel *dst,  intptr_t i_dst,\
                                               pixel *srcu, intptr_t i_srcu,\
@@ -753,6 +820,17 @@ void x264_mc_init_mmx( int cpu, x264_mc_functions_t *pf )
         pf->plane_copy = x264_plane_copy_sse;
     }
 
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf->plane_copy_lshift = x264_plane_copy_lshift_sse2;
+#if ARCH_X86_64
+        pf->scale_h_8  = x264_scale_h_8_sse2;
+        pf->scale_h_16 = x264_scale_h_16_sse2;
+        pf->scale_v_8  = x264_scale_v_8_sse2;
+        pf->scale_v_16 = x264_scale_v_16_sse2;
+#endif
+    }
+
 #if HIGH_BIT_DEPTH
 #if ARCH_X86 // all x86_64 cpus with cacheline split issues use sse2 instead
     if( cpu&(X264_CPU_CACHELINE_32|X264_CPU_CACHELINE_64) )
@@ -1000,6 +1078,13 @@ void x264_mc_init_mmx( int cpu, x264_mc_functions_t *pf )
     if( !(cpu&X264_CPU_AVX2) )
         return;
     pf->plane_copy_swap = x264_plane_copy_swap_avx2;
+    pf->plane_copy_lshift = x264_plane_copy_lshift_avx2;
+#if ARCH_X86_64
+    pf->scale_h_8  = x264_scale_h_8_avx2;
+    pf->scale_h_16 = x264_scale_h_16_avx2;
+    pf->scale_v_8  = x264_scale_v_8_avx2;
+    pf->scale_v_16 = x264_scale_v_16_avx2;
+#endif
     pf->get_ref = get_ref_avx2;
     pf->mbtree_propagate_cost = x264_mbtree_propagate_cost_avx2;
 }
@@ -4612,6 +4612,259 @@ cglobal intra_sad_x9_8x8, 5,7,8
     mov        rsp, r6
     mov        eax, r2d
     RET
+
+%if HAVE_AVX512
+;=============================================================================
+; AVX-512
+;=============================================================================
+
+; Rows are loaded twice per 128-bit lane pair so that a single pmaddubsw with
+; hmul_16p gives the horizontal sums and differences of pixel pairs. With the
+; remaining horizontal stage done by amax, the low word of each dword ends up
+; holding max(|a|,|b|) of a coefficient pair, which is half their abs sum.
+%macro LOAD_DUP_2x16P_AVX512 4 ; dst, tmp, row a, row b -> a a b b
+    vbroadcasti128   ym%1, %3
+    vbroadcasti128   ym%2, %4
+    vinserti64x4      m%1, m%1, ym%2, 1
+%endmacro
+
+%macro LOAD_SUMSUB_2x16P_AVX512 8 ; dst, 2*tmp, mul, pix1 row a, b, pix2 row a, b
+    LOAD_DUP_2x16P_AVX512 %1, %2, %5, %6
+    LOAD_DUP_2x16P_AVX512 %2, %3, %7, %8
+    pmaddubsw  m%1, m%4
+    pmaddubsw  m%2, m%4
+    psubw      m%1, m%2
+%endmacro
+
+%macro AMAX_AVX512 2 ; src/dst, tmp
+    pabsw      m%1, m%1
+    psrld      m%2, m%1, 16
+    pmaxsw     m%1, m%2
+%endmacro
+
+; the last two horizontal stages of an 8x8 transform: sumsub of dwords, then amax
+%macro AC8_AVX512 3 ; src/dst, 2*tmp
+    pshufd     m%2, m%1, q2301
+    paddw      m%3, m%1, m%2
+    psubw      m%1, m%2, m%1
+    shufps     m%1, m%3, m%1, q3120
+    AMAX_AVX512 %1, %2
+%endmacro
+
+; drop the junk in the high words and sum the rest
+%macro HADDAMAX_AVX512 2 ; src/dst, tmp
+    vpmovdw    ym%1, m%1
+    pmaddwd    ym%1, [pw_1]
+    vextracti128 xm%2, ym%1, 1
+    paddd      xm%1, xm%2
+    HADDD      xm%1, xm%2
+%endmacro
+
+INIT_ZMM avx512
+cglobal pixel_satd_16x8_internal
+    LOAD_SUMSUB_2x16P_AVX512 0, 4, 5, 7, [r0], [r0+4*r1], [r2], [r2+4*r3]
+    LOAD_SUMSUB_2x16P_AVX512 1, 4, 5, 7, [r0+r1], [r0+r4], [r2+r3], [r2+r5]
+    lea        r0, [r0+2*r1]
+    lea        r2, [r2+2*r3]
+    LOAD_SUMSUB_2x16P_AVX512 2, 4, 5, 7, [r0], [r0+4*r1], [r2], [r2+4*r3]
+    LOAD_SUMSUB_2x16P_AVX512 3, 4, 5, 7, [r0+r1], [r0+r4], [r2+r3], [r2+r5]
+    HADAMARD4_V 0, 1, 2, 3, 4
+    AMAX_AVX512 0, 4
+    AMAX_AVX512 1, 4
+    AMAX_AVX512 2, 4
+    AMAX_AVX512 3, 4
+    paddw      m0, m1
+    paddw      m2, m3
+    paddw      m6, m0
+    paddw      m6, m2
+    ret
+
+%macro SATD_START_AVX512 0
+    vbroadcasti64x4 m7, [hmul_16p]
+    lea        r4, [5*r1]
+    lea        r5, [5*r3]
+    pxor      xm6, xm6
+%endmacro
+
+cglobal pixel_satd_16x16, 4,6,8
+    SATD_START_AVX512
+    call pixel_satd_16x8_internal
+    lea        r0, [r0+2*r1]
+    lea        r2, [r2+2*r3]
+    lea        r0, [r0+4*r1]
+    lea        r2, [r2+4*r3]
+    call pixel_satd_16x8_internal
+    HADDAMAX_AVX512 6, 0
+    movd      eax, xm6
+    RET
+
+cglobal pixel_satd_16x8, 4,6,8
+    SATD_START_AVX512
+    call pixel_satd_16x8_internal
+    HADDAMAX_AVX512 6, 0
+    movd      eax, xm6
+    RET
+
+cglobal pixel_var_16x16, 2,4,7
+    pxor      xm4, xm4
+    pxor      xm5, xm5
+    pxor      xm6, xm6
+    lea        r2, [r1*3]
+    mov       r3d, 4
+.loop:
+    movu      xm0, [r0]
+    vinserti32x4 m0, m0, [r0+r1], 1
+    vinserti32x4 m0, m0, [r0+r1*2], 2
+    vinserti32x4 m0, m0, [r0+r2], 3
+    lea        r0, [r0+r1*4]
+    psadbw     m1, m0, m4
+    paddd      m5, m1
+    punpcklbw  m1, m0, m4
+    punpckhbw  m0, m4
+    pmaddwd    m1, m1
+    pmaddwd    m0, m0
+    paddd      m6, m1
+    paddd      m6, m0
+    dec       r3d
+    jg .loop
+    vextracti64x4 ym0, m5, 1
+    vextracti64x4 ym1, m6, 1
+    paddd     ym5, ym0
+    paddd     ym6, ym1
+    vextracti128 xm0, ym5, 1
+    vextracti128 xm1, ym6, 1
+    paddd     xm5, xm0
+    paddd     xm6, xm1
+    movhlps   xm0, xm5
+    paddd     xm5, xm0
+    HADDD     xm6, xm1
+%if ARCH_X86_64
+    punpckldq xm5, xm6
+    movq      rax, xm5
+%else
+    movd      eax, xm5
+    movd      edx, xm6
+%endif
+    RET
+
+%if ARCH_X86_64
+; 16x16 as four 8x8 blocks: each register holds rows k and k+8.
+cglobal pixel_sa8d_16x16, 4,8,12
+    vbroadcasti64x4 m11, [hmul_16p]
+    lea        r4, [3*r1]
+    lea        r5, [3*r3]
+    lea        r6, [r0+8*r1]
+    lea        r7, [r2+8*r3]
+    LOAD_SUMSUB_2x16P_AVX512 0, 8, 9, 11, [r0],      [r6],      [r2],      [r7]
+    LOAD_SUMSUB_2x16P_AVX512 1, 8, 9, 11, [r0+r1],   [r6+r1],   [r2+r3],   [r7+r3]
+    LOAD_SUMSUB_2x16P_AVX512 2, 8, 9, 11, [r0+2*r1], [r6+2*r1], [r2+2*r3], [r7+2*r3]
+    LOAD_SUMSUB_2x16P_AVX512 3, 8, 9, 11, [r0+r4],   [r6+r4],   [r2+r5],   [r7+r5]
+    lea        r0, [r0+4*r1]
+    lea        r6, [r6+4*r1]
+    lea        r2, [r2+4*r3]
+    lea        r7, [r7+4*r3]
+    LOAD_SUMSUB_2x16P_AVX512 4, 8, 9, 11, [r0],      [r6],      [r2],      [r7]
+    LOAD_SUMSUB_2x16P_AVX512 5, 8, 9, 11, [r0+r1],   [r6+r1],   [r2+r3],   [r7+r3]
+    LOAD_SUMSUB_2x16P_AVX512 6, 8, 9, 11, [r0+2*r1], [r6+2*r1], [r2+2*r3], [r7+2*r3]
+    LOAD_SUMSUB_2x16P_AVX512 7, 8, 9, 11, [r0+r4],   [r6+r4],   [r2+r5],   [r7+r5]
+    SUMSUB_BADC w, 0, 1, 2, 3, 8
+    SUMSUB_BADC w, 4, 5, 6, 7, 8
+    SUMSUB_BADC w, 0, 2, 1, 3, 8
+    SUMSUB_BADC w, 4, 6, 5, 7, 8
+    SUMSUB_BADC w, 0, 4, 1, 5, 8
+    SUMSUB_BADC w, 2, 6, 3, 7, 8
+    AC8_AVX512 0, 8, 9
+    AC8_AVX512 1, 8, 9
+    AC8_AVX512 2, 8, 9
+    AC8_AVX512 3, 8, 9
+    AC8_AVX512 4, 8, 9
+    AC8_AVX512 5, 8, 9
+    AC8_AVX512 6, 8, 9
+    AC8_AVX512 7, 8, 9
+    paddw      m0, m1
+    paddw      m2, m3
+    paddw      m4, m5
+    paddw      m6, m7
+    paddw      m0, m2
+    paddw      m4, m6
+    paddw      m0, m4
+    HADDAMAX_AVX512 0, 1
+    movd      eax, xm0
+    add       eax, 1
+    shr       eax, 1
+    RET
+
+%macro LOAD_DUP_2x16P_HMUL_AVX512 5 ; dst, tmp, mul, row a, row b
+    LOAD_DUP_2x16P_AVX512 %1, %2, %4, %5
+    pmaddubsw  m%1, m%3
+%endmacro
+
+; The DC is taken from the s-lanes of the first vertical output: it is the sum
+; of all pixels, which (2*amax - dc) has to remove from both the 4x4 and 8x8 sums.
+cglobal pixel_hadamard_ac_16x16, 2,4,14
+    vbroadcasti64x4 m11, [hmul_16p]
+    lea        r2, [r0+8*r1]
+    lea        r3, [3*r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 0, 8, 11, [r0],      [r2]
+    LOAD_DUP_2x16P_HMUL_AVX512 1, 8, 11, [r0+r1],   [r2+r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 2, 8, 11, [r0+2*r1], [r2+2*r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 3, 8, 11, [r0+r3],   [r2+r3]
+    lea        r0, [r0+4*r1]
+    lea        r2, [r2+4*r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 4, 8, 11, [r0],      [r2]
+    LOAD_DUP_2x16P_HMUL_AVX512 5, 8, 11, [r0+r1],   [r2+r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 6, 8, 11, [r0+2*r1], [r2+2*r1]
+    LOAD_DUP_2x16P_HMUL_AVX512 7, 8, 11, [r0+r3],   [r2+r3]
+    HADAMARD4_V 0, 1, 2, 3, 8
+    HADAMARD4_V 4, 5, 6, 7, 8
+    pabsw     m10, m0
+    psrld      m9, m10, 16
+    pmaxsw    m10, m9
+%assign i 1
+%rep 7
+    pabsw      m8, m %+ i
+    psrld      m9, m8, 16
+    pmaxsw     m8, m9
+    paddw     m10, m8
+%assign i i+1
+%endrep
+    SUMSUB_BADC w, 0, 4, 1, 5, 8
+    SUMSUB_BADC w, 2, 6, 3, 7, 8
+    vextracti32x4 xm13, m0, 2
+    paddw     xm13, xm0
+    pmaddwd   xm13, [pw_1]
+    HADDD     xm13, xm8
+    AC8_AVX512 0, 8, 9
+    AC8_AVX512 1, 8, 9
+    AC8_AVX512 2, 8, 9
+    AC8_AVX512 3, 8, 9
+    AC8_AVX512 4, 8, 9
+    AC8_AVX512 5, 8, 9
+    AC8_AVX512 6, 8, 9
+    AC8_AVX512 7, 8, 9
+    paddw      m0, m1
+    paddw      m2, m3
+    paddw      m4, m5
+    paddw      m6, m7
+    paddw      m0, m2
+    paddw      m4, m6
+    paddw      m0, m4
+    HADDAMAX_AVX512 10, 8
+    HADDAMAX_AVX512 0, 8
+    movd      eax, xm10
+    movd      edx, xm0
+    movd      r2d, xm13
+    add       eax, eax
+    add       edx, edx
+    sub       eax, r2d
+    sub       edx, r2d
+    shr       eax, 1
+    shr       edx, 2
+    shl       rdx, 32
+    add       rax, rdx
+    RET
+%endif ; ARCH_X86_64
+%endif ; HAVE_AVX512
 %endif ; HIGH_BIT_DEPTH
 
 ;=============================================================================
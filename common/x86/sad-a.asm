@@ -1548,6 +1548,127 @@ SAD_X_AVX2 3, 16,  8, 7
 SAD_X_AVX2 4, 16, 16, 8
 SAD_X_AVX2 4, 16,  8, 8
 
+%if HAVE_AVX512
+; Each zmm holds 4 rows of 16 pixels; the 4 rows of fenc are contiguous
+; since FENC_STRIDE == 16.
+%macro LOAD_4x16P_AVX512 4 ; dst, src, stride, stride*3
+    movu         xm%1, [%2]
+    vinserti32x4  m%1, m%1, [%2+%3], 1
+    vinserti32x4  m%1, m%1, [%2+%3*2], 2
+    vinserti32x4  m%1, m%1, [%2+%4], 3
+%endmacro
+
+%macro SAD_X3_4x16P_AVX512 2
+    movu    m3, [r0+%1*4*FENC_STRIDE]
+%if %1==0
+    lea     t0, [r4*3]
+    LOAD_4x16P_AVX512 0, r1, r4, t0
+    LOAD_4x16P_AVX512 1, r2, r4, t0
+    LOAD_4x16P_AVX512 2, r3, r4, t0
+    psadbw  m0, m3
+    psadbw  m1, m3
+    psadbw  m2, m3
+%else
+    LOAD_4x16P_AVX512 4, r1, r4, t0
+    psadbw  m4, m3
+    paddw   m0, m4
+    LOAD_4x16P_AVX512 4, r2, r4, t0
+    psadbw  m4, m3
+    paddw   m1, m4
+    LOAD_4x16P_AVX512 4, r3, r4, t0
+    psadbw  m4, m3
+    paddw   m2, m4
+%endif
+%if %1 != %2-1
+    lea     r1, [r1+4*r4]
+    lea     r2, [r2+4*r4]
+    lea     r3, [r3+4*r4]
+%endif
+%endmacro
+
+%macro SAD_X4_4x16P_AVX512 2
+    movu    m4, [r0+%1*4*FENC_STRIDE]
+%if %1==0
+    lea     r6, [r5*3]
+    LOAD_4x16P_AVX512 0, r1, r5, r6
+    LOAD_4x16P_AVX512 1, r2, r5, r6
+    LOAD_4x16P_AVX512 2, r3, r5, r6
+    LOAD_4x16P_AVX512 3, r4, r5, r6
+    psadbw  m0, m4
+    psadbw  m1, m4
+    psadbw  m2, m4
+    psadbw  m3, m4
+%else
+    LOAD_4x16P_AVX512 5, r1, r5, r6
+    psadbw  m5, m4
+    paddw   m0, m5
+    LOAD_4x16P_AVX512 5, r2, r5, r6
+    psadbw  m5, m4
+    paddw   m1, m5
+    LOAD_4x16P_AVX512 5, r3, r5, r6
+    psadbw  m5, m4
+    paddw   m2, m5
+    LOAD_4x16P_AVX512 5, r4, r5, r6
+    psadbw  m5, m4
+    paddw   m3, m5
+%endif
+%if %1 != %2-1
+    lea     r1, [r1+4*r5]
+    lea     r2, [r2+4*r5]
+    lea     r3, [r3+4*r5]
+    lea     r4, [r4+4*r5]
+%endif
+%endmacro
+
+; the low dword of each qword holds a partial sum, so merge pairs of scores
+; into single qwords and then reduce all 4 128-bit lanes at once
+%macro SAD_X_REDUCE_AVX512 0
+    punpckhqdq m1, m0, m2
+    punpcklqdq m0, m2
+    paddd      m0, m1       ; 0 1 2 3 0 1 2 3 0 1 2 3 0 1 2 3
+    vextracti64x4 ym1, m0, 1
+    paddd     ym0, ym1
+    vextracti128  xm1, ym0, 1
+    paddd     xm0, xm1      ; 0 1 2 3
+%endmacro
+
+%macro SAD_X3_END_AVX512 0
+    movifnidn r5, r5mp
+    psllq     m1, 32
+    paddd     m0, m1        ; 0 1 0 1 ...
+    SAD_X_REDUCE_AVX512
+    mova    [r5], xm0
+    RET
+%endmacro
+
+%macro SAD_X4_END_AVX512 0
+    mov       r0, r6mp
+    psllq     m1, 32
+    psllq     m3, 32
+    paddd     m0, m1        ; 0 1 0 1 ...
+    paddd     m2, m3        ; 2 3 2 3 ...
+    SAD_X_REDUCE_AVX512
+    mova    [r0], xm0
+    RET
+%endmacro
+
+%macro SAD_X_AVX512 4
+cglobal pixel_sad_x%1_%2x%3, 2+%1,3+%1,%4
+%assign x 0
+%rep %3/4
+    SAD_X%1_4x%2P_AVX512 x, %3/4
+%assign x x+1
+%endrep
+    SAD_X%1_END_AVX512
+%endmacro
+
+INIT_ZMM avx512
+SAD_X_AVX512 3, 16, 16, 5
+SAD_X_AVX512 3, 16,  8, 5
+SAD_X_AVX512 4, 16, 16, 6
+SAD_X_AVX512 4, 16,  8, 6
+%endif ; HAVE_AVX512
+
 ;=============================================================================
 ; SAD cacheline split
 ;=============================================================================
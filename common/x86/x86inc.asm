@@ -484,12 +484,12 @@ DECLARE_REG 14, R15, 120
     %assign xmm_regs_used 0
 %endmacro
 
-%define has_epilogue regs_used > 7 || xmm_regs_used > 6 || mmsize == 32 || stack_size > 0
+%define has_epilogue regs_used > 7 || xmm_regs_used > 6 || mmsize >= 32 || stack_size > 0
 
 %macro RET 0
     WIN64_RESTORE_XMM_INTERNAL rsp
     POP_IF_USED 14, 13, 12, 11, 10, 9, 8, 7
-%if mmsize == 32
+%if mmsize >= 32
     vzeroupper
 %endif
     AUTO_REP_RET
@@ -525,7 +525,7 @@ DECLARE_REG 14, R15, 72
     DEFINE_ARGS_INTERNAL %0, %4, %5
 %endmacro
 
-%define has_epilogue regs_used > 9 || mmsize == 32 || stack_size > 0
+%define has_epilogue regs_used > 9 || mmsize >= 32 || stack_size > 0
 
 %macro RET 0
 %if stack_size_padded > 0
@@ -536,7 +536,7 @@ DECLARE_REG 14, R15, 72
 %endif
 %endif
     POP_IF_USED 14, 13, 12, 11, 10, 9
-%if mmsize == 32
+%if mmsize >= 32
     vzeroupper
 %endif
     AUTO_REP_RET
@@ -581,7 +581,7 @@ DECLARE_ARG 7, 8, 9, 10, 11, 12, 13, 14
     DEFINE_ARGS_INTERNAL %0, %4, %5
 %endmacro
 
-%define has_epilogue regs_used > 3 || mmsize == 32 || stack_size > 0
+%define has_epilogue regs_used > 3 || mmsize >= 32 || stack_size > 0
 
 %macro RET 0
 %if stack_size_padded > 0
@@ -592,7 +592,7 @@ DECLARE_ARG 7, 8, 9, 10, 11, 12, 13, 14
 %endif
 %endif
     POP_IF_USED 6, 5, 4, 3
-%if mmsize == 32
+%if mmsize >= 32
     vzeroupper
 %endif
     AUTO_REP_RET
@@ -751,6 +751,7 @@ BRANCH_INSTR jz, je, jnz, jne, jl, jle, jnl, jnle, jg, jge, jng, jnge, ja, jae,
 %assign cpuflags_fma4     (1<<13)| cpuflags_avx
 %assign cpuflags_fma3     (1<<14)| cpuflags_avx
 %assign cpuflags_avx2     (1<<15)| cpuflags_fma3
+%assign cpuflags_avx512   (1<<24)| cpuflags_avx2 ; F, CD, BW, DQ, VL
 
 %assign cpuflags_cache32  (1<<16)
 %assign cpuflags_cache64  (1<<17)
@@ -818,7 +819,8 @@ BRANCH_INSTR jz, je, jnz, jne, jl, jle, jnl, jnle, jg, jge, jng, jnge, ja, jae,
 ; m# is a simd register of the currently selected size
 ; xm# is the corresponding xmm register if mmsize >= 16, otherwise the same as m#
 ; ym# is the corresponding ymm register if mmsize >= 32, otherwise the same as m#
-; (All 3 remain in sync through SWAP.)
+; zm# is the corresponding zmm register if mmsize >= 64, otherwise the same as m#
+; (All 4 remain in sync through SWAP.)
 
 %macro CAT_XDEFINE 3
     %xdefine %1%2 %3
@@ -893,6 +895,29 @@ BRANCH_INSTR jz, je, jnz, jne, jl, jle, jnl, jnle, jg, jge, jng, jnge, ja, jae,
     INIT_CPUFLAGS %1
 %endmacro
 
+; AVX-512 has no VEX-style encodings of the unsized integer moves and logic ops,
+; so functions using zmm registers have to spell out vpandd/vpord/vpxord etc.
+%macro INIT_ZMM 0-1+
+    %assign avx_enabled 1
+    %define RESET_MM_PERMUTATION INIT_ZMM %1
+    %define mmsize 64
+    %define num_mmregs 8
+    %if ARCH_X86_64
+    %define num_mmregs 16
+    %endif
+    %define mova vmovdqa32
+    %define movu vmovdqu32
+    %undef movh
+    %define movnta vmovntdq
+    %assign %%i 0
+    %rep num_mmregs
+    CAT_XDEFINE m, %%i, zmm %+ %%i
+    CAT_XDEFINE nnzmm, %%i, %%i
+    %assign %%i %%i+1
+    %endrep
+    INIT_CPUFLAGS %1
+%endmacro
+
 INIT_XMM
 
 %macro DECLARE_MMCAST 1
@@ -905,8 +930,15 @@ INIT_XMM
     %define ymmmm%1   mm%1
     %define ymmxmm%1 xmm%1
     %define ymmymm%1 ymm%1
+    %define ymmzmm%1 ymm%1
+    %define xmmzmm%1 xmm%1
+    %define zmmmm%1   mm%1
+    %define zmmxmm%1 xmm%1
+    %define zmmymm%1 ymm%1
+    %define zmmzmm%1 zmm%1
     %define xm%1 xmm %+ m%1
     %define ym%1 ymm %+ m%1
+    %define zm%1 zmm %+ m%1
 %endmacro
 
 %assign i 0
@@ -1047,6 +1079,7 @@ INIT_XMM
     %endif
     CAT_XDEFINE sizeofxmm, i, 16
     CAT_XDEFINE sizeofymm, i, 32
+    CAT_XDEFINE sizeofzmm, i, 64
 %assign i i+1
 %endrep
 %undef i
@@ -179,6 +179,13 @@ typedef struct
     int b_direct_available;
     int b_early_terminate;
 
+    int i_hint_ref; /* reference of the loaded analysis of this mb, -1 if none */
+    ALIGNED_4( int16_t hint_mv[2] );
+
+    int i_part_ctx; /* context of the sub-16x16 partition search, -1 if not tracked */
+    int i_part_bucket;
+    int b_part_probe;
+
 } x264_mb_analysis_t;
 
 /* lambda = pow(2,qp/6-2) */
@@ -352,7 +359,7 @@ int x264_analyse_init_costs( x264_t *h, float *logs, int qp )
         for( int j = 0; j < 33; j++ )
             x264_cost_ref[qp][i][j] = X264_MIN( i ? lambda * bs_size_te( i, j ) : 0, (1<<16)-1 );
     x264_pthread_mutex_unlock( &cost_ref_mutex );
-    if( h->param.analyse.i_me_method >= X264_ME_ESA && !h->cost_mv_fpel[qp][0] )
+    if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) && !h->cost_mv_fpel[qp][0] )
     {
         for( int j = 0; j < 4; j++ )
         {
@@ -498,6 +505,7 @@ static void x264_mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
 
     a->b_fast_intra = 0;
     a->b_avoid_topright = 0;
+    a->i_part_ctx = -1;
     h->mb.i_skip_intra =
         h->mb.b_lossless ? 0 :
         a->i_mbrd ? 2 :
@@ -539,7 +547,17 @@ static void x264_mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
                 for( int i = (h->sh.i_type == SLICE_TYPE_B); i >= 0; i-- )
                     for( int j = 0; j < h->i_ref[i]; j++ )
                     {
-                        x264_frame_cond_wait( h->fref[i][j]->orig, thresh );
+                        int lines_available;
+                        int64_t stall = x264_frame_cond_wait( h->fref[i][j]->orig, thresh, &lines_available );
+                        if( stall )
+                        {
+                            int stall_range = lines_available - pix_y;
+                            if( !h->stat.frame.i_stall_count || stall_range < h->stat.frame.i_stall_mvy_range )
+                                h->stat.frame.i_stall_mvy_range = stall_range;
+                            h->stat.frame.i_stall_count++;
+                            h->stat.frame.i_stall_time += stall;
+                            h->stat.frame_time.i_wait += stall;
+                        }
                         thread_mvy_range = X264_MIN( thread_mvy_range, h->fref[i][j]->orig->i_lines_completed - pix_y );
                     }
 
@@ -590,6 +608,22 @@ static void x264_mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
         }
 #undef CLIP_FMV
 
+        /* A loaded analysis narrows the 16x16 search of P-mbs to its reference
+         * and mv, and all searches of the mb to at most a hexagon.  The blind
+         * duplicate of ref 0 is only a weighted copy of it, so it stands for ref 0. */
+        a->i_hint_ref = -1;
+        if( h->fenc->b_analysis )
+        {
+            x264_analysis_mb_t *hint = &h->fenc->analysis[h->mb.i_mb_xy];
+            h->mb.i_me_method = h->param.analyse.i_me_method;
+            if( !IS_INTRA( hint->i_type ) && hint->i_ref[0] >= 0 && hint->i_ref[0] < h->mb.pic.i_fref[0] )
+            {
+                a->i_hint_ref = hint->i_ref[0] == h->mb.ref_blind_dupe ? 0 : hint->i_ref[0];
+                CP32( a->hint_mv, hint->mv[0] );
+                h->mb.i_me_method = X264_MIN( h->mb.i_me_method, X264_ME_HEX );
+            }
+        }
+
         a->l0.me16x16.cost =
         a->l0.i_rd16x16    =
         a->l0.i_cost8x8    =
@@ -1519,11 +1553,97 @@ static void x264_intra_rd_refine( x264_t *h, x264_mb_analysis_t *a )
 #define REF_COST(list, ref) \
     (a->p_cost_ref[list][ref])
 
+/* --me pyr: the lowres mv the lookahead found for this mb, from the searched
+ * distance nearest to that of the reference and scaled to it.  Returns 0 if the
+ * lookahead has no vectors for the list. */
+static int x264_mb_analyse_lowres_mv( x264_t *h, int i_list, int i_ref, int16_t mv[2] )
+{
+    if( !h->frames.b_have_lowres_mvs || PARAM_INTERLACED )
+        return 0;
+    int i_dist = abs( h->fenc->i_frame - h->fref[i_list][i_ref]->i_frame );
+    int i_best = 0;
+    for( int d = 1; d <= h->param.i_bframe+1; d++ )
+        if( h->fenc->lowres_mvs[i_list][d-1][0][0] != 0x7FFF &&
+            (!i_best || abs( d - i_dist ) < abs( i_best - i_dist )) )
+            i_best = d;
+    if( !i_best || !i_dist )
+        return 0;
+    int16_t *lowres_mv = h->fenc->lowres_mvs[i_list][i_best-1][h->mb.i_mb_xy];
+    mv[0] = x264_clip3( 2 * lowres_mv[0] * i_dist / i_best, h->mb.mv_min_spel[0], h->mb.mv_max_spel[0] );
+    mv[1] = x264_clip3( 2 * lowres_mv[1] * i_dist / i_best, h->mb.mv_min_spel[1], h->mb.mv_max_spel[1] );
+    return 1;
+}
+
+/* --me-multiref: ranks the references of a 16x16 search by their cost at the
+ * rounded predicted mv, compared four references at a time.  Ref 0 stays first
+ * for the skip checks, then the best ranked half of the references (at least 4)
+ * are searched best first, which also tightens the halfpel threshold shared
+ * between references sooner.  Fills order with all references of the list and
+ * returns the number to search. */
+static int x264_mb_analyse_16x16_refs( x264_t *h, x264_mb_analysis_t *a, int i_list, int8_t *order )
+{
+    int i_fref = h->mb.pic.i_fref[i_list];
+    for( int i = 0; i < i_fref; i++ )
+        order[i] = i;
+    if( !h->param.analyse.b_me_multiref || !a->b_early_terminate || i_fref <= 4 || a->i_hint_ref >= 0 )
+        return i_fref;
+
+    ALIGNED_ARRAY_16( int, sad,[4] );
+    int16_t mvp[2];
+    int cost[X264_REF_MAX*2];
+    pixel *src[4];
+    intptr_t stride = h->mb.pic.i_stride[0];
+    /* ref 0 keeps its place, so only the others are costed, four at a time from ref 1 */
+    for( int i_ref = 1; i_ref < i_fref; i_ref++ )
+    {
+        x264_mb_predict_mv_16x16( h, i_list, i_ref, mvp );
+        int mx = x264_clip3( (mvp[0]+2)>>2, h->mb.mv_limit_fpel[0][0], h->mb.mv_limit_fpel[1][0] );
+        int my = x264_clip3( (mvp[1]+2)>>2, h->mb.mv_limit_fpel[0][1], h->mb.mv_limit_fpel[1][1] );
+        pixel *p_fref = h->sh.i_type == SLICE_TYPE_P ? h->mb.pic.p_fref_w[i_ref] : h->mb.pic.p_fref[i_list][i_ref][0];
+        src[(i_ref-1)&3] = &p_fref[my*stride + mx];
+        cost[i_ref] = REF_COST( i_list, i_ref ) + a->p_cost_mv[4*mx - mvp[0]] + a->p_cost_mv[4*my - mvp[1]];
+        if( ((i_ref-1)&3) == 3 )
+        {
+            h->pixf.fpelcmp_x4[PIXEL_16x16]( h->mb.pic.p_fenc[0], src[0], src[1], src[2], src[3], stride, sad );
+            for( int i = 0; i < 4; i++ )
+                cost[i_ref-3+i] += sad[i];
+        }
+    }
+    for( int i_ref = ((i_fref-1)&~3) + 1; i_ref < i_fref; i_ref++ )
+        cost[i_ref] += h->pixf.fpelcmp[PIXEL_16x16]( h->mb.pic.p_fenc[0], FENC_STRIDE, src[(i_ref-1)&3], stride );
+
+    for( int i_ref = 2; i_ref < i_fref; i_ref++ )
+    {
+        int i = i_ref;
+        for( ; i > 1 && cost[order[i-1]] > cost[i_ref]; i-- )
+            order[i] = order[i-1];
+        order[i] = i_ref;
+    }
+    return X264_MAX( i_fref >> 1, 4 );
+}
+
+/* The best mv, scaled to the distance of each reference that wasn't searched,
+ * stands in as a predictor for neighbours and partitions. */
+static void x264_mb_analyse_16x16_unsearched( x264_t *h, x264_mb_analysis_list_t *lX, int i_list, int8_t *order, int i_refs )
+{
+    int i_dist_best = X264_MAX( abs( h->fdec->i_poc - h->fref[i_list][lX->me16x16.i_ref>>SLICE_MBAFF]->i_poc ), 1 );
+    for( int i = i_refs; i < h->mb.pic.i_fref[i_list]; i++ )
+    {
+        int i_ref = order[i];
+        int i_dist = abs( h->fdec->i_poc - h->fref[i_list][i_ref>>SLICE_MBAFF]->i_poc );
+        int16_t *mv = h->mb.mvr[i_list][i_ref][h->mb.i_mb_xy];
+        mv[0] = x264_clip3( lX->me16x16.mv[0] * i_dist / i_dist_best, h->mb.mv_min_spel[0], h->mb.mv_max_spel[0] );
+        mv[1] = x264_clip3( lX->me16x16.mv[1] * i_dist / i_dist_best, h->mb.mv_min_spel[1], h->mb.mv_max_spel[1] );
+        CP32( lX->mvc[i_ref][0], mv );
+    }
+}
+
 static void x264_mb_analyse_inter_p16x16( x264_t *h, x264_mb_analysis_t *a )
 {
     x264_me_t m;
     int i_mvc;
     ALIGNED_4( int16_t mvc[8][2] );
+    int8_t ref_order[X264_REF_MAX*2];
     int i_halfpel_thresh = INT_MAX;
     int *p_halfpel_thresh = (a->b_early_terminate && h->mb.pic.i_fref[0]>1) ? &i_halfpel_thresh : NULL;
 
@@ -1532,8 +1652,19 @@ static void x264_mb_analyse_inter_p16x16( x264_t *h, x264_mb_analysis_t *a )
     LOAD_FENC( &m, h->mb.pic.p_fenc, 0, 0 );
 
     a->l0.me16x16.cost = INT_MAX;
-    for( int i_ref = 0; i_ref < h->mb.pic.i_fref[0]; i_ref++ )
+    int i_refs = x264_mb_analyse_16x16_refs( h, a, 0, ref_order );
+    for( int i = 0; i < i_refs; i++ )
     {
+        int i_ref = ref_order[i];
+        /* with a loaded analysis, search only its ref (and the duplicate of ref 0 if that is it) */
+        if( a->i_hint_ref >= 0 && i_ref != a->i_hint_ref && (a->i_hint_ref || i_ref != h->mb.ref_blind_dupe) )
+        {
+            /* the hinted mv stands in as a predictor for neighbours and partitions */
+            CP32( h->mb.mvr[0][i_ref][h->mb.i_mb_xy], a->hint_mv );
+            CP32( a->l0.mvc[i_ref][0], a->hint_mv );
+            continue;
+        }
+
         m.i_ref_cost = REF_COST( 0, i_ref );
         i_halfpel_thresh -= m.i_ref_cost;
 
@@ -1551,6 +1682,13 @@ static void x264_mb_analyse_inter_p16x16( x264_t *h, x264_mb_analysis_t *a )
         else
         {
             x264_mb_predict_mv_ref16x16( h, 0, i_ref, mvc, &i_mvc );
+            if( a->i_hint_ref >= 0 )
+            {
+                CP32( mvc[X264_MIN( i_mvc, 7 )], a->hint_mv );
+                i_mvc = X264_MIN( i_mvc+1, 8 );
+            }
+            else if( h->mb.i_me_method == X264_ME_PYR && x264_mb_analyse_lowres_mv( h, 0, i_ref, mvc[X264_MIN( i_mvc, 7 )] ) )
+                i_mvc = X264_MIN( i_mvc+1, 8 );
             x264_me_search_ref( h, &m, mvc, i_mvc, p_halfpel_thresh );
         }
 
@@ -1580,6 +1718,7 @@ static void x264_mb_analyse_inter_p16x16( x264_t *h, x264_mb_analysis_t *a )
             h->mc.memcpy_aligned( &a->l0.me16x16, &m, sizeof(x264_me_t) );
     }
 
+    x264_mb_analyse_16x16_unsearched( h, &a->l0, 0, ref_order, i_refs );
     x264_macroblock_cache_ref( h, 0, 0, 4, 4, 0, a->l0.me16x16.i_ref );
     assert( a->l0.me16x16.mv[1] <= h->mb.mv_max_spel[1] || h->i_thread_frames == 1 );
 
@@ -2162,8 +2301,10 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
     ALIGNED_ARRAY_N( pixel, pix1,[16*16] );
     pixel *src0, *src1;
     intptr_t stride0 = 16, stride1 = 16;
-    int i_ref, i_mvc;
+    int i, i_ref, i_mvc;
     ALIGNED_4( int16_t mvc[9][2] );
+    int8_t ref_order[2][X264_REF_MAX*2];
+    int i_refs[2];
     int try_skip = a->b_try_skip;
     int list1_skipped = 0;
     int i_halfpel_thresh[2] = {INT_MAX, INT_MAX};
@@ -2178,6 +2319,10 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
     /* 16x16 Search on list 0 and list 1 */
     a->l0.me16x16.cost = INT_MAX;
     a->l1.me16x16.cost = INT_MAX;
+    i_refs[0] = x264_mb_analyse_16x16_refs( h, a, 0, ref_order[0] );
+    i_refs[1] = h->mb.pic.i_fref[1];
+    for( i = 0; i < i_refs[1]; i++ )
+        ref_order[1][i] = i;
     for( int l = 1; l >= 0; )
     {
         x264_mb_analysis_list_t *lX = l ? &a->l1 : &a->l0;
@@ -2190,8 +2335,9 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
          * 4.  Search the rest of list0.
          * 5.  Go back and finish list1.
          */
-        for( i_ref = (list1_skipped && l == 1) ? 1 : 0; i_ref < h->mb.pic.i_fref[l]; i_ref++ )
+        for( i = (list1_skipped && l == 1) ? 1 : 0; i < i_refs[l]; i++ )
         {
+            i_ref = ref_order[l][i];
             if( try_skip && l == 1 && i_ref > 0 )
             {
                 list1_skipped = 1;
@@ -2204,6 +2350,8 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
             LOAD_HPELS( &m, h->mb.pic.p_fref[l][i_ref], l, i_ref, 0, 0 );
             x264_mb_predict_mv_16x16( h, l, i_ref, m.mvp );
             x264_mb_predict_mv_ref16x16( h, l, i_ref, mvc, &i_mvc );
+            if( h->mb.i_me_method == X264_ME_PYR && x264_mb_analyse_lowres_mv( h, l, i_ref, mvc[X264_MIN( i_mvc, 8 )] ) )
+                i_mvc = X264_MIN( i_mvc+1, 9 );
             x264_me_search_ref( h, &m, mvc, i_mvc, p_halfpel_thresh[l] );
 
             /* add ref cost */
@@ -2233,7 +2381,7 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
                 }
             }
         }
-        if( list1_skipped && l == 1 && i_ref == h->mb.pic.i_fref[1] )
+        if( list1_skipped && l == 1 && i == h->mb.pic.i_fref[1] )
             break;
         if( list1_skipped && l == 0 )
             l = 1;
@@ -2241,6 +2389,8 @@ static void x264_mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
             l--;
     }
 
+    x264_mb_analyse_16x16_unsearched( h, &a->l0, 0, ref_order[0], i_refs[0] );
+
     /* get cost of BI mode */
     h->mc.memcpy_aligned( &a->l0.bi16x16, &a->l0.me16x16, sizeof(x264_me_t) );
     h->mc.memcpy_aligned( &a->l1.bi16x16, &a->l1.me16x16, sizeof(x264_me_t) );
@@ -3193,6 +3343,67 @@ static inline void x264_mb_analyse_qp_rd( x264_t *h, x264_mb_analysis_t *a )
     }
 }
 
+/* A context whose sub-16x16 search has ended in a split less than once in
+ * PART_STAT_RATIO times is skipped, once it has seen PART_STAT_MIN searches.
+ * One search in PART_STAT_PROBE is still run there, so the statistics follow
+ * changes in the content. */
+#define PART_STAT_MIN   32
+#define PART_STAT_RATIO 32
+#define PART_STAT_PROBE 8
+#define PART_STAT_DECAY 1024
+
+/* Decides whether to search the sub-16x16 partitions of a P macroblock, from
+ * how often they were chosen so far in the same context: the number of split
+ * neighbours and the 16x16 cost relative to lambda. */
+static int x264_mb_analyse_p_part_search( x264_t *h, x264_mb_analysis_t *a )
+{
+    a->i_part_ctx = -1;
+    if( !h->param.analyse.b_adaptive_partitions || !a->b_early_terminate )
+        return 1;
+
+    int ctx = 0;
+    if( h->mb.i_neighbour & MB_LEFT )
+        ctx += h->mb.partition[h->mb.i_mb_left_xy[0]] != D_16x16;
+    if( h->mb.i_neighbour & MB_TOP )
+        ctx += h->mb.partition[h->mb.i_mb_top_xy] != D_16x16;
+    int bucket = x264_log2( a->l0.me16x16.cost / a->i_lambda + 1 ) * 2;
+    bucket = X264_MIN( bucket, X264_PART_STAT_BUCKETS-1 );
+
+    a->b_part_probe = 0;
+    if( h->mb.part_stat[ctx][bucket].i_search >= PART_STAT_MIN &&
+        h->mb.part_stat[ctx][bucket].i_split * PART_STAT_RATIO < h->mb.part_stat[ctx][bucket].i_search )
+    {
+        if( ++h->mb.part_stat[ctx][bucket].i_skip < PART_STAT_PROBE )
+        {
+            h->stat.frame.i_part_skip++;
+            return 0;
+        }
+        h->mb.part_stat[ctx][bucket].i_skip = 0;
+        a->b_part_probe = 1;
+        h->stat.frame.i_part_probe++;
+    }
+    a->i_part_ctx = ctx;
+    a->i_part_bucket = bucket;
+    h->stat.frame.i_part_search++;
+    return 1;
+}
+
+static void x264_mb_analyse_p_part_update( x264_t *h, x264_mb_analysis_t *a, int b_split )
+{
+    if( a->i_part_ctx < 0 )
+        return;
+    int ctx = a->i_part_ctx, bucket = a->i_part_bucket;
+    h->mb.part_stat[ctx][bucket].i_search++;
+    h->mb.part_stat[ctx][bucket].i_split += b_split;
+    if( h->mb.part_stat[ctx][bucket].i_search >= PART_STAT_DECAY )
+    {
+        h->mb.part_stat[ctx][bucket].i_search >>= 1;
+        h->mb.part_stat[ctx][bucket].i_split >>= 1;
+    }
+    if( a->b_part_probe )
+        h->stat.frame.i_part_probe_split += b_split;
+}
+
 /*****************************************************************************
  * x264_macroblock_analyse:
  *****************************************************************************/
@@ -3344,7 +3555,7 @@ skip_analysis:
                 return;
             }
 
-            if( flags & X264_ANALYSE_PSUB16x16 )
+            if( (flags & X264_ANALYSE_PSUB16x16) && x264_mb_analyse_p_part_search( h, &analysis ) )
             {
                 if( h->param.analyse.b_mixed_references )
                     x264_mb_analyse_inter_p8x8_mixed_ref( h, &analysis );
@@ -3561,6 +3772,7 @@ skip_analysis:
             }
 
             h->mb.i_type = i_type;
+            x264_mb_analyse_p_part_update( h, &analysis, i_type == P_8x8 || (i_type == P_L0 && i_partition != D_16x16) );
 
             if( analysis.b_force_intra && !IS_INTRA(i_type) )
             {
@@ -44,4 +44,17 @@ void x264_lookahead_put_frame( x264_t *h, x264_frame_t *frame );
 void x264_lookahead_get_frames( x264_t *h );
 void x264_lookahead_delete( x264_t *h );
 
+int  x264_lookahead_cache_init( x264_t *h );
+void x264_lookahead_cache_delete( x264_t *h );
+int  x264_lookahead_cache_slice_type( x264_t *h, int i_frame );
+int  x264_lookahead_cache_write( x264_t *h );
+int  x264_lookahead_cache_read( x264_t *h, x264_frame_t *frame );
+int  x264_lookahead_cache_costs( x264_t *h );
+
+int  x264_analysis_init( x264_t *h );
+void x264_analysis_delete( x264_t *h );
+void x264_analysis_save_mb( x264_t *h );
+int  x264_analysis_write( x264_t *h, x264_frame_t *frame );
+void x264_analysis_read( x264_t *h, x264_frame_t *frame );
+
 #endif
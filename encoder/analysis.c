@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * analysis.c: saving and loading of macroblock analysis
+ *****************************************************************************
+ * Copyright (C) 2003-2015 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "analyse.h"
+
+/* File layout, in native byte order:
+ *   header: int32 magic, version, width, height, mb_width, mb_height
+ *   then for each frame, in coded order:
+ *     int32 frame number (display order), int32 frame type,
+ *     mb_width*mb_height x264_analysis_mb_t in raster order */
+
+#define ANALYSIS_MAGIC   0x61343678 /* "x64a" */
+#define ANALYSIS_VERSION 1
+
+static int analysis_frame_size( x264_t *h )
+{
+    return 2*sizeof(int32_t) + h->analysis.i_mb_width * h->analysis.i_mb_height * sizeof(x264_analysis_mb_t);
+}
+
+static int analysis_init_load( x264_t *h )
+{
+    FILE *fh = h->analysis.fh_load = x264_fopen( h->param.psz_analysis_load, "rb" );
+    if( !fh )
+    {
+        x264_log( h, X264_LOG_ERROR, "can't open analysis file `%s'\n", h->param.psz_analysis_load );
+        return -1;
+    }
+
+    int32_t header[6];
+    if( fread( header, sizeof(header), 1, fh ) != 1 || header[0] != ANALYSIS_MAGIC )
+    {
+        x264_log( h, X264_LOG_ERROR, "`%s' is not an analysis file\n", h->param.psz_analysis_load );
+        return -1;
+    }
+    if( header[1] != ANALYSIS_VERSION )
+    {
+        x264_log( h, X264_LOG_ERROR, "analysis file version %d is not supported\n", header[1] );
+        return -1;
+    }
+    h->analysis.i_width     = header[2];
+    h->analysis.i_height    = header[3];
+    h->analysis.i_mb_width  = header[4];
+    h->analysis.i_mb_height = header[5];
+    if( h->analysis.i_width <= 0 || h->analysis.i_height <= 0 ||
+        h->analysis.i_mb_width != (h->analysis.i_width+15)/16 ||
+        h->analysis.i_mb_height < (h->analysis.i_height+15)/16 ||
+        h->analysis.i_mb_height > (h->analysis.i_height+31)/32*2 )
+    {
+        x264_log( h, X264_LOG_ERROR, "invalid analysis file resolution %dx%d\n", h->analysis.i_width, h->analysis.i_height );
+        return -1;
+    }
+
+    /* Index the frames.  Frames are stored in coded order, so the frame number
+     * of each record is needed to find them again. */
+    int frame_size = analysis_frame_size( h );
+    int64_t file_size;
+    if( fseek( fh, 0, SEEK_END ) < 0 || (file_size = ftell( fh )) < 0 )
+        return -1;
+    h->analysis.i_offsets = (file_size - sizeof(header)) / frame_size;
+    CHECKED_MALLOC( h->analysis.p_offset, X264_MAX( h->analysis.i_offsets, 1 ) * sizeof(int64_t) );
+    for( int i = 0; i < h->analysis.i_offsets; i++ )
+        h->analysis.p_offset[i] = -1;
+    for( int i = 0; i < h->analysis.i_offsets; i++ )
+    {
+        int64_t offset = sizeof(header) + (int64_t)i * frame_size;
+        int32_t i_frame;
+        if( fseek( fh, offset, SEEK_SET ) < 0 || fread( &i_frame, sizeof(i_frame), 1, fh ) != 1 )
+            return -1;
+        if( i_frame >= 0 && i_frame < h->analysis.i_offsets )
+            h->analysis.p_offset[i_frame] = offset + sizeof(i_frame);
+    }
+
+    CHECKED_MALLOC( h->analysis.p_buffer, h->analysis.i_mb_width * h->analysis.i_mb_height * sizeof(x264_analysis_mb_t) );
+
+    x264_log( h, X264_LOG_DEBUG, "loaded analysis of %d frames at %dx%d\n",
+              h->analysis.i_offsets, h->analysis.i_width, h->analysis.i_height );
+    return 0;
+fail:
+    return -1;
+}
+
+int x264_analysis_init( x264_t *h )
+{
+    if( h->param.psz_analysis_load && PARAM_INTERLACED )
+    {
+        x264_log( h, X264_LOG_WARNING, "--analysis-load is not supported with interlaced encoding, ignoring\n" );
+        h->param.psz_analysis_load = NULL;
+    }
+
+    if( h->param.psz_analysis_load && analysis_init_load( h ) < 0 )
+        return -1;
+
+    if( h->param.psz_analysis_save )
+    {
+        h->analysis.fh_save = x264_fopen( h->param.psz_analysis_save, "wb" );
+        if( !h->analysis.fh_save )
+        {
+            x264_log( h, X264_LOG_ERROR, "can't open analysis file `%s' for writing\n", h->param.psz_analysis_save );
+            return -1;
+        }
+        int32_t header[6] = { ANALYSIS_MAGIC, ANALYSIS_VERSION, h->param.i_width, h->param.i_height,
+                              h->mb.i_mb_width, h->mb.i_mb_height };
+        if( fwrite( header, sizeof(header), 1, h->analysis.fh_save ) != 1 )
+        {
+            x264_log( h, X264_LOG_ERROR, "failed to write analysis file\n" );
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void x264_analysis_delete( x264_t *h )
+{
+    if( h->analysis.fh_save )
+        fclose( h->analysis.fh_save );
+    if( h->analysis.fh_load )
+        fclose( h->analysis.fh_load );
+    x264_free( h->analysis.p_offset );
+    x264_free( h->analysis.p_buffer );
+}
+
+/* Records the final decision of the current macroblock. */
+void x264_analysis_save_mb( x264_t *h )
+{
+    x264_analysis_mb_t *mb = &h->fdec->analysis[h->mb.i_mb_xy];
+    int i_lists = h->sh.i_type == SLICE_TYPE_B ? 2 : h->sh.i_type == SLICE_TYPE_P;
+
+    mb->i_type = h->mb.i_type;
+    mb->i_partition = h->mb.i_partition;
+    for( int l = 0; l < 2; l++ )
+    {
+        int i_ref = l < i_lists && !IS_INTRA( h->mb.i_type ) ? h->mb.cache.ref[l][x264_scan8[0]] : -1;
+        mb->i_ref[l] = X264_MAX( i_ref, -1 );
+        if( i_ref >= 0 )
+            CP32( mb->mv[l], h->mb.cache.mv[l][x264_scan8[0]] );
+        else
+            M32( mb->mv[l] ) = 0;
+    }
+}
+
+int x264_analysis_write( x264_t *h, x264_frame_t *frame )
+{
+    int32_t header[2] = { frame->i_frame, frame->i_type };
+    if( fwrite( header, sizeof(header), 1, h->analysis.fh_save ) != 1 ||
+        fwrite( frame->analysis, sizeof(x264_analysis_mb_t), h->mb.i_mb_count, h->analysis.fh_save ) != h->mb.i_mb_count )
+    {
+        x264_log( h, X264_LOG_ERROR, "failed to write analysis file\n" );
+        return -1;
+    }
+    return 0;
+}
+
+static ALWAYS_INLINE int analysis_scale_mv( int mv, int num, int den )
+{
+    return (2 * mv * num + (mv < 0 ? -den : den)) / (2 * den);
+}
+
+/* Loads the saved analysis of a frame into its hints, resampled to the
+ * macroblock grid and motion vector scale of this encode.  Only P-frames
+ * with a matching saved frame type receive hints. */
+void x264_analysis_read( x264_t *h, x264_frame_t *frame )
+{
+    frame->b_analysis = 0;
+    if( frame->i_type != X264_TYPE_P || frame->i_frame >= h->analysis.i_offsets ||
+        h->analysis.p_offset[frame->i_frame] < 0 )
+        return;
+
+    FILE *fh = h->analysis.fh_load;
+    int i_src_width = h->analysis.i_mb_width;
+    int i_src_height = h->analysis.i_mb_height;
+    int i_src_count = i_src_width * i_src_height;
+    int32_t i_type;
+    if( fseek( fh, h->analysis.p_offset[frame->i_frame], SEEK_SET ) < 0 ||
+        fread( &i_type, sizeof(i_type), 1, fh ) != 1 || i_type != frame->i_type ||
+        fread( h->analysis.p_buffer, sizeof(x264_analysis_mb_t), i_src_count, fh ) != i_src_count )
+        return;
+
+    int b_scale = h->analysis.i_width != h->param.i_width || h->analysis.i_height != h->param.i_height;
+    for( int y = 0; y < h->mb.i_mb_height; y++ )
+    {
+        int sy = X264_MIN( ((2*y+1) * i_src_height) / (2*h->mb.i_mb_height), i_src_height-1 );
+        for( int x = 0; x < h->mb.i_mb_width; x++ )
+        {
+            int sx = X264_MIN( ((2*x+1) * i_src_width) / (2*h->mb.i_mb_width), i_src_width-1 );
+            x264_analysis_mb_t *dst = &frame->analysis[y*h->mb.i_mb_width + x];
+            *dst = h->analysis.p_buffer[sy*i_src_width + sx];
+            if( b_scale )
+                for( int l = 0; l < 2; l++ )
+                {
+                    dst->mv[l][0] = analysis_scale_mv( dst->mv[l][0], h->param.i_width, h->analysis.i_width );
+                    dst->mv[l][1] = analysis_scale_mv( dst->mv[l][1], h->param.i_height, h->analysis.i_height );
+                }
+        }
+    }
+    frame->b_analysis = 1;
+}
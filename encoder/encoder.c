@@ -81,6 +81,26 @@ static int x264_threadpool_wait_all( x264_t *h )
     return 0;
 }
 
+static void x264_threadpool_print_stats( x264_t *h, x264_threadpool_t *pool, const char *name )
+{
+    x264_threadpool_stats_t stats;
+    x264_threadpool_stats( pool, &stats );
+    x264_log( h, X264_LOG_DEBUG, "%s: %d jobs, %d stolen, idle %.1f%%\n", name, stats.i_jobs, stats.i_steals,
+              stats.i_wall_time > 0 ? 100.0 * stats.i_idle_time / stats.i_wall_time : 0.0 );
+}
+
+static void x264_frame_pool_print_stats( x264_t *h )
+{
+    x264_frame_pool_stats_t *stats = &h->frames.pool->stats;
+    static const char * const names[3] = { "fenc", "fdec", "blank" };
+    for( int i = 0; i < 3; i++ )
+        if( stats->i_allocs[i] )
+            x264_log( h, X264_LOG_DEBUG, "frame pool %s: %d frames, %.1f MiB, %"PRId64" allocs, %"PRId64" reuses, %"PRId64" evictions\n",
+                      names[i], stats->i_frames[i], stats->i_bytes[i] / 1048576.0,
+                      stats->i_allocs[i], stats->i_reuses[i], stats->i_evictions[i] );
+    x264_log( h, X264_LOG_DEBUG, "frame pool peak: %.1f MiB\n", stats->i_peak_bytes / 1048576.0 );
+}
+
 static void x264_frame_dump( x264_t *h )
 {
     FILE *f = x264_fopen( h->param.psz_dump_yuv, "r+b" );
@@ -407,9 +427,15 @@ static int x264_bitstream_check_buffer_filler( x264_t *h, int filler )
 #if HAVE_THREAD
 static void x264_encoder_thread_init( x264_t *h )
 {
+    x264_numa_bind_thread( h->param.i_numa_node );
     if( h->param.i_sync_lookahead )
         x264_lower_thread_priority( 10 );
 }
+
+static void x264_lookahead_pool_init( x264_t *h )
+{
+    x264_numa_bind_thread( h->param.i_numa_node );
+}
 #endif
 
 /****************************************************************************
@@ -569,6 +595,14 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     h->i_thread_frames = h->param.b_sliced_threads ? 1 : h->param.i_threads;
     if( h->i_thread_frames > 1 )
         h->param.nalu_process = NULL;
+    if( h->param.p_nal_ring && (h->i_thread_frames > 1 || h->param.i_nal_ring_size <= 0) )
+    {
+        x264_log( h, X264_LOG_WARNING, "%s, disabling the NAL output ring\n",
+                  h->param.i_nal_ring_size <= 0 ? "invalid NAL ring size" : "frame threads are enabled" );
+        h->param.p_nal_ring = NULL;
+    }
+    if( !h->param.p_nal_ring )
+        h->param.i_nal_ring_size = 0;
 
     if( h->param.b_opencl )
     {
@@ -743,6 +777,12 @@ static int x264_validate_parameters( x264_t *h, int b_open )
             return -1;
         }
 
+        if( h->param.p_nal_ring )
+        {
+            x264_log( h, X264_LOG_ERROR, "NAL output ring is not supported in AVC-Intra mode\n" );
+            return -1;
+        }
+
         if( !h->param.b_repeat_headers )
         {
             x264_log( h, X264_LOG_ERROR, "Separate headers not supported in AVC-Intra mode\n" );
@@ -1040,6 +1080,21 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     }
     if( b_open && h->param.rc.b_stat_read )
         h->param.rc.i_lookahead = 0;
+    if( !h->param.rc.b_stat_read || h->param.rc.i_chunk_start < 0 )
+        h->param.rc.i_chunk_start = -1;
+    if( b_open && (h->param.psz_lookahead_save || h->param.psz_lookahead_load) )
+    {
+        if( h->param.rc.b_stat_read || h->param.b_intra_refresh )
+        {
+            x264_log( h, X264_LOG_WARNING, "lookahead cache is not supported with 2-pass or intra refresh, ignoring\n" );
+            h->param.psz_lookahead_save = h->param.psz_lookahead_load = NULL;
+        }
+        else if( h->param.psz_lookahead_save && h->param.psz_lookahead_load )
+        {
+            x264_log( h, X264_LOG_WARNING, "--lookahead-save is ignored with --lookahead-load\n" );
+            h->param.psz_lookahead_save = NULL;
+        }
+    }
 #if HAVE_THREAD
     if( h->param.i_sync_lookahead < 0 )
         h->param.i_sync_lookahead = h->param.i_bframe + 1;
@@ -1049,6 +1104,13 @@ static int x264_validate_parameters( x264_t *h, int b_open )
 #else
     h->param.i_sync_lookahead = 0;
 #endif
+    h->param.i_frame_pool_budget = X264_MAX( h->param.i_frame_pool_budget, 0 );
+    if( h->param.i_numa_node > x264_numa_max_node() )
+    {
+        x264_log( h, X264_LOG_WARNING, "NUMA node %d is not available, not binding\n", h->param.i_numa_node );
+        h->param.i_numa_node = -1;
+    }
+    h->param.i_numa_node = X264_MAX( h->param.i_numa_node, -1 );
 
     h->param.i_deblocking_filter_alphac0 = x264_clip3( h->param.i_deblocking_filter_alphac0, -6, 6 );
     h->param.i_deblocking_filter_beta    = x264_clip3( h->param.i_deblocking_filter_beta, -6, 6 );
@@ -1061,7 +1123,7 @@ static int x264_validate_parameters( x264_t *h, int b_open )
         h->param.i_cqm_preset = X264_CQM_FLAT;
 
     if( h->param.analyse.i_me_method < X264_ME_DIA ||
-        h->param.analyse.i_me_method > X264_ME_TESA )
+        h->param.analyse.i_me_method > X264_ME_PYR )
         h->param.analyse.i_me_method = X264_ME_HEX;
     h->param.analyse.i_me_range = x264_clip3( h->param.analyse.i_me_range, 4, 1024 );
     if( h->param.analyse.i_me_range > 16 && h->param.analyse.i_me_method <= X264_ME_HEX )
@@ -1197,17 +1259,16 @@ static int x264_validate_parameters( x264_t *h, int b_open )
              {{3,2,1,1}, {2,1,1,1}, {4,3,2,1}, {6,4,3,2}, {12, 9, 6, 4}}};
 
             h->param.i_lookahead_threads = h->param.i_threads / lookahead_thread_div[badapt][subme][bframes];
-            /* Since too many lookahead threads significantly degrades lookahead accuracy, limit auto
-             * lookahead threads to about 8 macroblock rows high each at worst.  This number is chosen
-             * pretty much arbitrarily. */
-            h->param.i_lookahead_threads = X264_MIN( h->param.i_lookahead_threads, h->param.i_height / 128 );
+            /* Lookahead threads share rows dynamically and no longer cost accuracy, but each one
+             * trails the row below it, so keep about 4 macroblock rows per thread to avoid stalls. */
+            h->param.i_lookahead_threads = X264_MIN( h->param.i_lookahead_threads, h->param.i_height / 64 );
         }
     }
     h->param.i_lookahead_threads = x264_clip3( h->param.i_lookahead_threads, 1, X264_MIN( max_sliced_threads, X264_LOOKAHEAD_THREAD_MAX ) );
 
     if( PARAM_INTERLACED )
     {
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
         {
             x264_log( h, X264_LOG_WARNING, "interlace + me=esa is not implemented\n" );
             h->param.analyse.i_me_method = X264_ME_UMH;
@@ -1298,7 +1359,9 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     BOOLIFY( analyse.b_weighted_bipred );
     BOOLIFY( analyse.b_chroma_me );
     BOOLIFY( analyse.b_mixed_references );
+    BOOLIFY( analyse.b_me_multiref );
     BOOLIFY( analyse.b_fast_pskip );
+    BOOLIFY( analyse.b_adaptive_partitions );
     BOOLIFY( analyse.b_dct_decimate );
     BOOLIFY( analyse.b_psy );
     BOOLIFY( analyse.b_psnr );
@@ -1519,7 +1582,15 @@ x264_t *x264_encoder_open( x264_param_t *param )
           || h->param.rc.b_mb_tree
           || h->param.analyse.i_weighted_pred );
     h->frames.b_have_lowres |= h->param.rc.b_stat_read && h->param.rc.i_vbv_buffer_size > 0;
-    h->frames.b_have_sub8x8_esa = !!(h->param.analyse.inter & X264_ANALYSE_PSUB8x8);
+    /* The lowres mvs are motion candidates whenever the encode has a lookahead;
+     * saving it must not add them, and loading it restores them from the cache. */
+    h->frames.b_have_lowres_mvs = h->frames.b_have_lowres;
+    /* A saved lookahead needs the lowres costs; a loaded one replaces them. */
+    h->frames.b_have_lowres |= !!h->param.psz_lookahead_save;
+    h->frames.b_have_lowres &= !h->param.psz_lookahead_load;
+    /* The 4x4 sums are also used by the larger blocks to eliminate more candidates. */
+    h->frames.b_have_sub8x8_esa = !!(h->param.analyse.inter & X264_ANALYSE_PSUB8x8) ||
+                                  ME_EXHAUSTIVE( h->param.analyse.i_me_method );
 
     h->frames.i_last_idr =
     h->frames.i_last_keyframe = - h->param.i_keyint_max;
@@ -1527,6 +1598,8 @@ x264_t *x264_encoder_open( x264_param_t *param )
     h->frames.i_largest_pts = h->frames.i_second_largest_pts = -1;
     h->frames.i_poc_last_open_gop = -1;
 
+    if( x264_frame_pool_init( h ) )
+        goto fail;
     CHECKED_MALLOCZERO( h->frames.unused[0], (h->frames.i_delay + 3) * sizeof(x264_frame_t *) );
     /* Allocate room for max refs plus a few extra just in case. */
     CHECKED_MALLOCZERO( h->frames.unused[1], (h->i_thread_frames + X264_REF_MAX + 4) * sizeof(x264_frame_t *) );
@@ -1626,13 +1699,22 @@ x264_t *x264_encoder_open( x264_param_t *param )
     h->nal_buffer_size = h->out.i_bitstream * 3/2 + 4 + 64; /* +4 for startcode, +64 for nal_escape assembly padding */
     CHECKED_MALLOC( h->nal_buffer, h->nal_buffer_size );
 
+    if( h->param.p_nal_ring )
+    {
+        CHECKED_MALLOCZERO( h->nal_ring, sizeof(x264_nal_ring_t) );
+        if( x264_pthread_mutex_init( &h->nal_ring->mutex, NULL ) )
+            goto fail;
+        h->nal_ring->p_buffer = h->param.p_nal_ring;
+        h->nal_ring->i_size = h->param.i_nal_ring_size;
+    }
+
     CHECKED_MALLOC( h->reconfig_h, sizeof(x264_t) );
 
     if( h->param.i_threads > 1 &&
         x264_threadpool_init( &h->threadpool, h->param.i_threads, (void*)x264_encoder_thread_init, h ) )
         goto fail;
     if( h->param.i_lookahead_threads > 1 &&
-        x264_threadpool_init( &h->lookaheadpool, h->param.i_lookahead_threads, NULL, NULL ) )
+        x264_threadpool_init( &h->lookaheadpool, h->param.i_lookahead_threads, (void*)x264_lookahead_pool_init, h ) )
         goto fail;
 
 #if HAVE_OPENCL
@@ -1647,6 +1729,12 @@ x264_t *x264_encoder_open( x264_param_t *param )
     }
 #endif
 
+    if( (h->param.psz_analysis_save || h->param.psz_analysis_load) && x264_analysis_init( h ) < 0 )
+        goto fail;
+
+    if( (h->param.psz_lookahead_save || h->param.psz_lookahead_load) && x264_lookahead_cache_init( h ) < 0 )
+        goto fail;
+
     h->thread[0] = h;
     for( int i = 1; i < h->param.i_threads + !!h->param.i_sync_lookahead; i++ )
         CHECKED_MALLOC( h->thread[i], sizeof(x264_t) );
@@ -1775,7 +1863,7 @@ static int x264_encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_re
     COPY( analyse.intra );
     COPY( analyse.i_direct_mv_pred );
     /* Scratch buffer prevents me_range from being increased for esa/tesa */
-    if( h->param.analyse.i_me_method < X264_ME_ESA || param->analyse.i_me_range < h->param.analyse.i_me_range )
+    if( !ME_EXHAUSTIVE( h->param.analyse.i_me_method ) || param->analyse.i_me_range < h->param.analyse.i_me_range )
         COPY( analyse.i_me_range );
     COPY( analyse.i_noise_reduction );
     /* We can't switch out of subme=0 during encoding. */
@@ -1785,14 +1873,16 @@ static int x264_encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_re
     COPY( analyse.b_chroma_me );
     COPY( analyse.b_dct_decimate );
     COPY( analyse.b_fast_pskip );
+    COPY( analyse.b_adaptive_partitions );
     COPY( analyse.b_mixed_references );
+    COPY( analyse.b_me_multiref );
     COPY( analyse.f_psy_rd );
     COPY( analyse.f_psy_trellis );
     COPY( crop_rect );
     // can only twiddle these if they were enabled to begin with:
-    if( h->param.analyse.i_me_method >= X264_ME_ESA || param->analyse.i_me_method < X264_ME_ESA )
+    if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) || !ME_EXHAUSTIVE( param->analyse.i_me_method ) )
         COPY( analyse.i_me_method );
-    if( h->param.analyse.i_me_method >= X264_ME_ESA && !h->frames.b_have_sub8x8_esa )
+    if( ME_EXHAUSTIVE( h->param.analyse.i_me_method ) && !h->frames.b_have_sub8x8_esa )
         h->param.analyse.inter &= ~X264_ANALYSE_PSUB8x8;
     if( h->pps->b_transform_8x8_mode )
         COPY( analyse.b_transform_8x8 );
@@ -1902,6 +1992,30 @@ static int x264_nal_check_buffer( x264_t *h )
     return 0;
 }
 
+/* Escape a finished NAL straight into the caller's output ring. */
+static int x264_nal_ring_write( x264_t *h, x264_nal_t *nal )
+{
+    x264_nal_ring_t *ring = h->nal_ring;
+    /* Worst-case NAL unit escaping, +5 for startcode and header, +64 for nal_escape assembly padding */
+    int necessary_size = nal->i_payload * 3/2 + 5 + 64;
+    if( necessary_size > ring->i_size )
+    {
+        x264_log( h, X264_LOG_ERROR, "NAL of %d bytes does not fit in the %d byte output ring\n",
+                  nal->i_payload, ring->i_size );
+        return -1;
+    }
+    /* Same choice as x264_encoder_encapsulate_nals makes once slice threads are merged. */
+    nal->b_long_startcode = (!h->out.i_nal && !h->i_thread_idx) || nal->i_type == NAL_SPS || nal->i_type == NAL_PPS;
+
+    x264_pthread_mutex_lock( &ring->mutex );
+    if( ring->i_pos + necessary_size > ring->i_size )
+        ring->i_pos = 0;
+    x264_nal_encode( h, ring->p_buffer + ring->i_pos, nal );
+    ring->i_pos += nal->i_payload;
+    x264_pthread_mutex_unlock( &ring->mutex );
+    return 0;
+}
+
 static int x264_nal_end( x264_t *h )
 {
     x264_nal_t *nal = &h->out.nal[h->out.i_nal];
@@ -1910,6 +2024,8 @@ static int x264_nal_end( x264_t *h )
     /* Assembly implementation of nal_escape reads past the end of the input.
      * While undefined padding wouldn't actually affect the output, it makes valgrind unhappy. */
     memset( end, 0xff, 64 );
+    if( h->nal_ring && x264_nal_ring_write( h, nal ) )
+        return -1;
     if( h->param.nalu_process )
         h->param.nalu_process( h, nal, h->fenc->opaque );
     h->out.i_nal++;
@@ -1941,17 +2057,59 @@ static int x264_check_encapsulated_buffer( x264_t *h, x264_t *h0, int start,
     return 0;
 }
 
+/* The payloads returned together must be sequential in memory.  NALs escaped into the
+ * ring are, unless the ring wrapped between them or slice threads finished out of
+ * order; those are copied into the linear buffer instead.  Returns the size of the
+ * NALs from start on. */
+static int x264_nal_ring_linearize( x264_t *h, int start )
+{
+    x264_t *h0 = h->thread[0];
+    int previous_nal_size = 0, nal_size = 0;
+    for( int i = 0; i < start; i++ )
+        previous_nal_size += h->out.nal[i].i_payload;
+    for( int i = start; i < h->out.i_nal; i++ )
+        nal_size += h->out.nal[i].i_payload;
+
+    int ret = nal_size;
+
+    /* earlier NALs of this output may already have been moved (filler after a wrap) */
+    if( !start || h->out.nal[0].p_payload != h0->nal_buffer )
+    {
+        int b_sequential = 1;
+        for( int i = 1; i < h->out.i_nal; i++ )
+            b_sequential &= h->out.nal[i].p_payload == h->out.nal[i-1].p_payload + h->out.nal[i-1].i_payload;
+        if( b_sequential )
+            return nal_size;
+        nal_size += previous_nal_size;
+        previous_nal_size = start = 0;
+    }
+
+    if( x264_check_encapsulated_buffer( h, h0, start, previous_nal_size, previous_nal_size + nal_size ) )
+        return -1;
+    uint8_t *nal_buffer = h0->nal_buffer + previous_nal_size;
+    for( int i = start; i < h->out.i_nal; i++ )
+    {
+        memcpy( nal_buffer, h->out.nal[i].p_payload, h->out.nal[i].i_payload );
+        h->out.nal[i].p_payload = nal_buffer;
+        nal_buffer += h->out.nal[i].i_payload;
+    }
+    return ret;
+}
+
 static int x264_encoder_encapsulate_nals( x264_t *h, int start )
 {
     x264_t *h0 = h->thread[0];
     int nal_size = 0, previous_nal_size = 0;
 
-    if( h->param.nalu_process )
+    /* NALs have already been handed out or escaped into the output ring. */
+    if( h->param.nalu_process && !h->nal_ring )
     {
         for( int i = start; i < h->out.i_nal; i++ )
             nal_size += h->out.nal[i].i_payload;
         return nal_size;
     }
+    if( h->nal_ring )
+        return x264_nal_ring_linearize( h, start );
 
     for( int i = 0; i < start; i++ )
         previous_nal_size += h->out.nal[i].i_payload;
@@ -1993,6 +2151,16 @@ static int x264_encoder_encapsulate_nals( x264_t *h, int start )
     return nal_buffer - (h0->nal_buffer + previous_nal_size);
 }
 
+/****************************************************************************
+ * x264_encoder_frame_pool_stats:
+ ****************************************************************************/
+void x264_encoder_frame_pool_stats( x264_t *h, x264_frame_pool_stats_t *stats )
+{
+    x264_pthread_mutex_lock( &h->frames.pool->mutex );
+    *stats = h->frames.pool->stats;
+    x264_pthread_mutex_unlock( &h->frames.pool->mutex );
+}
+
 /****************************************************************************
  * x264_encoder_headers:
  ****************************************************************************/
@@ -2313,7 +2481,7 @@ static inline void x264_reference_build_list( x264_t *h, int i_poc )
     h->mb.pic.i_fref[1] = h->i_ref[1];
 }
 
-static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
+static void x264_fdec_filter_row_internal( x264_t *h, int mb_y, int pass )
 {
     /* mb_y is the mb to be encoded next, not the mb to be filtered here */
     int b_hpel = h->fdec->b_kept_as_ref;
@@ -2433,6 +2601,13 @@ static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
     }
 }
 
+static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
+{
+    int64_t start = x264_stage_time( h );
+    x264_fdec_filter_row_internal( h, mb_y, pass );
+    h->stat.frame_time.i_filter += x264_stage_time( h ) - start;
+}
+
 static inline int x264_reference_update( x264_t *h )
 {
     if( !h->fdec->b_kept_as_ref )
@@ -2761,11 +2936,19 @@ static intptr_t x264_slice_write( x264_t *h )
         else
             x264_macroblock_cache_load_progressive( h, i_mb_x, i_mb_y );
 
+        int64_t stage_start = x264_stage_time( h );
+        int64_t wait_start = h->stat.frame_time.i_wait;
         x264_macroblock_analyse( h );
+        int64_t stage_end = x264_stage_time( h );
+        h->stat.frame_time.i_analyse += stage_end - stage_start - (h->stat.frame_time.i_wait - wait_start);
 
         /* encode this macroblock -> be careful it can change the mb type to P_SKIP if needed */
 reencode:
+        stage_start = x264_stage_time( h );
         x264_macroblock_encode( h );
+        stage_end = x264_stage_time( h );
+        h->stat.frame_time.i_encode += stage_end - stage_start;
+        stage_start = stage_end;
 
         if( h->param.b_cabac )
         {
@@ -2805,6 +2988,7 @@ reencode:
                 }
             }
         }
+        h->stat.frame_time.i_entropy += x264_stage_time( h ) - stage_start;
 
         int total_bits = bs_pos(&h->out.bs) + x264_cabac_pos(&h->cabac);
         int mb_size = total_bits - mb_spos;
@@ -2873,6 +3057,8 @@ cont:
 
         /* save cache */
         x264_macroblock_cache_save( h );
+        if( h->fdec->analysis )
+            x264_analysis_save_mb( h );
 
         if( x264_ratecontrol_mb( h, mb_size ) < 0 )
         {
@@ -3015,7 +3201,9 @@ cont:
             /* Do the first row of hpel, now that the previous slice is done */
             if( h->i_thread_idx > 0 )
             {
+                int64_t wait_start = x264_stage_time( h );
                 x264_threadslice_cond_wait( h->thread[h->i_thread_idx-1], 2 );
+                h->stat.frame_time.i_wait += x264_stage_time( h ) - wait_start;
                 x264_fdec_filter_row( h, h->i_threadslice_start + (1 << SLICE_MBAFF), 2 );
             }
         }
@@ -3066,6 +3254,7 @@ static void *x264_slices_write( x264_t *h )
 
     /* init stats */
     memset( &h->stat.frame, 0, sizeof(h->stat.frame) );
+    memset( &h->stat.frame_time, 0, sizeof(h->stat.frame_time) );
     h->mb.b_reencode_mb = 0;
     while( h->sh.i_first_mb + SLICE_MBAFF*h->mb.i_mb_stride <= last_thread_mb )
     {
@@ -3172,6 +3361,8 @@ static int x264_threaded_slices_write( x264_t *h )
             h->stat.frame.i_ssd[j] += t->stat.frame.i_ssd[j];
         h->stat.frame.f_ssim += t->stat.frame.f_ssim;
         h->stat.frame.i_ssim_cnt += t->stat.frame.i_ssim_cnt;
+        for( int j = 0; j < sizeof(h->stat.frame_time) / sizeof(int64_t); j++ )
+            ((int64_t*)&h->stat.frame_time)[j] += ((int64_t*)&t->stat.frame_time)[j];
     }
 
     return 0;
@@ -3207,6 +3398,31 @@ int x264_encoder_invalidate_reference( x264_t *h, int64_t pts )
     return 0;
 }
 
+int x264_encoder_input_picture_get( x264_t *h, x264_picture_t *pic )
+{
+    x264_frame_t *frame = x264_frame_pop_unused( h, 0 );
+    if( !frame )
+        return -1;
+
+    x264_picture_init( pic );
+    pic->img.i_csp = frame->i_csp | (BIT_DEPTH > 8 ? X264_CSP_HIGH_DEPTH : 0);
+    pic->img.i_plane = frame->i_plane;
+    for( int i = 0; i < frame->i_plane; i++ )
+    {
+        pic->img.plane[i] = (uint8_t*)frame->plane[i];
+        pic->img.i_stride[i] = frame->i_stride[i] * sizeof(pixel);
+    }
+    pic->input_frame = frame;
+    return 0;
+}
+
+void x264_encoder_input_picture_release( x264_t *h, x264_picture_t *pic )
+{
+    if( pic->input_frame )
+        x264_frame_push_unused( h, pic->input_frame );
+    pic->input_frame = NULL;
+}
+
 /****************************************************************************
  * x264_encoder_encode:
  *  XXX: i_poc   : is the poc of the current given picture
@@ -3264,14 +3480,17 @@ int     x264_encoder_encode( x264_t *h,
             return -1;
         }
 
-        /* 1: Copy the picture to a frame and move it to a buffer */
-        x264_frame_t *fenc = x264_frame_pop_unused( h, 0 );
+        /* 1: Copy the picture to a frame and move it to a buffer.  Pictures from
+         * x264_encoder_input_picture_get already live in their frame. */
+        x264_frame_t *fenc = pic_in->input_frame ? pic_in->input_frame : x264_frame_pop_unused( h, 0 );
         uint64_t sum_luma = 0;
-        pixel *luma = fenc->plane[0];
-        int stride = fenc->i_stride[0];
 
         if( !fenc )
             return -1;
+        pic_in->input_frame = NULL;
+
+        pixel *luma = fenc->plane[0];
+        int stride = fenc->i_stride[0];
 
         if( x264_frame_copy_picture( h, fenc, pic_in ) < 0 )
             return -1;
@@ -3368,6 +3587,10 @@ int     x264_encoder_encode( x264_t *h,
     /* ------------------- Get frame to be encoded ------------------------- */
     /* 4: get picture to encode */
     h->fenc = x264_frame_shift( h->frames.current );
+    if( h->param.psz_analysis_load )
+        x264_analysis_read( h, h->fenc );
+    if( h->param.psz_lookahead_load && x264_lookahead_cache_read( h, h->fenc ) < 0 )
+        return -1;
 
     /* If applicable, wait for previous frame reconstruction to finish */
     if( h->param.b_sliced_threads )
@@ -3736,6 +3959,8 @@ int     x264_encoder_encode( x264_t *h,
     /* FIXME: Include slice header bit cost. */
     x264_ratecontrol_start( h, h->fenc->i_qpplus1, overhead*8 );
     i_global_qp = x264_ratecontrol_qp( h );
+    if( h->lookahead_cache.fh_save && x264_lookahead_cache_write( h ) < 0 )
+        return -1;
 
     pic_out->i_qpplus1 =
     h->fdec->i_qpplus1 = i_global_qp + 1;
@@ -3806,6 +4031,18 @@ csv_write:
         pic_out->frameData.f_avg_luma_level = thread_oldest->fenc->f_avg_luma_level;
         pic_out->frameData.i_max_luma_level = thread_oldest->fenc->i_max_luma_level;
         pic_out->frameData.i_min_luma_level = thread_oldest->fenc->i_min_luma_level;
+        pic_out->frameData.i_stall_count = thread_oldest->stat.frame.i_stall_count;
+        pic_out->frameData.i_stall_mvy_range = thread_oldest->stat.frame.i_stall_mvy_range;
+        pic_out->frameData.f_stall_time = thread_oldest->stat.frame.i_stall_time / 1000.0;
+        if( thread_oldest->param.i_csv_log_level >= 2 )
+        {
+            pic_out->frameData.f_lookahead_time = thread_oldest->fenc->i_lookahead_time / 1000.0;
+            pic_out->frameData.f_analyse_time = thread_oldest->stat.frame_time.i_analyse / 1000.0;
+            pic_out->frameData.f_encode_time = thread_oldest->stat.frame_time.i_encode / 1000.0;
+            pic_out->frameData.f_entropy_time = thread_oldest->stat.frame_time.i_entropy / 1000.0;
+            pic_out->frameData.f_filter_time = thread_oldest->stat.frame_time.i_filter / 1000.0;
+            pic_out->frameData.f_wait_time = thread_oldest->stat.frame_time.i_wait / 1000.0;
+        }
         thread_oldest->mb.i_mb_luma_distortion = thread_oldest->mb.i_mb_chroma_distortion = thread_oldest->mb.i_mb_psy_energy = thread_oldest->mb.i_mb_res_energy = 0;
 
         x264_csvlog_frame( thread_oldest->csvfh, &thread_oldest->param, pic_out, thread_oldest->param.i_csv_log_level );
@@ -3834,6 +4071,9 @@ static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
 
     x264_emms();
 
+    if( h->analysis.fh_save && x264_analysis_write( h, h->fdec ) < 0 )
+        return -1;
+
     /* generate buffering period sei and insert it into place */
     if( h->i_thread_frames > 1 && h->fenc->b_keyframe && h->sps->vui.b_nal_hrd_parameters_present )
     {
@@ -3970,6 +4210,18 @@ static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
                 h->stat.i_mb_count_ref[h->sh.i_type][i_list][i] += h->stat.frame.i_mb_count_ref[i_list][i];
     for( int i = 0; i < 3; i++ )
         h->stat.i_mb_field[i] += h->stat.frame.i_mb_field[i];
+    h->stat.i_part_search += h->stat.frame.i_part_search;
+    h->stat.i_part_skip += h->stat.frame.i_part_skip;
+    h->stat.i_part_probe += h->stat.frame.i_part_probe;
+    h->stat.i_part_probe_split += h->stat.frame.i_part_probe_split;
+    if( h->stat.frame.i_stall_count )
+    {
+        if( !h->stat.i_stall_frames || h->stat.frame.i_stall_mvy_range < h->stat.i_stall_mvy_range )
+            h->stat.i_stall_mvy_range = h->stat.frame.i_stall_mvy_range;
+        h->stat.i_stall_frames++;
+        h->stat.i_stall_count += h->stat.frame.i_stall_count;
+        h->stat.i_stall_time += h->stat.frame.i_stall_time;
+    }
     if( h->sh.i_type == SLICE_TYPE_P && h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE )
     {
         h->stat.i_wpred[0] += !!h->sh.weight[0][0].weightfn;
@@ -4113,9 +4365,15 @@ void    x264_encoder_close  ( x264_t *h )
     if( h->param.b_sliced_threads )
         x264_threadpool_wait_all( h );
     if( h->param.i_threads > 1 )
+    {
+        x264_threadpool_print_stats( h, h->threadpool, "threadpool" );
         x264_threadpool_delete( h->threadpool );
+    }
     if( h->param.i_lookahead_threads > 1 )
+    {
+        x264_threadpool_print_stats( h, h->lookaheadpool, "lookahead threadpool" );
         x264_threadpool_delete( h->lookaheadpool );
+    }
     if( h->i_thread_frames > 1 )
     {
         for( int i = 0; i < h->i_thread_frames; i++ )
@@ -4356,6 +4614,17 @@ void    x264_encoder_close  ( x264_t *h )
                       h->stat.i_wpred[0] * 100.0 / h->stat.i_frame_count[SLICE_TYPE_P],
                       h->stat.i_wpred[1] * 100.0 / h->stat.i_frame_count[SLICE_TYPE_P] );
 
+        if( h->stat.i_part_search + h->stat.i_part_skip )
+            x264_log( h, X264_LOG_INFO, "adaptive partitions: sub-16x16 search skipped in %.1f%% of searchable P MBs, %.1f%% of %"PRId64" probes split\n",
+                      h->stat.i_part_skip * 100.0 / (h->stat.i_part_search + h->stat.i_part_skip),
+                      h->stat.i_part_probe ? h->stat.i_part_probe_split * 100.0 / h->stat.i_part_probe : 0.0,
+                      h->stat.i_part_probe );
+
+        if( h->stat.i_stall_frames )
+            x264_log( h, X264_LOG_INFO, "frame-thread stalls: %"PRId64" in %d frames, %.1f ms, smallest mv range %d\n",
+                      h->stat.i_stall_count, h->stat.i_stall_frames, h->stat.i_stall_time / 1000.0,
+                      h->stat.i_stall_mvy_range );
+
         for( int i_list = 0; i_list < 2; i_list++ )
             for( int i_slice = 0; i_slice < 2; i_slice++ )
             {
@@ -4407,9 +4676,16 @@ void    x264_encoder_close  ( x264_t *h )
         free( (char*)h->param.csv_filename );
     if( h->csvfh )
         fclose( h->csvfh );
+    x264_analysis_delete( h );
+    x264_lookahead_cache_delete( h );
 
     x264_cqm_delete( h );
     x264_free( h->nal_buffer );
+    if( h->nal_ring )
+    {
+        x264_pthread_mutex_destroy( &h->nal_ring->mutex );
+        x264_free( h->nal_ring );
+    }
     x264_free( h->reconfig_h );
     x264_analyse_free_costs( h );
 
@@ -4417,10 +4693,12 @@ void    x264_encoder_close  ( x264_t *h )
         h = h->thread[h->i_thread_phase];
 
     /* frames */
+    x264_frame_pool_print_stats( h );
     x264_frame_delete_list( h->frames.unused[0] );
     x264_frame_delete_list( h->frames.unused[1] );
     x264_frame_delete_list( h->frames.current );
     x264_frame_delete_list( h->frames.blank_unused );
+    x264_frame_pool_delete( h );
 
     h = h->thread[0];
 
@@ -4511,6 +4789,10 @@ static void fetch_stats( x264_t *h, x264_stats_t *stats, size_t statsSizeBytes )
         stats->f_bitrate = f_bitrate;
         stats->f_encode_time = h->stat.f_encode_time;
         stats->f_fps = ( double )( SUM3( h->stat.i_frame_count ) ) / h->stat.f_encode_time;
+        stats->i_stall_count = h->stat.i_stall_count;
+        stats->i_stall_frames = h->stat.i_stall_frames;
+        stats->f_stall_time = h->stat.i_stall_time / 1000.0;
+        stats->i_stall_mvy_range = h->stat.i_stall_mvy_range;
     }
 }
 
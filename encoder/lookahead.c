@@ -38,6 +38,10 @@
  */
 #include "common/common.h"
 #include "analyse.h"
+#include "ratecontrol.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 static void x264_lookahead_shift( x264_sync_frame_list_t *dst, x264_sync_frame_list_t *src, int count )
 {
@@ -67,10 +71,12 @@ static void x264_lookahead_update_last_nonb( x264_t *h, x264_frame_t *new_nonb )
 #if HAVE_THREAD
 static void x264_lookahead_slicetype_decide( x264_t *h )
 {
+    int64_t start = x264_stage_time( h );
     x264_stack_align( x264_slicetype_decide, h );
 
     x264_lookahead_update_last_nonb( h, h->lookahead->next.list[0] );
     int shift_frames = h->lookahead->next.list[0]->i_bframes + 1;
+    int64_t decide_time = x264_stage_time( h ) - start;
 
     x264_pthread_mutex_lock( &h->lookahead->ofbuf.mutex );
     while( h->lookahead->ofbuf.i_size == h->lookahead->ofbuf.i_max_size )
@@ -81,14 +87,17 @@ static void x264_lookahead_slicetype_decide( x264_t *h )
     x264_pthread_mutex_unlock( &h->lookahead->next.mutex );
 
     /* For MB-tree and VBV lookahead, we have to perform propagation analysis on I-frames too. */
+    start = x264_stage_time( h );
     if( h->lookahead->b_analyse_keyframe && IS_X264_TYPE_I( h->lookahead->last_nonb->i_type ) )
         x264_stack_align( x264_slicetype_analyse, h, shift_frames );
+    h->lookahead->last_nonb->i_lookahead_time += decide_time + x264_stage_time( h ) - start;
 
     x264_pthread_mutex_unlock( &h->lookahead->ofbuf.mutex );
 }
 
 static void *x264_lookahead_thread( x264_t *h )
 {
+    x264_numa_bind_thread( h->param.i_numa_node );
     while( !h->lookahead->b_exit_thread )
     {
         x264_pthread_mutex_lock( &h->lookahead->ifbuf.mutex );
@@ -132,7 +141,7 @@ int x264_lookahead_init( x264_t *h, int i_slicetype_length )
 
     look->i_last_keyframe = - h->param.i_keyint_max;
     look->b_analyse_keyframe = (h->param.rc.b_mb_tree || (h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead))
-                               && !h->param.rc.b_stat_read;
+                               && !h->param.rc.b_stat_read && !h->param.psz_lookahead_load;
     look->i_slicetype_length = i_slicetype_length;
 
     /* init frame lists */
@@ -141,6 +150,19 @@ int x264_lookahead_init( x264_t *h, int i_slicetype_length )
         x264_sync_frame_list_init( &look->ofbuf, h->frames.i_delay+3 ) )
         goto fail;
 
+    /* Scratch for threaded mbtree propagation: one row of propagate amounts, the
+     * propagate_list asm buffer, and a private accumulator per reference list. */
+    if( h->param.rc.b_mb_tree && h->param.i_lookahead_threads > 1 )
+        for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        {
+            x264_t *t = h->lookahead_thread[i];
+            int buf_mbtree = ((h->mb.i_mb_width+7)&~7) * sizeof(int16_t);
+            CHECKED_MALLOC( t->scratch_buffer, buf_mbtree + 2 * h->mb.i_mb_count * sizeof(uint16_t) );
+            CHECKED_MALLOC( t->scratch_buffer2, buf_mbtree * 12 );
+            /* lookahead thread contexts were copied before the mb cache strides were set */
+            t->mb.i_mb_stride = h->mb.i_mb_stride;
+        }
+
     if( !h->param.i_sync_lookahead )
         return 0;
 
@@ -175,6 +197,12 @@ void x264_lookahead_delete( x264_t *h )
         x264_macroblock_thread_free( h->thread[h->param.i_threads], 1 );
         x264_free( h->thread[h->param.i_threads] );
     }
+    if( h->param.rc.b_mb_tree && h->param.i_lookahead_threads > 1 )
+        for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        {
+            x264_free( h->lookahead_thread[i]->scratch_buffer );
+            x264_free( h->lookahead_thread[i]->scratch_buffer2 );
+        }
     x264_sync_frame_list_delete( &h->lookahead->ifbuf );
     x264_sync_frame_list_delete( &h->lookahead->next );
     if( h->lookahead->last_nonb )
@@ -230,6 +258,7 @@ void x264_lookahead_get_frames( x264_t *h )
         if( h->frames.current[0] || !h->lookahead->next.i_size )
             return;
 
+        int64_t start = x264_stage_time( h );
         x264_stack_align( x264_slicetype_decide, h );
         x264_lookahead_update_last_nonb( h, h->lookahead->next.list[0] );
         int shift_frames = h->lookahead->next.list[0]->i_bframes + 1;
@@ -238,7 +267,360 @@ void x264_lookahead_get_frames( x264_t *h )
         /* For MB-tree and VBV lookahead, we have to perform propagation analysis on I-frames too. */
         if( h->lookahead->b_analyse_keyframe && IS_X264_TYPE_I( h->lookahead->last_nonb->i_type ) )
             x264_stack_align( x264_slicetype_analyse, h, shift_frames );
+        h->lookahead->last_nonb->i_lookahead_time += x264_stage_time( h ) - start;
 
         x264_lookahead_encoder_shift( h );
     }
 }
+
+/* LOOKAHEAD CACHE (--lookahead-save/--lookahead-load)
+ *
+ * Everything the encode takes from the lookahead is saved per frame, so that
+ * encodes of the same source at other bitrates can skip it entirely: no lowres
+ * planes are built and neither slicetype analysis nor mb-tree is run.
+ *
+ * File layout, in native byte order:
+ *   header: 16 int32: magic, version, width, height, mb_width, mb_height,
+ *           settings key, flags, record size, then zero
+ *   then for each frame, in coded order, a fixed-size record:
+ *     lookahead_record_t, int32 row satds[mb_height], int32 intra row satds[mb_height],
+ *     float qp offsets[mb_count] (zero without AQ),
+ *     int16 lowres mvs[2][mb_count][2] (those of the first reference of each list),
+ *     padded to a multiple of 8 bytes
+ * Records are aligned and of fixed size, so the file is mapped and read in place. */
+
+#define LOOKAHEAD_CACHE_MAGIC   0x6c343678 /* "x64l" */
+#define LOOKAHEAD_CACHE_VERSION 2
+#define LOOKAHEAD_CACHE_PLANNED 1          /* flag: records hold VBV plans */
+
+typedef struct
+{
+    int32_t  i_frame;       /* display order */
+    int32_t  i_type;
+    uint64_t i_hash;        /* of the source luma */
+    int32_t  i_satd;        /* fdec->i_satd as set by x264_rc_analyse_slice */
+    int32_t  i_lowres_dist[2]; /* per list: index+1 of the saved lowres mvs, 0 = none */
+    int32_t  weight[3][4];  /* per plane: weighted, scale, denom, offset */
+    int32_t  i_planned_satd[X264_LOOKAHEAD_MAX+1];
+    double   f_planned_cpb_duration[X264_LOOKAHEAD_MAX+1];
+    uint8_t  i_planned_type[X264_LOOKAHEAD_MAX+1];
+} lookahead_record_t;
+
+/* Everything that changes the decisions or costs of the lookahead. */
+static uint32_t lookahead_cache_key( x264_t *h )
+{
+    int32_t settings[] =
+    {
+        BIT_DEPTH, h->param.i_csp & X264_CSP_MASK, PARAM_INTERLACED, h->param.b_fake_interlaced,
+        h->param.i_fps_num, h->param.i_fps_den, h->param.i_timebase_num, h->param.i_timebase_den,
+        h->param.b_vfr_input, h->param.i_keyint_max, h->param.i_keyint_min, h->param.i_scenecut_threshold,
+        h->param.b_open_gop, h->param.b_bluray_compat, h->param.i_frame_reference,
+        h->param.i_bframe, h->param.i_bframe_adaptive, h->param.i_bframe_bias, h->param.i_bframe_pyramid,
+        h->param.rc.i_lookahead, h->param.rc.b_mb_tree, h->param.rc.i_aq_mode,
+        h->param.rc.f_aq_strength * 1000, h->param.rc.f_qcompress * 1000, h->param.analyse.i_weighted_pred,
+    };
+    uint32_t key = 2166136261U;
+    for( int i = 0; i < sizeof(settings); i++ )
+        key = (key ^ ((uint8_t*)settings)[i]) * 16777619U;
+    return key;
+}
+
+static uint64_t lookahead_cache_hash( x264_frame_t *frame )
+{
+    uint64_t hash = 14695981039346656037ULL;
+    int width = frame->i_width[0] * sizeof(pixel);
+    for( int y = 0; y < frame->i_lines[0]; y++ )
+    {
+        uint8_t *src = (uint8_t*)(frame->plane[0] + y * frame->i_stride[0]);
+        int x = 0;
+        for( ; x <= width - 8; x += 8 )
+        {
+            hash = (hash ^ M64( src+x )) * 1099511628211ULL;
+            hash ^= hash >> 32;
+        }
+        for( ; x < width; x++ )
+            hash = (hash ^ src[x]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int lookahead_cache_read_at( x264_t *h, int64_t pos, int size, void *dst )
+{
+    if( h->lookahead_cache.p_map )
+    {
+        memcpy( dst, h->lookahead_cache.p_map + pos, size );
+        return 0;
+    }
+    FILE *fh = h->lookahead_cache.fh_load;
+    return fseek( fh, pos, SEEK_SET ) < 0 || fread( dst, size, 1, fh ) != 1 ? -1 : 0;
+}
+
+/* Copies size bytes at offset in the record of frame i_frame to dst. */
+static int lookahead_cache_get( x264_t *h, int i_frame, int offset, int size, void *dst )
+{
+    return lookahead_cache_read_at( h, h->lookahead_cache.p_offset[i_frame] + offset, size, dst );
+}
+
+static int lookahead_cache_init_load( x264_t *h )
+{
+    FILE *fh = h->lookahead_cache.fh_load = x264_fopen( h->param.psz_lookahead_load, "rb" );
+    if( !fh )
+    {
+        x264_log( h, X264_LOG_ERROR, "can't open lookahead cache `%s'\n", h->param.psz_lookahead_load );
+        return -1;
+    }
+
+    int32_t header[16];
+    if( fread( header, sizeof(header), 1, fh ) != 1 || header[0] != LOOKAHEAD_CACHE_MAGIC )
+    {
+        x264_log( h, X264_LOG_ERROR, "`%s' is not a lookahead cache\n", h->param.psz_lookahead_load );
+        return -1;
+    }
+    if( header[1] != LOOKAHEAD_CACHE_VERSION )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead cache version %d is not supported\n", header[1] );
+        return -1;
+    }
+    if( header[2] != h->param.i_width || header[3] != h->param.i_height ||
+        header[4] != h->mb.i_mb_width || header[5] != h->mb.i_mb_height ||
+        header[8] != h->lookahead_cache.i_record_size )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead cache is for %dx%d, not %dx%d\n",
+                  header[2], header[3], h->param.i_width, h->param.i_height );
+        return -1;
+    }
+    if( (uint32_t)header[6] != lookahead_cache_key( h ) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead cache was saved with different lookahead settings\n" );
+        return -1;
+    }
+    h->lookahead_cache.b_planned = header[7] & LOOKAHEAD_CACHE_PLANNED;
+    if( h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead && !h->lookahead_cache.b_planned )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead cache has no VBV plans, save it with VBV enabled\n" );
+        return -1;
+    }
+
+    int64_t file_size;
+    if( fseek( fh, 0, SEEK_END ) < 0 || (file_size = ftell( fh )) < 0 )
+        return -1;
+    h->lookahead_cache.i_frames = (file_size - sizeof(header)) / h->lookahead_cache.i_record_size;
+
+#ifndef _WIN32
+    if( (uint64_t)file_size <= SIZE_MAX )
+    {
+        void *map = mmap( NULL, file_size, PROT_READ, MAP_PRIVATE, fileno( fh ), 0 );
+        if( map != MAP_FAILED )
+        {
+            h->lookahead_cache.p_map = map;
+            h->lookahead_cache.i_map_size = file_size;
+        }
+    }
+#endif
+
+    /* Index the frames by display order, keeping their types at hand for slicetype decision. */
+    int i_frames = h->lookahead_cache.i_frames;
+    CHECKED_MALLOC( h->lookahead_cache.p_offset, X264_MAX( i_frames, 1 ) * sizeof(int64_t) );
+    CHECKED_MALLOC( h->lookahead_cache.p_type, X264_MAX( i_frames, 1 ) );
+    for( int i = 0; i < i_frames; i++ )
+        h->lookahead_cache.p_offset[i] = -1;
+    for( int i = 0; i < i_frames; i++ )
+    {
+        int64_t offset = sizeof(header) + (int64_t)i * h->lookahead_cache.i_record_size;
+        int32_t frame_type[2];
+        if( lookahead_cache_read_at( h, offset, sizeof(frame_type), frame_type ) < 0 )
+            return -1;
+        if( frame_type[0] >= 0 && frame_type[0] < i_frames )
+        {
+            h->lookahead_cache.p_offset[frame_type[0]] = offset;
+            h->lookahead_cache.p_type[frame_type[0]] = frame_type[1];
+        }
+    }
+
+    x264_log( h, X264_LOG_DEBUG, "loaded lookahead of %d frames%s\n", i_frames,
+              h->lookahead_cache.p_map ? " (mapped)" : "" );
+    return 0;
+fail:
+    return -1;
+}
+
+int x264_lookahead_cache_init( x264_t *h )
+{
+    int i_rows = 2 * h->mb.i_mb_height * sizeof(int32_t);
+    int i_mbs = h->mb.i_mb_count * (sizeof(float) + 4 * sizeof(int16_t));
+    h->lookahead_cache.i_record_size = (sizeof(lookahead_record_t) + i_rows + i_mbs + 7) & ~7;
+
+    if( h->param.psz_lookahead_load )
+        return lookahead_cache_init_load( h );
+
+    h->lookahead_cache.fh_save = x264_fopen( h->param.psz_lookahead_save, "wb" );
+    if( !h->lookahead_cache.fh_save )
+    {
+        x264_log( h, X264_LOG_ERROR, "can't open lookahead cache `%s' for writing\n", h->param.psz_lookahead_save );
+        return -1;
+    }
+    h->lookahead_cache.b_planned = h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead;
+    int32_t header[16] = { LOOKAHEAD_CACHE_MAGIC, LOOKAHEAD_CACHE_VERSION, h->param.i_width, h->param.i_height,
+                           h->mb.i_mb_width, h->mb.i_mb_height, lookahead_cache_key( h ),
+                           h->lookahead_cache.b_planned ? LOOKAHEAD_CACHE_PLANNED : 0, h->lookahead_cache.i_record_size };
+    if( fwrite( header, sizeof(header), 1, h->lookahead_cache.fh_save ) != 1 )
+    {
+        x264_log( h, X264_LOG_ERROR, "failed to write lookahead cache\n" );
+        return -1;
+    }
+    CHECKED_MALLOCZERO( h->lookahead_cache.p_record, h->lookahead_cache.i_record_size );
+    return 0;
+fail:
+    return -1;
+}
+
+void x264_lookahead_cache_delete( x264_t *h )
+{
+    if( h->lookahead_cache.fh_save )
+        fclose( h->lookahead_cache.fh_save );
+    if( h->lookahead_cache.fh_load )
+        fclose( h->lookahead_cache.fh_load );
+#ifndef _WIN32
+    if( h->lookahead_cache.p_map )
+        munmap( h->lookahead_cache.p_map, h->lookahead_cache.i_map_size );
+#endif
+    x264_free( h->lookahead_cache.p_offset );
+    x264_free( h->lookahead_cache.p_type );
+    x264_free( h->lookahead_cache.p_record );
+}
+
+int x264_lookahead_cache_slice_type( x264_t *h, int i_frame )
+{
+    if( i_frame >= h->lookahead_cache.i_frames || h->lookahead_cache.p_offset[i_frame] < 0 )
+        return X264_TYPE_AUTO;
+    return h->lookahead_cache.p_type[i_frame];
+}
+
+/* Saves what the lookahead decided for the frame about to be encoded.
+ * Must be called after x264_ratecontrol_start. */
+int x264_lookahead_cache_write( x264_t *h )
+{
+    x264_frame_t *fenc = h->fenc;
+    lookahead_record_t *rec = (lookahead_record_t*)h->lookahead_cache.p_record;
+    int32_t *row_satd = (int32_t*)(rec + 1);
+    int32_t *intra_row_satd = row_satd + h->mb.i_mb_height;
+    float *qp_offset = (float*)(intra_row_satd + h->mb.i_mb_height);
+    int16_t (*lowres_mvs)[2] = (int16_t(*)[2])(qp_offset + h->mb.i_mb_count);
+
+    rec->i_frame = fenc->i_frame;
+    rec->i_type = fenc->i_type;
+    rec->i_hash = lookahead_cache_hash( fenc );
+    x264_rc_analyse_slice( h );
+    rec->i_satd = h->fdec->i_satd;
+    memcpy( row_satd, h->fdec->i_row_satd, h->mb.i_mb_height * sizeof(int32_t) );
+    memcpy( intra_row_satd, h->fdec->i_row_satds[0][0], h->mb.i_mb_height * sizeof(int32_t) );
+    /* The qp offsets only exist with AQ, which mb-tree turns on. */
+    if( h->param.rc.i_aq_mode )
+        memcpy( qp_offset, fenc->f_qp_offset, h->mb.i_mb_count * sizeof(float) );
+    /* The lowres mvs x264_mb_predict_mv_ref16x16 takes as candidates */
+    for( int l = 0; l < 2; l++ )
+    {
+        rec->i_lowres_dist[l] = 0;
+        if( !h->i_ref[l] )
+            continue;
+        int idx = l ? h->fref[1][0]->i_frame - fenc->i_frame - 1
+                    : fenc->i_frame - h->fref[0][0]->i_frame - 1;
+        if( idx >= 0 && idx <= h->param.i_bframe && fenc->lowres_mvs[l][idx][0][0] != 0x7FFF )
+        {
+            rec->i_lowres_dist[l] = idx + 1;
+            memcpy( lowres_mvs + l * h->mb.i_mb_count, fenc->lowres_mvs[l][idx], h->mb.i_mb_count * sizeof(int16_t[2]) );
+        }
+    }
+    for( int i = 0; i < 3; i++ )
+    {
+        x264_weight_t *w = &fenc->weight[0][i];
+        rec->weight[i][0] = !!w->weightfn;
+        rec->weight[i][1] = w->i_scale;
+        rec->weight[i][2] = w->i_denom;
+        rec->weight[i][3] = w->i_offset;
+    }
+    if( h->lookahead_cache.b_planned )
+    {
+        memcpy( rec->i_planned_type, fenc->i_planned_type, sizeof(rec->i_planned_type) );
+        memcpy( rec->f_planned_cpb_duration, fenc->f_planned_cpb_duration, sizeof(rec->f_planned_cpb_duration) );
+        for( int i = 0; i <= X264_LOOKAHEAD_MAX; i++ )
+            rec->i_planned_satd[i] = fenc->i_planned_satd[i];
+    }
+
+    if( fwrite( rec, h->lookahead_cache.i_record_size, 1, h->lookahead_cache.fh_save ) != 1 )
+    {
+        x264_log( h, X264_LOG_ERROR, "failed to write lookahead cache\n" );
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks the frame about to be encoded against its saved record and restores what
+ * the lookahead would have decided for it, apart from the costs. */
+int x264_lookahead_cache_read( x264_t *h, x264_frame_t *frame )
+{
+    lookahead_record_t rec;
+    if( frame->i_frame >= h->lookahead_cache.i_frames || h->lookahead_cache.p_offset[frame->i_frame] < 0 ||
+        lookahead_cache_get( h, frame->i_frame, 0, sizeof(rec), &rec ) < 0 )
+    {
+        x264_log( h, X264_LOG_ERROR, "frame %d is missing from the lookahead cache\n", frame->i_frame );
+        return -1;
+    }
+    if( rec.i_hash != lookahead_cache_hash( frame ) )
+    {
+        x264_log( h, X264_LOG_ERROR, "frame %d does not match the lookahead cache\n", frame->i_frame );
+        return -1;
+    }
+    if( rec.i_type != frame->i_type )
+    {
+        x264_log( h, X264_LOG_ERROR, "frame %d type %d doesn't match lookahead cache type %d\n",
+                  frame->i_frame, frame->i_type, rec.i_type );
+        return -1;
+    }
+
+    int i_qp_offset = sizeof(rec) + 2 * h->mb.i_mb_height * sizeof(int32_t);
+    if( h->param.rc.b_mb_tree &&
+        lookahead_cache_get( h, frame->i_frame, i_qp_offset, h->mb.i_mb_count * sizeof(float), frame->f_qp_offset ) < 0 )
+        return -1;
+    for( int l = 0; h->frames.b_have_lowres_mvs && l <= !!h->param.i_bframe; l++ )
+    {
+        for( int i = 0; i <= h->param.i_bframe; i++ )
+            frame->lowres_mvs[l][i][0][0] = 0x7FFF;
+        int dist = rec.i_lowres_dist[l];
+        if( dist > 0 && dist <= h->param.i_bframe+1 &&
+            lookahead_cache_get( h, frame->i_frame, i_qp_offset + h->mb.i_mb_count * (sizeof(float) + l * sizeof(int16_t[2])),
+                                 h->mb.i_mb_count * sizeof(int16_t[2]), frame->lowres_mvs[l][dist-1] ) < 0 )
+            return -1;
+    }
+    if( frame->i_type == X264_TYPE_P && h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE )
+        for( int i = 0; i < 3; i++ )
+            SET_WEIGHT( frame->weight[0][i], rec.weight[i][0], rec.weight[i][1], rec.weight[i][2], rec.weight[i][3] );
+    if( h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead )
+    {
+        memcpy( frame->i_planned_type, rec.i_planned_type, sizeof(rec.i_planned_type) );
+        memcpy( frame->f_planned_cpb_duration, rec.f_planned_cpb_duration, sizeof(rec.f_planned_cpb_duration) );
+        for( int i = 0; i <= X264_LOOKAHEAD_MAX; i++ )
+            frame->i_planned_satd[i] = rec.i_planned_satd[i];
+    }
+    return 0;
+}
+
+/* Ratecontrol costs of the frame being encoded, in place of x264_rc_analyse_slice.
+ * h->fdec->i_row_satd must already point to the rows of its slice type. */
+int x264_lookahead_cache_costs( x264_t *h )
+{
+    int i_frame = h->fenc->i_frame;
+    int i_rows = h->mb.i_mb_height * sizeof(int32_t);
+    int32_t i_satd;
+    if( lookahead_cache_get( h, i_frame, offsetof( lookahead_record_t, i_satd ), sizeof(i_satd), &i_satd ) < 0 ||
+        lookahead_cache_get( h, i_frame, sizeof(lookahead_record_t), i_rows, h->fdec->i_row_satd ) < 0 ||
+        (!IS_X264_TYPE_I( h->fenc->i_type ) &&
+         lookahead_cache_get( h, i_frame, sizeof(lookahead_record_t) + i_rows, i_rows, h->fdec->i_row_satds[0][0] ) < 0) )
+    {
+        x264_log( h, X264_LOG_ERROR, "failed to read lookahead cache\n" );
+        i_satd = 0;
+        memset( h->fdec->i_row_satd, 0, i_rows );
+    }
+    h->fdec->i_satd = i_satd;
+    return i_satd >> (BIT_DEPTH - 8);
+}
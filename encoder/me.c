@@ -78,6 +78,47 @@ do\
          + p_cost_mvx[ mx ] + p_cost_mvy[ my ];\
 } while(0)
 
+/* Costs of up to 4 subpel candidates, compared together when get_ref left
+ * them all at the same stride. */
+#define COST_MV_HPEL_X4( mvs, n, costs )\
+{\
+    pixel *src[4];\
+    intptr_t stride4[4];\
+    for( int k = 0; k < (n); k++ )\
+    {\
+        stride4[k] = 16;\
+        src[k] = h->mc.get_ref( pix4[k], &stride4[k], m->p_fref, stride, (mvs)[k][0], (mvs)[k][1], bw, bh, &m->weight[0] );\
+    }\
+    if( (n) == 4 && stride4[0] == stride4[1] && stride4[0] == stride4[2] && stride4[0] == stride4[3] )\
+        h->pixf.fpelcmp_x4[i_pixel]( p_fenc, src[0], src[1], src[2], src[3], stride4[0], costs );\
+    else if( (n) == 3 && stride4[0] == stride4[1] && stride4[0] == stride4[2] )\
+        h->pixf.fpelcmp_x3[i_pixel]( p_fenc, src[0], src[1], src[2], stride4[0], costs );\
+    else\
+        for( int k = 0; k < (n); k++ )\
+            (costs)[k] = h->pixf.fpelcmp[i_pixel]( p_fenc, FENC_STRIDE, src[k], stride4[k] );\
+    for( int k = 0; k < (n); k++ )\
+        (costs)[k] += p_cost_mvx[(mvs)[k][0]] + p_cost_mvy[(mvs)[k][1]];\
+}
+
+/* Costs of up to 4 fullpel candidates. */
+#define COST_MV_FPEL_X4( mvs, n, costs )\
+{\
+    if( (n) == 4 )\
+        h->pixf.fpelcmp_x4[i_pixel]( p_fenc,\
+            &p_fref_w[(mvs)[0][1]*stride+(mvs)[0][0]], &p_fref_w[(mvs)[1][1]*stride+(mvs)[1][0]],\
+            &p_fref_w[(mvs)[2][1]*stride+(mvs)[2][0]], &p_fref_w[(mvs)[3][1]*stride+(mvs)[3][0]],\
+            stride, costs );\
+    else if( (n) == 3 )\
+        h->pixf.fpelcmp_x3[i_pixel]( p_fenc,\
+            &p_fref_w[(mvs)[0][1]*stride+(mvs)[0][0]], &p_fref_w[(mvs)[1][1]*stride+(mvs)[1][0]],\
+            &p_fref_w[(mvs)[2][1]*stride+(mvs)[2][0]], stride, costs );\
+    else\
+        for( int k = 0; k < (n); k++ )\
+            (costs)[k] = h->pixf.fpelcmp[i_pixel]( p_fenc, FENC_STRIDE, &p_fref_w[(mvs)[k][1]*stride+(mvs)[k][0]], stride );\
+    for( int k = 0; k < (n); k++ )\
+        (costs)[k] += BITS_MVD( (mvs)[k][0], (mvs)[k][1] );\
+}
+
 #define COST_MV_X3_DIR( m0x, m0y, m1x, m1y, m2x, m2y, costs )\
 {\
     pixel *pix_base = p_fref_w + bmx + bmy*stride;\
@@ -140,6 +181,24 @@ do\
     COPY3_IF_LT( bcost, costs[2], bmx, m2x, bmy, m2y );\
 }
 
+#define COST_MV_X4_ABS( m0x, m0y, m1x, m1y, m2x, m2y, m3x, m3y )\
+{\
+    h->pixf.fpelcmp_x4[i_pixel]( p_fenc,\
+        p_fref_w + (m0x) + (m0y)*stride,\
+        p_fref_w + (m1x) + (m1y)*stride,\
+        p_fref_w + (m2x) + (m2y)*stride,\
+        p_fref_w + (m3x) + (m3y)*stride,\
+        stride, costs );\
+    costs[0] += p_cost_mvx[(m0x)<<2]; /* no cost_mvy */\
+    costs[1] += p_cost_mvx[(m1x)<<2];\
+    costs[2] += p_cost_mvx[(m2x)<<2];\
+    costs[3] += p_cost_mvx[(m3x)<<2];\
+    COPY3_IF_LT( bcost, costs[0], bmx, m0x, bmy, m0y );\
+    COPY3_IF_LT( bcost, costs[1], bmx, m1x, bmy, m1y );\
+    COPY3_IF_LT( bcost, costs[2], bmx, m2x, bmy, m2y );\
+    COPY3_IF_LT( bcost, costs[3], bmx, m3x, bmy, m3y );\
+}
+
 /*  1  */
 /* 101 */
 /*  1  */
@@ -175,6 +234,25 @@ do\
     }\
 }
 
+/* Second level of successive elimination, for the candidates that passed ads:
+ * the DCs of the 4x4 blocks bound the SAD more tightly than those of the 8x8
+ * blocks.  Keeps the candidates of xs whose bound is below thresh. */
+static int x264_me_ads_4x4( int *enc_dc4, intptr_t *offsets, int blocks, uint16_t *sums,
+                            uint16_t *cost_mvx, int16_t *xs, int xn, int thresh )
+{
+    int nmv = 0;
+    for( int i = 0; i < xn; i++ )
+    {
+        uint16_t *sums4 = sums + xs[i];
+        int ads = cost_mvx[xs[i]];
+        for( int j = 0; j < blocks; j++ )
+            ads += abs( enc_dc4[j] - sums4[offsets[j]] );
+        xs[nmv] = xs[i];
+        nmv += ads < thresh;
+    }
+    return nmv;
+}
+
 #define FPEL(mv) (((mv)+2)>>2) /* Convert subpel MV to fullpel with rounding... */
 #define SPEL(mv) ((mv)<<2)     /* ... and the reverse. */
 #define SPELx2(mv) (SPEL(mv)&0xFFFCFFFC) /* for two packed MVs */
@@ -192,6 +270,7 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
     pixel *p_fenc = m->p_fenc[0];
     pixel *p_fref_w = m->p_fref_w;
     ALIGNED_ARRAY_N( pixel, pix,[16*16] );
+    ALIGNED_ARRAY_N( pixel, pix4,[4],[16*16] );
     ALIGNED_ARRAY_8( int16_t, mvc_temp,[16],[2] );
 
     ALIGNED_ARRAY_16( int, costs,[16] );
@@ -231,19 +310,18 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             int valid_mvcs = x264_predictor_clip( mvc_temp+2, mvc, i_mvc, h->mb.mv_limit_fpel, pmv );
             if( valid_mvcs > 0 )
             {
-                int i = 1, cost;
                 /* We stuff pmv here to branchlessly pick between pmv and the various
                  * MV candidates. [0] gets skipped in order to maintain alignment for
-                 * x264_predictor_clip. */
+                 * x264_predictor_clip.  The candidates are compared four at a time. */
                 M32( mvc_temp[1] ) = pmv;
                 bpred_cost <<= 4;
-                do
+                for( int i = 1; i <= valid_mvcs; i += 4 )
                 {
-                    int mx = mvc_temp[i+1][0];
-                    int my = mvc_temp[i+1][1];
-                    COST_MV_HPEL( mx, my, cost );
-                    COPY1_IF_LT( bpred_cost, (cost << 4) + i );
-                } while( ++i <= valid_mvcs );
+                    int n = X264_MIN( valid_mvcs - i + 1, 4 );
+                    COST_MV_HPEL_X4( mvc_temp+i+1, n, costs );
+                    for( int k = 0; k < n; k++ )
+                        COPY1_IF_LT( bpred_cost, (costs[k] << 4) + i + k );
+                }
                 bpred_mx = mvc_temp[(bpred_cost&15)+1][0];
                 bpred_my = mvc_temp[(bpred_cost&15)+1][1];
                 bpred_cost >>= 4;
@@ -296,16 +374,15 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             int valid_mvcs = x264_predictor_roundclip( mvc_temp+2, mvc, i_mvc, h->mb.mv_limit_fpel, pmv );
             if( valid_mvcs > 0 )
             {
-                int i = 1, cost;
                 M32( mvc_temp[1] ) = pmv;
                 bcost <<= 4;
-                do
+                for( int i = 1; i <= valid_mvcs; i += 4 )
                 {
-                    int mx = mvc_temp[i+1][0];
-                    int my = mvc_temp[i+1][1];
-                    cost = h->pixf.fpelcmp[i_pixel]( p_fenc, FENC_STRIDE, &p_fref_w[my*stride+mx], stride ) + BITS_MVD( mx, my );
-                    COPY1_IF_LT( bcost, (cost << 4) + i );
-                } while( ++i <= valid_mvcs );
+                    int n = X264_MIN( valid_mvcs - i + 1, 4 );
+                    COST_MV_FPEL_X4( mvc_temp+i+1, n, costs );
+                    for( int k = 0; k < n; k++ )
+                        COPY1_IF_LT( bcost, (costs[k] << 4) + i + k );
+                }
                 bmx = mvc_temp[(bcost&15)+1][0];
                 bmy = mvc_temp[(bcost&15)+1][1];
                 bcost >>= 4;
@@ -615,6 +692,44 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             break;
         }
 
+        case X264_ME_PYR:
+        {
+            /* Coarse-to-fine search.  The wide search was done by the lookahead
+             * with umh on the lowres planes, and its mv is among the predictors
+             * of 16x16 blocks.  Unless the best predictor is already good, i.e.
+             * its SAD is under 8 per pixel at 8-bit depth, step from it in squares
+             * of radius 4 then 2, each recentred while it improves, and finish
+             * with the hexagon.  The mv cost is left out of the test, as it grows
+             * with lambda.  Smaller blocks start from the 16x16 mv, so they go
+             * straight to the hexagon. */
+            if( i_pixel != PIXEL_16x16 || bcost - BITS_MVD( bmx, bmy ) < (bw*bh*8 << (BIT_DEPTH-8)) )
+                goto me_hex2;
+            for( int step = 4; step > 1; step >>= 1 )
+                for( int i = i_me_range / step; i > 0; i-- )
+                {
+                    if( bmx-step < mv_x_min || bmx+step > mv_x_max || bmy-step < mv_y_min || bmy+step > mv_y_max )
+                        break;
+                    bcost <<= 4;
+                    COST_MV_X4_DIR(  0,-step,     0,step, -step,0,     step,0, costs );
+                    COPY1_IF_LT( bcost, (costs[0]<<4)+1 );
+                    COPY1_IF_LT( bcost, (costs[1]<<4)+2 );
+                    COPY1_IF_LT( bcost, (costs[2]<<4)+3 );
+                    COPY1_IF_LT( bcost, (costs[3]<<4)+4 );
+                    COST_MV_X4_DIR( -step,-step, -step,step, step,-step, step,step, costs );
+                    COPY1_IF_LT( bcost, (costs[0]<<4)+5 );
+                    COPY1_IF_LT( bcost, (costs[1]<<4)+6 );
+                    COPY1_IF_LT( bcost, (costs[2]<<4)+7 );
+                    COPY1_IF_LT( bcost, (costs[3]<<4)+8 );
+                    int dir = bcost&15;
+                    bcost >>= 4;
+                    if( !dir )
+                        break;
+                    bmx += square1[dir][0] * step;
+                    bmy += square1[dir][1] * step;
+                }
+            goto me_hex2;
+        }
+
         case X264_ME_ESA:
         case X264_ME_TESA:
         {
@@ -651,6 +766,19 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             if( i_pixel == PIXEL_8x16 || i_pixel == PIXEL_4x8 )
                 enc_dc[1] = enc_dc[2];
 
+            /* Blocks of 8x8 and up test their candidates again with the 4x4 sums. */
+            uint16_t *sums4_base = m->integral + stride * (h->fenc->i_lines[0] + PADV*2);
+            ALIGNED_ARRAY_16( int, enc_dc4,[16] );
+            intptr_t dc4_offset[16];
+            int dc4_blocks = h->frames.b_have_sub8x8_esa && i_pixel <= PIXEL_8x8 ? (bw>>2)*(bh>>2) : 0;
+            for( int i = 0; i < dc4_blocks; i++ )
+            {
+                int x = (i % (bw>>2)) * 4;
+                int y = (i / (bw>>2)) * 4;
+                enc_dc4[i] = h->pixf.sad[PIXEL_4x4]( zero, FENC_STRIDE, p_fenc+x+y*FENC_STRIDE, FENC_STRIDE );
+                dc4_offset[i] = x + y*stride;
+            }
+
             if( h->mb.i_me_method == X264_ME_TESA )
             {
                 // ADS threshold, then SAD threshold, then keep the best few SADs, then SATD
@@ -668,12 +796,16 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
                     bsad -= ycost;
                     xn = h->pixf.ads[i_pixel]( enc_dc, sums_base + min_x + my * stride, delta,
                                                cost_fpel_mvx+min_x, xs, width, bsad * 17 >> 4 );
-                    for( i = 0; i < xn-2; i += 3 )
+                    /* only drops candidates that the sad threshold below would */
+                    if( dc4_blocks )
+                        xn = x264_me_ads_4x4( enc_dc4, dc4_offset, dc4_blocks, sums4_base + min_x + my * stride,
+                                              cost_fpel_mvx+min_x, xs, xn, bsad*sad_thresh>>3 );
+                    for( i = 0; i < xn-3; i += 4 )
                     {
                         pixel *ref = p_fref_w+min_x+my*stride;
-                        ALIGNED_ARRAY_16( int, sads,[4] ); /* padded to [4] for asm */
-                        h->pixf.sad_x3[i_pixel]( p_fenc, ref+xs[i], ref+xs[i+1], ref+xs[i+2], stride, sads );
-                        for( int j = 0; j < 3; j++ )
+                        ALIGNED_ARRAY_16( int, sads,[4] );
+                        h->pixf.sad_x4[i_pixel]( p_fenc, ref+xs[i], ref+xs[i+1], ref+xs[i+2], ref+xs[i+3], stride, sads );
+                        for( int j = 0; j < 4; j++ )
                         {
                             int sad = sads[j] + cost_fpel_mvx[xs[i+j]];
                             if( sad < bsad*sad_thresh>>3 )
@@ -745,7 +877,20 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
                     else
                         mvsads[bi] = mvsads[nmvsad];
                 }
-                for( int i = 0; i < nmvsad; i++ )
+                int i = 0;
+                for( ; i < nmvsad-3; i += 4 )
+                {
+                    h->pixf.fpelcmp_x4[i_pixel]( p_fenc,
+                        &p_fref_w[mvsads[i+0].mv[1]*stride+mvsads[i+0].mv[0]],
+                        &p_fref_w[mvsads[i+1].mv[1]*stride+mvsads[i+1].mv[0]],
+                        &p_fref_w[mvsads[i+2].mv[1]*stride+mvsads[i+2].mv[0]],
+                        &p_fref_w[mvsads[i+3].mv[1]*stride+mvsads[i+3].mv[0]],
+                        stride, costs );
+                    for( int j = 0; j < 4; j++ )
+                        COPY3_IF_LT( bcost, costs[j] + BITS_MVD( mvsads[i+j].mv[0], mvsads[i+j].mv[1] ),
+                                     bmx, mvsads[i+j].mv[0], bmy, mvsads[i+j].mv[1] );
+                }
+                for( ; i < nmvsad; i++ )
                     COST_MV( mvsads[i].mv[0], mvsads[i].mv[1] );
             }
             else
@@ -760,8 +905,16 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
                     bcost -= ycost;
                     xn = h->pixf.ads[i_pixel]( enc_dc, sums_base + min_x + my * stride, delta,
                                                cost_fpel_mvx+min_x, xs, width, bcost );
-                    for( i = 0; i < xn-2; i += 3 )
+                    if( dc4_blocks )
+                        xn = x264_me_ads_4x4( enc_dc4, dc4_offset, dc4_blocks, sums4_base + min_x + my * stride,
+                                              cost_fpel_mvx+min_x, xs, xn, bcost );
+                    for( i = 0; i < xn-3; i += 4 )
+                        COST_MV_X4_ABS( min_x+xs[i],my, min_x+xs[i+1],my, min_x+xs[i+2],my, min_x+xs[i+3],my );
+                    if( i < xn-2 )
+                    {
                         COST_MV_X3_ABS( min_x+xs[i],my, min_x+xs[i+1],my, min_x+xs[i+2],my );
+                        i += 3;
+                    }
                     bcost += ycost;
                     for( ; i < xn; i++ )
                         COST_MV( min_x+xs[i], my );
@@ -33,6 +33,9 @@
 #include "common/common.h"
 #include "ratecontrol.h"
 #include "me.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 typedef struct
 {
@@ -128,6 +131,7 @@ struct x264_ratecontrol_t
 
     int num_entries;            /* number of ratecontrol_entry_ts */
     ratecontrol_entry_t *entry; /* FIXME: copy needed data and free this once init is done */
+    int chunk_offset;           /* number of entries before entry, when encoding a chunk of the 1st pass */
     double last_qscale;
     double last_qscale_for[3];  /* last qscale for a specific pict type, used for max_diff & ipb factor stuff */
     int last_non_b_pict_type;
@@ -180,6 +184,7 @@ struct x264_ratecontrol_t
 
 static int parse_zones( x264_t *h );
 static int init_pass2(x264_t *);
+static int init_chunk( x264_t *h );
 static float rate_estimate_qscale( x264_t *h );
 static int update_vbv( x264_t *h, int bits );
 static void update_vbv_plan( x264_t *h, int overhead );
@@ -632,6 +637,157 @@ static char *x264_strcat_filename( char *input, char *suffix )
     return output;
 }
 
+/* Binary stats file (--stats-binary), in native byte order: a header, the options
+ * string and one fixed-size record per frame in coded order.  It holds the same data
+ * as the text format, but is read without any parsing.
+ * tools/stats_convert.py converts between the two formats and must be kept in sync. */
+#define STATS_MAGIC   "x264stat"
+#define STATS_VERSION 1
+
+typedef struct
+{
+    char    magic[8];
+    int32_t version;
+    int32_t record_size;
+    int32_t options_size;   /* of the NUL-terminated options string that follows, padded to 8 bytes */
+    int32_t reserved;
+} stats_header_t;
+
+typedef struct
+{
+    int64_t i_duration;
+    int64_t i_cpb_duration;
+    int32_t i_frame;        /* display order */
+    int32_t i_coded;
+    float   qp_rc;
+    float   qp_aq;
+    int32_t tex_bits;
+    int32_t mv_bits;
+    int32_t misc_bits;
+    int32_t i_count;
+    int32_t p_count;
+    int32_t s_count;
+    int32_t refcount[16];
+    int16_t i_weight_denom[2]; /* -1 if not weighted */
+    int16_t weight[3][2];
+    uint8_t type;           /* frame type letter, as in the text format */
+    uint8_t direct;         /* direct mode letter, as in the text format */
+    uint8_t refs;
+    uint8_t reserved[5];
+} stats_record_t;
+
+typedef struct
+{
+    uint8_t *data;          /* the whole file */
+    int64_t size;
+    int     b_mapped;
+    char    *options;
+    stats_record_t *records;
+    int     num_records;
+} stats_binary_t;
+
+/* Returns 1 and loads the stats file, mapping it where possible, if it is in the
+ * binary format; returns 0 if it is not, and -1 on error. */
+static int stats_binary_open( x264_t *h, const char *filename, stats_binary_t *bin )
+{
+    memset( bin, 0, sizeof(stats_binary_t) );
+    FILE *fh = x264_fopen( filename, "rb" );
+    if( !fh )
+        return 0; /* reported by the text reader */
+
+    stats_header_t header;
+    int ret = 0;
+    if( fread( &header, sizeof(header), 1, fh ) != 1 || memcmp( header.magic, STATS_MAGIC, 8 ) )
+        goto end;
+    ret = -1;
+    if( header.version != STATS_VERSION || header.record_size != sizeof(stats_record_t) )
+    {
+        x264_log( h, X264_LOG_ERROR, "binary stats file version %d is not supported\n", header.version );
+        goto end;
+    }
+    if( fseek( fh, 0, SEEK_END ) < 0 || (bin->size = ftell( fh )) < 0 ||
+        header.options_size <= 0 || (header.options_size&7) || sizeof(header) + header.options_size > bin->size ||
+        (WORD_SIZE == 4 && bin->size > INT32_MAX) )
+        goto damaged;
+
+#ifndef _WIN32
+    bin->data = mmap( NULL, bin->size, PROT_READ, MAP_PRIVATE, fileno( fh ), 0 );
+    if( bin->data != MAP_FAILED )
+        bin->b_mapped = 1;
+    else
+#endif
+    {
+        bin->data = x264_malloc( bin->size );
+        if( !bin->data || fseek( fh, 0, SEEK_SET ) < 0 || fread( bin->data, 1, bin->size, fh ) != bin->size )
+            goto damaged;
+    }
+
+    bin->options = (char*)bin->data + sizeof(header);
+    if( bin->options[header.options_size-1] )
+        goto damaged;
+    bin->records = (stats_record_t*)(bin->data + sizeof(header) + header.options_size);
+    bin->num_records = (bin->size - sizeof(header) - header.options_size) / sizeof(stats_record_t);
+    ret = 1;
+    goto end;
+damaged:
+    x264_log( h, X264_LOG_ERROR, "binary stats file is damaged\n" );
+end:
+    fclose( fh );
+    return ret;
+}
+
+static void stats_binary_close( stats_binary_t *bin )
+{
+#ifndef _WIN32
+    if( bin->b_mapped )
+        munmap( bin->data, bin->size );
+    else
+#endif
+        x264_free( bin->data );
+}
+
+/* Finishes an entry read from either format, once its own fields are set.
+ * Returns -1 on an unknown frame type. */
+static int stats_entry_finish( ratecontrol_entry_t *rce, char pict_type, float qp_rc, float res_factor, float res_factor_bits )
+{
+    rce->tex_bits  *= res_factor_bits;
+    rce->mv_bits   *= res_factor_bits;
+    rce->misc_bits *= res_factor_bits;
+    rce->i_count   *= res_factor;
+    rce->p_count   *= res_factor;
+    rce->s_count   *= res_factor;
+
+    if( pict_type != 'b' )
+        rce->kept_as_ref = 1;
+    switch( pict_type )
+    {
+        case 'I':
+            rce->frame_type = X264_TYPE_IDR;
+            rce->pict_type  = SLICE_TYPE_I;
+            break;
+        case 'i':
+            rce->frame_type = X264_TYPE_I;
+            rce->pict_type  = SLICE_TYPE_I;
+            break;
+        case 'P':
+            rce->frame_type = X264_TYPE_P;
+            rce->pict_type  = SLICE_TYPE_P;
+            break;
+        case 'B':
+            rce->frame_type = X264_TYPE_BREF;
+            rce->pict_type  = SLICE_TYPE_B;
+            break;
+        case 'b':
+            rce->frame_type = X264_TYPE_B;
+            rce->pict_type  = SLICE_TYPE_B;
+            break;
+        default:
+            return -1;
+    }
+    rce->qscale = qp2qscale( qp_rc );
+    return 0;
+}
+
 void x264_ratecontrol_init_reconfigurable( x264_t *h, int b_init )
 {
     x264_ratecontrol_t *rc = h->rc;
@@ -871,10 +1027,23 @@ int x264_ratecontrol_new( x264_t *h )
     if( h->param.rc.b_stat_read )
     {
         char *p, *stats_in, *stats_buf;
+        stats_binary_t bin;
 
         /* read 1st pass stats */
         assert( h->param.rc.psz_stat_in );
-        stats_buf = stats_in = x264_slurp_file( h->param.rc.psz_stat_in );
+        int b_binary = stats_binary_open( h, h->param.rc.psz_stat_in, &bin );
+        if( b_binary < 0 )
+            return -1;
+        if( b_binary )
+        {
+            /* the options are checked as if they had been read from the text format */
+            stats_buf = x264_malloc( strlen( bin.options ) + 12 );
+            if( stats_buf )
+                sprintf( stats_buf, "#options: %s\n", bin.options );
+        }
+        else
+            stats_buf = x264_slurp_file( h->param.rc.psz_stat_in );
+        stats_in = stats_buf;
         if( !stats_buf )
         {
             x264_log( h, X264_LOG_ERROR, "ratecontrol_init: can't open stats file\n" );
@@ -996,8 +1165,11 @@ int x264_ratecontrol_new( x264_t *h )
         /* find number of pics */
         p = stats_in;
         int num_entries;
-        for( num_entries = -1; p; num_entries++ )
-            p = strchr( p + 1, ';' );
+        if( b_binary )
+            num_entries = bin.num_records;
+        else
+            for( num_entries = -1; p; num_entries++ )
+                p = strchr( p + 1, ';' );
         if( !num_entries )
         {
             x264_log( h, X264_LOG_ERROR, "empty stats file\n" );
@@ -1005,15 +1177,22 @@ int x264_ratecontrol_new( x264_t *h )
         }
         rc->num_entries = num_entries;
 
-        if( h->param.i_frame_total < rc->num_entries && h->param.i_frame_total > 0 )
+        if( h->param.rc.i_chunk_start >= rc->num_entries )
+        {
+            x264_log( h, X264_LOG_ERROR, "chunk starts at frame %d, after the end of the 1st pass (%d frames)\n",
+                      h->param.rc.i_chunk_start, rc->num_entries );
+            return -1;
+        }
+        if( h->param.i_frame_total < rc->num_entries && h->param.i_frame_total > 0 && h->param.rc.i_chunk_start < 0 )
         {
             x264_log( h, X264_LOG_WARNING, "2nd pass has fewer frames than 1st pass (%d vs %d)\n",
                       h->param.i_frame_total, rc->num_entries );
         }
-        if( h->param.i_frame_total > rc->num_entries )
+        int chunk_entries = rc->num_entries - X264_MAX( h->param.rc.i_chunk_start, 0 );
+        if( h->param.i_frame_total > chunk_entries )
         {
             x264_log( h, X264_LOG_ERROR, "2nd pass has more frames than 1st pass (%d vs %d)\n",
-                      h->param.i_frame_total, rc->num_entries );
+                      h->param.i_frame_total, chunk_entries );
             return -1;
         }
 
@@ -1032,7 +1211,36 @@ int x264_ratecontrol_new( x264_t *h )
         /* read stats */
         p = stats_in;
         double total_qp_aq = 0;
-        for( int i = 0; i < rc->num_entries; i++ )
+        for( int i = 0; b_binary && i < rc->num_entries; i++ )
+        {
+            stats_record_t *r = &bin.records[i];
+            if( r->i_frame < 0 || r->i_frame >= rc->num_entries )
+            {
+                x264_log( h, X264_LOG_ERROR, "bad frame number (%d) at stats record %d\n", r->i_frame, i );
+                return -1;
+            }
+            ratecontrol_entry_t *rce = &rc->entry[r->i_frame];
+            rce->i_duration = r->i_duration;
+            rce->i_cpb_duration = r->i_cpb_duration;
+            rce->tex_bits = r->tex_bits;
+            rce->mv_bits = r->mv_bits;
+            rce->misc_bits = r->misc_bits;
+            rce->i_count = r->i_count;
+            rce->p_count = r->p_count;
+            rce->s_count = r->s_count;
+            rce->direct_mode = r->direct;
+            rce->refs = X264_MIN( r->refs, 16 );
+            memcpy( rce->refcount, r->refcount, sizeof(rce->refcount) );
+            memcpy( rce->i_weight_denom, r->i_weight_denom, sizeof(rce->i_weight_denom) );
+            memcpy( rce->weight, r->weight, sizeof(rce->weight) );
+            if( stats_entry_finish( rce, r->type, r->qp_rc, res_factor, res_factor_bits ) < 0 )
+            {
+                x264_log( h, X264_LOG_ERROR, "statistics are damaged at record %d\n", i );
+                return -1;
+            }
+            total_qp_aq += r->qp_aq;
+        }
+        for( int i = 0; !b_binary && i < rc->num_entries; i++ )
         {
             ratecontrol_entry_t *rce;
             int frame_number;
@@ -1059,12 +1267,6 @@ int x264_ratecontrol_new( x264_t *h )
                    &pict_type, &rce->i_duration, &rce->i_cpb_duration, &qp_rc, &qp_aq, &rce->tex_bits,
                    &rce->mv_bits, &rce->misc_bits, &rce->i_count, &rce->p_count,
                    &rce->s_count, &rce->direct_mode );
-            rce->tex_bits  *= res_factor_bits;
-            rce->mv_bits   *= res_factor_bits;
-            rce->misc_bits *= res_factor_bits;
-            rce->i_count   *= res_factor;
-            rce->p_count   *= res_factor;
-            rce->s_count   *= res_factor;
 
             p = strstr( p, "ref:" );
             if( !p )
@@ -1095,39 +1297,14 @@ int x264_ratecontrol_new( x264_t *h )
                     rce->i_weight_denom[0] = rce->i_weight_denom[1] = -1;
             }
 
-            if( pict_type != 'b' )
-                rce->kept_as_ref = 1;
-            switch( pict_type )
-            {
-                case 'I':
-                    rce->frame_type = X264_TYPE_IDR;
-                    rce->pict_type  = SLICE_TYPE_I;
-                    break;
-                case 'i':
-                    rce->frame_type = X264_TYPE_I;
-                    rce->pict_type  = SLICE_TYPE_I;
-                    break;
-                case 'P':
-                    rce->frame_type = X264_TYPE_P;
-                    rce->pict_type  = SLICE_TYPE_P;
-                    break;
-                case 'B':
-                    rce->frame_type = X264_TYPE_BREF;
-                    rce->pict_type  = SLICE_TYPE_B;
-                    break;
-                case 'b':
-                    rce->frame_type = X264_TYPE_B;
-                    rce->pict_type  = SLICE_TYPE_B;
-                    break;
-                default:  e = -1; break;
-            }
+            if( stats_entry_finish( rce, pict_type, qp_rc, res_factor, res_factor_bits ) < 0 )
+                e = -1;
             if( e < 13 )
             {
 parse_error:
                 x264_log( h, X264_LOG_ERROR, "statistics are damaged at line %d, parser out=%d\n", i, e );
                 return -1;
             }
-            rce->qscale = qp2qscale( qp_rc );
             total_qp_aq += qp_aq;
             p = next;
         }
@@ -1135,12 +1312,17 @@ parse_error:
             h->pps->i_pic_init_qp = SPEC_QP( (int)(total_qp_aq / rc->num_entries + 0.5) );
 
         x264_free( stats_buf );
+        if( b_binary )
+            stats_binary_close( &bin );
 
         if( h->param.rc.i_rc_method == X264_RC_ABR )
         {
             if( init_pass2( h ) < 0 )
                 return -1;
         } /* else we're using constant quant, so no need to run the bitrate allocation */
+
+        if( h->param.rc.i_chunk_start >= 0 && init_chunk( h ) < 0 )
+            return -1;
     }
 
     /* Open output file */
@@ -1161,7 +1343,20 @@ parse_error:
         }
 
         p = x264_param2string( &h->param, 1 );
-        if( p )
+        if( p && h->param.rc.b_stat_binary )
+        {
+            stats_header_t header = { STATS_MAGIC, STATS_VERSION, sizeof(stats_record_t) };
+            header.options_size = (strlen( p ) + 8) & ~7;
+            if( fwrite( &header, sizeof(header), 1, rc->p_stat_file_out ) != 1 ||
+                fwrite( p, 1, strlen( p ), rc->p_stat_file_out ) != strlen( p ) ||
+                fwrite( (uint8_t[8]){0}, 1, header.options_size - strlen( p ), rc->p_stat_file_out ) != header.options_size - strlen( p ) )
+            {
+                x264_log( h, X264_LOG_ERROR, "ratecontrol_init: can't write stats file\n" );
+                x264_free( p );
+                return -1;
+            }
+        }
+        else if( p )
             fprintf( rc->p_stat_file_out, "#options: %s\n", p );
         x264_free( p );
         if( h->param.rc.b_mb_tree && !h->param.rc.b_stat_read )
@@ -1189,6 +1384,19 @@ parse_error:
         }
         if( x264_macroblock_tree_rescale_init( h, rc ) < 0 )
             return -1;
+
+        /* Skip the qp offsets of the reference frames before the chunk. */
+        if( rc->chunk_offset )
+        {
+            int64_t refs = 0;
+            for( int i = -rc->chunk_offset; i < 0; i++ )
+                refs += rc->entry[i].kept_as_ref;
+            if( fseek( rc->p_mbtree_stat_file_in, refs * (1 + rc->mbtree.src_mb_count * sizeof(uint16_t)), SEEK_SET ) < 0 )
+            {
+                x264_log( h, X264_LOG_ERROR, "Incomplete MB-tree stats file.\n" );
+                return -1;
+            }
+        }
     }
 
     for( int i = 0; i<h->param.i_threads; i++ )
@@ -1375,7 +1583,7 @@ void x264_ratecontrol_delete( x264_t *h )
         fclose( rc->p_mbtree_stat_file_in );
     x264_free( rc->pred );
     x264_free( rc->pred_b_from_p );
-    x264_free( rc->entry );
+    x264_free( rc->entry - rc->chunk_offset );
     x264_macroblock_tree_rescale_destroy( rc );
     if( rc->zones )
     {
@@ -1790,6 +1998,107 @@ void x264_ratecontrol_set_weights( x264_t *h, x264_frame_t *frm )
     }
 }
 
+/* Only write information for reference reordering once. */
+static int stats_refcount( x264_t *h, int refcount[16] )
+{
+    x264_ratecontrol_t *rc = h->rc;
+    int use_old_stats = h->param.rc.b_stat_read && rc->rce->refs > 1;
+    int refs = use_old_stats ? rc->rce->refs : h->i_ref[0];
+    for( int i = 0; i < refs; i++ )
+        refcount[i] = use_old_stats         ? rc->rce->refcount[i]
+                    : PARAM_INTERLACED      ? h->stat.frame.i_mb_count_ref[0][i*2]
+                                            + h->stat.frame.i_mb_count_ref[0][i*2+1]
+                    :                         h->stat.frame.i_mb_count_ref[0][i];
+    return refs;
+}
+
+static int stats_write_text( x264_t *h, char c_type, char c_direct )
+{
+    x264_ratecontrol_t *rc = h->rc;
+    if( fprintf( rc->p_stat_file_out,
+             "in:%d out:%d type:%c dur:%"PRId64" cpbdur:%"PRId64" q:%.2f aq:%.2f tex:%d mv:%d misc:%d imb:%d pmb:%d smb:%d d:%c ref:",
+             h->fenc->i_frame, h->i_frame,
+             c_type, h->fenc->i_duration,
+             h->fenc->i_cpb_duration,
+             rc->qpa_rc, h->fdec->f_qp_avg_aq,
+             h->stat.frame.i_tex_bits,
+             h->stat.frame.i_mv_bits,
+             h->stat.frame.i_misc_bits,
+             h->stat.frame.i_mb_count_i,
+             h->stat.frame.i_mb_count_p,
+             h->stat.frame.i_mb_count_skip,
+             c_direct) < 0 )
+        return -1;
+
+    int refcount[16];
+    int refs = stats_refcount( h, refcount );
+    for( int i = 0; i < refs; i++ )
+        if( fprintf( rc->p_stat_file_out, "%d ", refcount[i] ) < 0 )
+            return -1;
+
+    if( h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE && h->sh.weight[0][0].weightfn )
+    {
+        if( fprintf( rc->p_stat_file_out, "w:%d,%d,%d",
+                     h->sh.weight[0][0].i_denom, h->sh.weight[0][0].i_scale, h->sh.weight[0][0].i_offset ) < 0 )
+            return -1;
+        if( h->sh.weight[0][1].weightfn || h->sh.weight[0][2].weightfn )
+        {
+            if( fprintf( rc->p_stat_file_out, ",%d,%d,%d,%d,%d ",
+                         h->sh.weight[0][1].i_denom, h->sh.weight[0][1].i_scale, h->sh.weight[0][1].i_offset,
+                         h->sh.weight[0][2].i_scale, h->sh.weight[0][2].i_offset ) < 0 )
+                return -1;
+        }
+        else if( fprintf( rc->p_stat_file_out, " " ) < 0 )
+            return -1;
+    }
+
+    if( fprintf( rc->p_stat_file_out, ";\n") < 0 )
+        return -1;
+    return 0;
+}
+
+static int stats_write_binary( x264_t *h, char c_type, char c_direct )
+{
+    x264_ratecontrol_t *rc = h->rc;
+    stats_record_t r = {0};
+    int refcount[16];
+    r.i_frame = h->fenc->i_frame;
+    r.i_coded = h->i_frame;
+    r.type = c_type;
+    r.direct = c_direct;
+    r.i_duration = h->fenc->i_duration;
+    r.i_cpb_duration = h->fenc->i_cpb_duration;
+    r.qp_rc = rc->qpa_rc;
+    r.qp_aq = h->fdec->f_qp_avg_aq;
+    r.tex_bits = h->stat.frame.i_tex_bits;
+    r.mv_bits = h->stat.frame.i_mv_bits;
+    r.misc_bits = h->stat.frame.i_misc_bits;
+    r.i_count = h->stat.frame.i_mb_count_i;
+    r.p_count = h->stat.frame.i_mb_count_p;
+    r.s_count = h->stat.frame.i_mb_count_skip;
+    r.refs = stats_refcount( h, refcount );
+    for( int i = 0; i < r.refs; i++ )
+        r.refcount[i] = refcount[i];
+
+    r.i_weight_denom[0] = r.i_weight_denom[1] = -1;
+    if( h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE && h->sh.weight[0][0].weightfn )
+    {
+        r.i_weight_denom[0] = h->sh.weight[0][0].i_denom;
+        r.weight[0][0] = h->sh.weight[0][0].i_scale;
+        r.weight[0][1] = h->sh.weight[0][0].i_offset;
+        if( h->sh.weight[0][1].weightfn || h->sh.weight[0][2].weightfn )
+        {
+            r.i_weight_denom[1] = h->sh.weight[0][1].i_denom;
+            for( int i = 1; i < 3; i++ )
+            {
+                r.weight[i][0] = h->sh.weight[0][i].i_scale;
+                r.weight[i][1] = h->sh.weight[0][i].i_offset;
+            }
+        }
+    }
+    return fwrite( &r, sizeof(r), 1, rc->p_stat_file_out ) == 1 ? 0 : -1;
+}
+
 /* After encoding one frame, save stats and update ratecontrol state */
 int x264_ratecontrol_end( x264_t *h, int bits, int *filler )
 {
@@ -1819,50 +2128,8 @@ int x264_ratecontrol_end( x264_t *h, int bits, int *filler )
                         ( dir_frame>0 ? 's' : dir_frame<0 ? 't' :
                           dir_avg>0 ? 's' : dir_avg<0 ? 't' : '-' )
                         : '-';
-        if( fprintf( rc->p_stat_file_out,
-                 "in:%d out:%d type:%c dur:%"PRId64" cpbdur:%"PRId64" q:%.2f aq:%.2f tex:%d mv:%d misc:%d imb:%d pmb:%d smb:%d d:%c ref:",
-                 h->fenc->i_frame, h->i_frame,
-                 c_type, h->fenc->i_duration,
-                 h->fenc->i_cpb_duration,
-                 rc->qpa_rc, h->fdec->f_qp_avg_aq,
-                 h->stat.frame.i_tex_bits,
-                 h->stat.frame.i_mv_bits,
-                 h->stat.frame.i_misc_bits,
-                 h->stat.frame.i_mb_count_i,
-                 h->stat.frame.i_mb_count_p,
-                 h->stat.frame.i_mb_count_skip,
-                 c_direct) < 0 )
-            goto fail;
-
-        /* Only write information for reference reordering once. */
-        int use_old_stats = h->param.rc.b_stat_read && rc->rce->refs > 1;
-        for( int i = 0; i < (use_old_stats ? rc->rce->refs : h->i_ref[0]); i++ )
-        {
-            int refcount = use_old_stats         ? rc->rce->refcount[i]
-                         : PARAM_INTERLACED      ? h->stat.frame.i_mb_count_ref[0][i*2]
-                                                 + h->stat.frame.i_mb_count_ref[0][i*2+1]
-                         :                         h->stat.frame.i_mb_count_ref[0][i];
-            if( fprintf( rc->p_stat_file_out, "%d ", refcount ) < 0 )
-                goto fail;
-        }
-
-        if( h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE && h->sh.weight[0][0].weightfn )
-        {
-            if( fprintf( rc->p_stat_file_out, "w:%d,%d,%d",
-                         h->sh.weight[0][0].i_denom, h->sh.weight[0][0].i_scale, h->sh.weight[0][0].i_offset ) < 0 )
-                goto fail;
-            if( h->sh.weight[0][1].weightfn || h->sh.weight[0][2].weightfn )
-            {
-                if( fprintf( rc->p_stat_file_out, ",%d,%d,%d,%d,%d ",
-                             h->sh.weight[0][1].i_denom, h->sh.weight[0][1].i_scale, h->sh.weight[0][1].i_offset,
-                             h->sh.weight[0][2].i_scale, h->sh.weight[0][2].i_offset ) < 0 )
-                    goto fail;
-            }
-            else if( fprintf( rc->p_stat_file_out, " " ) < 0 )
-                goto fail;
-        }
-
-        if( fprintf( rc->p_stat_file_out, ";\n") < 0 )
+        if( h->param.rc.b_stat_binary ? stats_write_binary( h, c_type, c_direct ) < 0
+                                      : stats_write_text( h, c_type, c_direct ) < 0 )
             goto fail;
 
         /* Don't re-write the data in multi-pass mode. */
@@ -3093,3 +3360,51 @@ static int init_pass2( x264_t *h )
 fail:
     return -1;
 }
+
+/* Restricts the 2nd pass to the chunk of the 1st pass that starts at rc.i_chunk_start.
+ * The bitrate allocation and the VBV plan were made for the whole 1st pass, so chunks
+ * encoded separately add up to the target bitrate, and each one starts from the buffer
+ * state the previous one was planned to end with. */
+static int init_chunk( x264_t *h )
+{
+    x264_ratecontrol_t *rcc = h->rc;
+    int start = h->param.rc.i_chunk_start;
+    int end = h->param.i_frame_total > 0 ? start + h->param.i_frame_total : rcc->num_entries;
+
+    /* Frames can't reference across the chunk boundaries. */
+    if( rcc->entry[start].frame_type != X264_TYPE_IDR ||
+        (end < rcc->num_entries && rcc->entry[end].frame_type != X264_TYPE_IDR) )
+    {
+        x264_log( h, X264_LOG_ERROR, "chunk %d-%d doesn't start and end at IDR frames of the 1st pass\n", start, end-1 );
+        return -1;
+    }
+
+    if( rcc->b_2pass )
+    {
+        /* new_qscale is only planned by the 2nd pass bitrate allocation */
+        double chunk_bits = 0;
+        for( int i = start; i < end; i++ )
+            chunk_bits += qscale2bits( &rcc->entry[i], rcc->entry[i].new_qscale );
+        uint64_t bits_before = rcc->entry[start].expected_bits;
+        for( int i = start; i < end; i++ )
+            rcc->entry[i].expected_bits -= bits_before;
+        if( rcc->b_vbv && start )
+            rcc->buffer_fill_final =
+            rcc->buffer_fill_final_min = rcc->entry[start-1].expected_vbv * h->sps->vui.i_time_scale;
+
+        if( rcc->b_vbv )
+            x264_log( h, X264_LOG_INFO, "chunk %d-%d of %d frames: %.0f kbit planned, VBV starting %.0f%% full\n",
+                      start, end-1, rcc->num_entries, chunk_bits / 1000,
+                      100. * rcc->buffer_fill_final / h->sps->vui.i_time_scale / rcc->buffer_size );
+        else
+            x264_log( h, X264_LOG_INFO, "chunk %d-%d of %d frames: %.0f kbit planned\n",
+                      start, end-1, rcc->num_entries, chunk_bits / 1000 );
+    }
+    else
+        x264_log( h, X264_LOG_INFO, "chunk %d-%d of %d frames\n", start, end-1, rcc->num_entries );
+
+    rcc->entry += start;
+    rcc->chunk_offset = start;
+    rcc->num_entries = end - start;
+    return 0;
+}
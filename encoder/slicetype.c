@@ -55,7 +55,12 @@ static void x264_lowres_context_init( x264_t *h, x264_mb_analysis_t *a )
     x264_mb_analyse_load_costs( h, a );
     if( h->param.analyse.i_subpel_refine > 1 )
     {
-        h->mb.i_me_method = X264_MIN( X264_ME_HEX, h->param.analyse.i_me_method );
+        /* me=pyr does its wide search here, on the lowres planes, and seeds the
+         * fullres search with the result. */
+        if( h->param.analyse.i_me_method == X264_ME_PYR )
+            h->mb.i_me_method = X264_ME_UMH;
+        else
+            h->mb.i_me_method = X264_MIN( X264_ME_HEX, h->param.analyse.i_me_method );
         h->mb.i_subpel_refine = 4;
     }
     else
@@ -793,6 +798,21 @@ lowres_intra_mb:
    (h->mb.i_mb_width - 2) * (h->mb.i_mb_height - 2) :\
     h->mb.i_mb_width * h->mb.i_mb_height)
 
+/* Shared state for multithreaded lookahead: rows are handed out on demand
+ * instead of splitting the frame into fixed slices.  Rows and progress are
+ * updated with atomics; the mutex is only taken by threads that have to sleep. */
+typedef struct
+{
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t  cv_progress; /* signaled when a row publishes progress and someone waits */
+    int i_next_row;                   /* next row to hand out, counting down */
+    int i_waiting;                    /* threads waiting on cv_progress */
+    int *row_done;                    /* number of completed mbs in each row */
+} x264_slicetype_rows_t;
+
+/* Rows publish their progress every this many mbs, and at their end. */
+#define LOWRES_ROW_BATCH 4
+
 typedef struct
 {
     x264_t *h;
@@ -806,11 +826,13 @@ typedef struct
     const x264_weight_t *w;
     int *output_inter;
     int *output_intra;
+    x264_slicetype_rows_t *rows;
 } x264_slicetype_slice_t;
 
 static void x264_slicetype_slice_cost( x264_slicetype_slice_t *s )
 {
     x264_t *h = s->h;
+    x264_slicetype_rows_t *rows = s->rows;
 
     /* Lowres lookahead goes backwards because the MVs are used as predictors in the main encode.
      * This considerably improves MV prediction overall. */
@@ -824,10 +846,60 @@ static void x264_slicetype_slice_cost( x264_slicetype_slice_t *s )
     int start_x = h->mb.i_mb_width - 2 + do_edges;
     int end_x = 1 - do_edges;
 
-    for( h->mb.i_mb_y = start_y; h->mb.i_mb_y >= end_y; h->mb.i_mb_y-- )
+    if( !rows )
+    {
+        for( h->mb.i_mb_y = start_y; h->mb.i_mb_y >= end_y; h->mb.i_mb_y-- )
+            for( h->mb.i_mb_x = start_x; h->mb.i_mb_x >= end_x; h->mb.i_mb_x-- )
+                x264_slicetype_mb_cost( h, s->a, s->frames, s->p0, s->p1, s->b, s->dist_scale_factor,
+                                        s->do_search, s->w, s->output_inter, s->output_intra );
+        return;
+    }
+
+    /* The mv predictors of an mb come from the mbs at x-1..x+1 of the row below,
+     * so each row trails the one below it by two mbs. */
+    while( 1 )
+    {
+        int mb_y = x264_atomic_fetch_add( &rows->i_next_row, -1 );
+        if( mb_y < end_y )
+            break;
+        if( mb_y > start_y )
+            continue;
+
+        int *done_below = mb_y < start_y ? &rows->row_done[mb_y+1] : NULL;
+        int i_below = 0;
+        int i_done = 0;
+        int i_published = 0;
+        h->mb.i_mb_y = mb_y;
         for( h->mb.i_mb_x = start_x; h->mb.i_mb_x >= end_x; h->mb.i_mb_x-- )
+        {
+            if( done_below )
+            {
+                int needed = start_x - X264_MAX( h->mb.i_mb_x - 1, end_x ) + 1;
+                if( i_below < needed && (i_below = x264_atomic_fetch_add( done_below, 0 )) < needed )
+                {
+                    x264_pthread_mutex_lock( &rows->mutex );
+                    x264_atomic_fetch_add( &rows->i_waiting, 1 );
+                    while( (i_below = x264_atomic_fetch_add( done_below, 0 )) < needed )
+                        x264_pthread_cond_wait( &rows->cv_progress, &rows->mutex );
+                    x264_atomic_fetch_add( &rows->i_waiting, -1 );
+                    x264_pthread_mutex_unlock( &rows->mutex );
+                }
+            }
             x264_slicetype_mb_cost( h, s->a, s->frames, s->p0, s->p1, s->b, s->dist_scale_factor,
                                     s->do_search, s->w, s->output_inter, s->output_intra );
+            if( ++i_done - i_published == LOWRES_ROW_BATCH || h->mb.i_mb_x == end_x )
+            {
+                x264_atomic_fetch_add( &rows->row_done[mb_y], i_done - i_published );
+                i_published = i_done;
+                if( x264_atomic_fetch_add( &rows->i_waiting, 0 ) )
+                {
+                    x264_pthread_mutex_lock( &rows->mutex );
+                    x264_pthread_cond_broadcast( &rows->cv_progress );
+                    x264_pthread_mutex_unlock( &rows->mutex );
+                }
+            }
+        }
+    }
 }
 
 static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
@@ -867,11 +939,20 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
         if( p1 != p0 )
             dist_scale_factor = ( ((b-p0) << 8) + ((p1-p0) >> 1) ) / (p1-p0);
 
-        int output_buf_size = h->mb.i_mb_height + (NUM_INTS + PAD_SIZE) * h->param.i_lookahead_threads;
+        /* Each thread gets its own accumulators with room for the satds of every row. */
+        int output_size = h->mb.i_mb_height + NUM_INTS + PAD_SIZE;
         int *output_inter[X264_LOOKAHEAD_THREAD_MAX+1];
         int *output_intra[X264_LOOKAHEAD_THREAD_MAX+1];
         output_inter[0] = h->scratch_buffer2;
-        output_intra[0] = output_inter[0] + output_buf_size;
+        output_intra[0] = output_inter[0] + output_size * h->param.i_lookahead_threads;
+        for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        {
+            memset( output_inter[i], 0, (output_size - PAD_SIZE) * sizeof(int) );
+            memset( output_intra[i], 0, (output_size - PAD_SIZE) * sizeof(int) );
+            output_inter[i][NUM_ROWS] = output_intra[i][NUM_ROWS] = h->mb.i_mb_height;
+            output_inter[i+1] = output_inter[i] + output_size;
+            output_intra[i+1] = output_intra[i] + output_size;
+        }
 
 #if HAVE_OPENCL
         if( h->param.b_opencl )
@@ -899,6 +980,14 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
             if( h->param.i_lookahead_threads > 1 )
             {
                 x264_slicetype_slice_t s[X264_LOOKAHEAD_THREAD_MAX];
+                x264_slicetype_rows_t rows;
+
+                rows.i_next_row = h->mb.i_mb_height - 1;
+                rows.i_waiting = 0;
+                rows.row_done = output_intra[h->param.i_lookahead_threads];
+                memset( rows.row_done, 0, h->mb.i_mb_height * sizeof(int) );
+                x264_pthread_mutex_init( &rows.mutex, NULL );
+                x264_pthread_cond_init( &rows.cv_progress, NULL );
 
                 for( int i = 0; i < h->param.i_lookahead_threads; i++ )
                 {
@@ -910,34 +999,25 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
                     t->mb.b_chroma_me = h->mb.b_chroma_me;
 
                     s[i] = (x264_slicetype_slice_t){ t, a, frames, p0, p1, b, dist_scale_factor, do_search, w,
-                        output_inter[i], output_intra[i] };
-
-                    t->i_threadslice_start = ((h->mb.i_mb_height *  i    + h->param.i_lookahead_threads/2) / h->param.i_lookahead_threads);
-                    t->i_threadslice_end   = ((h->mb.i_mb_height * (i+1) + h->param.i_lookahead_threads/2) / h->param.i_lookahead_threads);
+                        output_inter[i], output_intra[i], &rows };
 
-                    int thread_height = t->i_threadslice_end - t->i_threadslice_start;
-                    int thread_output_size = thread_height + NUM_INTS;
-                    memset( output_inter[i], 0, thread_output_size * sizeof(int) );
-                    memset( output_intra[i], 0, thread_output_size * sizeof(int) );
-                    output_inter[i][NUM_ROWS] = output_intra[i][NUM_ROWS] = thread_height;
-
-                    output_inter[i+1] = output_inter[i] + thread_output_size + PAD_SIZE;
-                    output_intra[i+1] = output_intra[i] + thread_output_size + PAD_SIZE;
+                    t->i_threadslice_start = 0;
+                    t->i_threadslice_end = h->mb.i_mb_height;
 
                     x264_threadpool_run( h->lookaheadpool, (void*)x264_slicetype_slice_cost, &s[i] );
                 }
                 for( int i = 0; i < h->param.i_lookahead_threads; i++ )
                     x264_threadpool_wait( h->lookaheadpool, &s[i] );
+
+                x264_pthread_mutex_destroy( &rows.mutex );
+                x264_pthread_cond_destroy( &rows.cv_progress );
             }
             else
             {
                 h->i_threadslice_start = 0;
                 h->i_threadslice_end = h->mb.i_mb_height;
-                memset( output_inter[0], 0, (output_buf_size - PAD_SIZE) * sizeof(int) );
-                memset( output_intra[0], 0, (output_buf_size - PAD_SIZE) * sizeof(int) );
-                output_inter[0][NUM_ROWS] = output_intra[0][NUM_ROWS] = h->mb.i_mb_height;
                 x264_slicetype_slice_t s = (x264_slicetype_slice_t){ h, a, frames, p0, p1, b, dist_scale_factor, do_search, w,
-                    output_inter[0], output_intra[0] };
+                    output_inter[0], output_intra[0], NULL };
                 x264_slicetype_slice_cost( &s );
             }
 
@@ -954,6 +1034,12 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
 
             int *row_satd_inter = fenc->i_row_satds[b-p0][p1-b];
             int *row_satd_intra = fenc->i_row_satds[0][0];
+            if( h->param.rc.i_vbv_buffer_size )
+            {
+                memset( row_satd_inter, 0, h->mb.i_mb_height * sizeof(int) );
+                if( !fenc->b_intra_calculated )
+                    memset( row_satd_intra, 0, h->mb.i_mb_height * sizeof(int) );
+            }
             for( int i = 0; i < h->param.i_lookahead_threads; i++ )
             {
                 if( b == p1 )
@@ -967,15 +1053,14 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
                 fenc->i_cost_est[b-p0][p1-b] += output_inter[i][COST_EST];
                 fenc->i_cost_est_aq[b-p0][p1-b] += output_inter[i][COST_EST_AQ];
 
+                /* every row is computed by exactly one thread, the others leave it at zero */
                 if( h->param.rc.i_vbv_buffer_size )
-                {
-                    int row_count = output_inter[i][NUM_ROWS];
-                    memcpy( row_satd_inter, output_inter[i] + NUM_INTS, row_count * sizeof(int) );
-                    if( !fenc->b_intra_calculated )
-                        memcpy( row_satd_intra, output_intra[i] + NUM_INTS, row_count * sizeof(int) );
-                    row_satd_inter += row_count;
-                    row_satd_intra += row_count;
-                }
+                    for( int y = 0; y < output_inter[i][NUM_ROWS]; y++ )
+                    {
+                        row_satd_inter[y] += output_inter[i][NUM_INTS+y];
+                        if( !fenc->b_intra_calculated )
+                            row_satd_intra[y] += output_intra[i][NUM_INTS+y];
+                    }
             }
 
             i_score = fenc->i_cost_est[b-p0][p1-b];
@@ -1052,41 +1137,156 @@ static void x264_macroblock_tree_finish( x264_t *h, x264_frame_t *frame, float a
     }
 }
 
+typedef struct x264_mbtree_band_t
+{
+    x264_t *h;
+    uint16_t *ref_costs[2];
+    int16_t (*mvs[2])[2];
+    int bipred_weights[2];
+    int i_lists;
+    uint16_t *propagate_cost;
+    int b_referenced;
+    uint16_t *intra_cost;
+    uint16_t *lowres_costs;
+    uint16_t *inv_qscale_factor;
+    float fps_factor;
+    int i_start_y;
+    int i_end_y;
+    /* threaded propagation only */
+    uint16_t *accum[2];     /* rows i_accum_min..i_accum_max of each reference frame */
+    int i_accum_min[2];
+    int i_accum_max[2];
+    struct x264_mbtree_band_t *bands;
+    int i_bands;
+} x264_mbtree_band_t;
+
+static void x264_macroblock_tree_propagate_rows( x264_mbtree_band_t *band, uint16_t **ref_costs )
+{
+    x264_t *h = band->h;
+    int16_t *buf = h->scratch_buffer;
+    uint16_t *propagate_cost = band->propagate_cost;
+    if( band->b_referenced )
+        propagate_cost += band->i_start_y * h->mb.i_mb_width;
+
+    for( int mb_y = band->i_start_y; mb_y < band->i_end_y; mb_y++ )
+    {
+        int mb_index = mb_y*h->mb.i_mb_stride;
+        h->mc.mbtree_propagate_cost( buf, propagate_cost,
+            band->intra_cost+mb_index, band->lowres_costs+mb_index,
+            band->inv_qscale_factor+mb_index, &band->fps_factor, h->mb.i_mb_width );
+        if( band->b_referenced )
+            propagate_cost += h->mb.i_mb_width;
+
+        for( int list = 0; list < band->i_lists; list++ )
+            h->mc.mbtree_propagate_list( h, ref_costs[list], &band->mvs[list][mb_index], buf, &band->lowres_costs[mb_index],
+                                         band->bipred_weights[list], mb_y, h->mb.i_mb_width, list );
+    }
+}
+
+/* Propagation scatters costs into the rows of the reference frames that the mvs point to, so each
+ * band accumulates into private buffers that are merged afterwards.  The buffers only cover the rows
+ * the band's mvs reach, which the band finds first.  All amounts are non-negative and saturate at
+ * the same limit, so the merged result is identical to the serial one. */
+static void x264_macroblock_tree_propagate_band( x264_mbtree_band_t *band )
+{
+    x264_t *h = band->h;
+    int stride = h->mb.i_mb_stride;
+    uint16_t *ref_costs[2];
+    for( int list = 0; list < band->i_lists; list++ )
+    {
+        int min_y = h->mb.i_mb_height;
+        int max_y = -1;
+        for( int mb_y = band->i_start_y; mb_y < band->i_end_y; mb_y++ )
+            for( int mb_index = mb_y*stride; mb_index < mb_y*stride + h->mb.i_mb_width; mb_index++ )
+                if( (band->lowres_costs[mb_index] >> LOWRES_COST_SHIFT) & (1 << list) )
+                {
+                    /* mbtree_propagate_list adds to this row and the next one */
+                    int mby = (band->mvs[list][mb_index][1] >> 5) + mb_y;
+                    min_y = X264_MIN( min_y, mby );
+                    max_y = X264_MAX( max_y, mby + 1 );
+                }
+        band->i_accum_min[list] = min_y = X264_MAX( min_y, 0 );
+        band->i_accum_max[list] = max_y = X264_MIN( max_y, h->mb.i_mb_height - 1 );
+        if( max_y >= min_y )
+            memset( band->accum[list], 0, (max_y - min_y + 1) * stride * sizeof(uint16_t) );
+        ref_costs[list] = band->accum[list] - min_y * stride;
+    }
+    x264_macroblock_tree_propagate_rows( band, ref_costs );
+}
+
+static void x264_macroblock_tree_merge_band( x264_mbtree_band_t *band )
+{
+    int stride = band->h->mb.i_mb_stride;
+    for( int list = 0; list < band->i_lists; list++ )
+        for( int y = band->i_start_y; y < band->i_end_y; y++ )
+        {
+            uint16_t *dst = band->ref_costs[list] + y*stride;
+            for( int j = 0; j < band->i_bands; j++ )
+            {
+                x264_mbtree_band_t *src = &band->bands[j];
+                if( y < src->i_accum_min[list] || y > src->i_accum_max[list] )
+                    continue;
+                uint16_t *accum = src->accum[list] + (y - src->i_accum_min[list]) * stride;
+                for( int x = 0; x < band->h->mb.i_mb_width; x++ )
+                    dst[x] = X264_MIN( dst[x] + accum[x], (1<<15)-1 );
+            }
+        }
+}
+
 static void x264_macroblock_tree_propagate( x264_t *h, x264_frame_t **frames, float average_duration, int p0, int p1, int b, int referenced )
 {
-    uint16_t *ref_costs[2] = {frames[p0]->i_propagate_cost,frames[p1]->i_propagate_cost};
     int dist_scale_factor = ( ((b-p0) << 8) + ((p1-p0) >> 1) ) / (p1-p0);
     int i_bipred_weight = h->param.analyse.b_weighted_bipred ? 64 - (dist_scale_factor>>2) : 32;
-    int16_t (*mvs[2])[2] = { frames[b]->lowres_mvs[0][b-p0-1], frames[b]->lowres_mvs[1][p1-b-1] };
-    int bipred_weights[2] = {i_bipred_weight, 64 - i_bipred_weight};
-    int16_t *buf = h->scratch_buffer;
-    uint16_t *propagate_cost = frames[b]->i_propagate_cost;
-    uint16_t *lowres_costs = frames[b]->lowres_costs[b-p0][p1-b];
+    x264_mbtree_band_t band =
+    {
+        .h = h,
+        .ref_costs = { frames[p0]->i_propagate_cost, frames[p1]->i_propagate_cost },
+        .mvs = { frames[b]->lowres_mvs[0][b-p0-1], frames[b]->lowres_mvs[1][p1-b-1] },
+        .bipred_weights = { i_bipred_weight, 64 - i_bipred_weight },
+        .i_lists = b != p1 ? 2 : 1,
+        .propagate_cost = frames[b]->i_propagate_cost,
+        .b_referenced = referenced,
+        .intra_cost = frames[b]->i_intra_cost,
+        .lowres_costs = frames[b]->lowres_costs[b-p0][p1-b],
+        .inv_qscale_factor = frames[b]->i_inv_qscale_factor,
+        .i_start_y = 0,
+        .i_end_y = h->mb.i_mb_height
+    };
 
     x264_emms();
-    float fps_factor = CLIP_DURATION(frames[b]->f_duration) / (CLIP_DURATION(average_duration) * 256.0f) * MBTREE_PRECISION;
+    band.fps_factor = CLIP_DURATION(frames[b]->f_duration) / (CLIP_DURATION(average_duration) * 256.0f) * MBTREE_PRECISION;
 
     /* For non-reffed frames the source costs are always zero, so just memset one row and re-use it. */
     if( !referenced )
         memset( frames[b]->i_propagate_cost, 0, h->mb.i_mb_width * sizeof(uint16_t) );
 
-    for( h->mb.i_mb_y = 0; h->mb.i_mb_y < h->mb.i_mb_height; h->mb.i_mb_y++ )
+    int i_bands = X264_MIN( h->param.i_lookahead_threads, h->mb.i_mb_height );
+    if( i_bands > 1 )
     {
-        int mb_index = h->mb.i_mb_y*h->mb.i_mb_stride;
-        h->mc.mbtree_propagate_cost( buf, propagate_cost,
-            frames[b]->i_intra_cost+mb_index, lowres_costs+mb_index,
-            frames[b]->i_inv_qscale_factor+mb_index, &fps_factor, h->mb.i_mb_width );
-        if( referenced )
-            propagate_cost += h->mb.i_mb_width;
-
-        h->mc.mbtree_propagate_list( h, ref_costs[0], &mvs[0][mb_index], buf, &lowres_costs[mb_index],
-                                     bipred_weights[0], h->mb.i_mb_y, h->mb.i_mb_width, 0 );
-        if( b != p1 )
+        x264_mbtree_band_t bands[X264_LOOKAHEAD_THREAD_MAX];
+        for( int i = 0; i < i_bands; i++ )
         {
-            h->mc.mbtree_propagate_list( h, ref_costs[1], &mvs[1][mb_index], buf, &lowres_costs[mb_index],
-                                         bipred_weights[1], h->mb.i_mb_y, h->mb.i_mb_width, 1 );
+            x264_t *t = h->lookahead_thread[i];
+            int16_t *buf_end = (int16_t*)t->scratch_buffer + ((h->mb.i_mb_width+7)&~7);
+            bands[i] = band;
+            bands[i].h = t;
+            bands[i].i_start_y = h->mb.i_mb_height * i / i_bands;
+            bands[i].i_end_y = h->mb.i_mb_height * (i+1) / i_bands;
+            bands[i].accum[0] = (uint16_t*)buf_end;
+            bands[i].accum[1] = (uint16_t*)buf_end + h->mb.i_mb_count;
+            bands[i].bands = bands;
+            bands[i].i_bands = i_bands;
+            x264_threadpool_run( h->lookaheadpool, (void*)x264_macroblock_tree_propagate_band, &bands[i] );
         }
+        for( int i = 0; i < i_bands; i++ )
+            x264_threadpool_wait( h->lookaheadpool, &bands[i] );
+        for( int i = 0; i < i_bands; i++ )
+            x264_threadpool_run( h->lookaheadpool, (void*)x264_macroblock_tree_merge_band, &bands[i] );
+        for( int i = 0; i < i_bands; i++ )
+            x264_threadpool_wait( h->lookaheadpool, &bands[i] );
     }
+    else
+        x264_macroblock_tree_propagate_rows( &band, band.ref_costs );
 
     if( h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead && referenced )
         x264_macroblock_tree_finish( h, frames[b], average_duration, b == p1 ? b - p0 : 0 );
@@ -1779,6 +1979,30 @@ void x264_slicetype_analyse( x264_t *h, int intra_minigop )
 #endif
 }
 
+/* Some costs are only calculated for --lookahead-save.  The lowres mvs searched
+ * for them would become mv candidates of the encode and change it, so the ones
+ * that weren't searched before are marked unsearched again afterwards. */
+static void x264_lowres_mvs_unsearched( x264_t *h, x264_frame_t **frames, int n, uint64_t *unsearched )
+{
+    for( int f = 0; f < n; f++ )
+    {
+        unsearched[f] = 0;
+        for( int l = 0; l <= !!h->param.i_bframe; l++ )
+            for( int i = 0; i <= h->param.i_bframe; i++ )
+                if( frames[f]->lowres_mvs[l][i][0][0] == 0x7FFF )
+                    unsearched[f] |= 1ULL << (l*(X264_BFRAME_MAX+1) + i);
+    }
+}
+
+static void x264_lowres_mvs_restore( x264_t *h, x264_frame_t **frames, int n, uint64_t *unsearched )
+{
+    for( int f = 0; f < n; f++ )
+        for( int l = 0; l <= !!h->param.i_bframe; l++ )
+            for( int i = 0; i <= h->param.i_bframe; i++ )
+                if( unsearched[f] & (1ULL << (l*(X264_BFRAME_MAX+1) + i)) )
+                    frames[f]->lowres_mvs[l][i][0][0] = 0x7FFF;
+}
+
 void x264_slicetype_decide( x264_t *h )
 {
     x264_frame_t *frames[X264_BFRAME_MAX+2];
@@ -1827,6 +2051,13 @@ void x264_slicetype_decide( x264_t *h )
             h->lookahead->next.list[i]->i_type =
                 x264_ratecontrol_slice_type( h, h->lookahead->next.list[i]->i_frame );
     }
+    else if( h->param.psz_lookahead_load )
+    {
+        /* Use the frame types from the lookahead cache */
+        for( int i = 0; i < h->lookahead->next.i_size; i++ )
+            h->lookahead->next.list[i]->i_type =
+                x264_lookahead_cache_slice_type( h, h->lookahead->next.list[i]->i_frame );
+    }
     else if( (h->param.i_bframe && h->param.i_bframe_adaptive)
              || h->param.i_scenecut_threshold
              || h->param.rc.b_mb_tree
@@ -1933,12 +2164,16 @@ void x264_slicetype_decide( x264_t *h )
     }
 
     /* calculate the frame costs ahead of time for x264_rc_analyse_slice while we still have lowres */
-    if( h->param.rc.i_rc_method != X264_RC_CQP )
+    int b_row_costs = h->param.rc.i_vbv_buffer_size || h->param.psz_lookahead_save;
+    if( !h->param.psz_lookahead_load && (h->param.rc.i_rc_method != X264_RC_CQP || h->param.psz_lookahead_save) )
     {
         x264_mb_analysis_t a;
         int p0, p1, b;
         p1 = b = bframes + 1;
 
+        uint64_t unsearched[X264_BFRAME_MAX+2];
+        int b_save_only = h->param.psz_lookahead_save && h->param.rc.i_rc_method == X264_RC_CQP;
+
         x264_lowres_context_init( h, &a );
 
         frames[0] = h->lookahead->last_nonb;
@@ -1948,10 +2183,17 @@ void x264_slicetype_decide( x264_t *h )
         else // P
             p0 = 0;
 
+        if( b_save_only )
+            x264_lowres_mvs_unsearched( h, frames+1, bframes+1, unsearched );
         x264_slicetype_frame_cost( h, &a, frames, p0, p1, b, 0 );
 
-        if( (p0 != p1 || bframes) && h->param.rc.i_vbv_buffer_size )
+        if( (p0 != p1 || bframes) && b_row_costs )
         {
+            if( !b_save_only && !h->param.rc.i_vbv_buffer_size )
+            {
+                b_save_only = 1;
+                x264_lowres_mvs_unsearched( h, frames+1, bframes+1, unsearched );
+            }
             /* We need the intra costs for row SATDs. */
             x264_slicetype_frame_cost( h, &a, frames, b, b, b, 0 );
 
@@ -1969,10 +2211,12 @@ void x264_slicetype_decide( x264_t *h )
                     p0 = b;
             }
         }
+        if( b_save_only )
+            x264_lowres_mvs_restore( h, frames+1, bframes+1, unsearched );
     }
 
     /* Analyse for weighted P frames */
-    if( !h->param.rc.b_stat_read && h->lookahead->next.list[bframes]->i_type == X264_TYPE_P
+    if( !h->param.rc.b_stat_read && !h->param.psz_lookahead_load && h->lookahead->next.list[bframes]->i_type == X264_TYPE_P
         && h->param.analyse.i_weighted_pred >= X264_WEIGHTP_SIMPLE )
     {
         x264_emms();
@@ -2028,6 +2272,13 @@ int x264_rc_analyse_slice( x264_t *h )
     /* We don't need to assign p0/p1 since we are not performing any real analysis here. */
     x264_frame_t **frames = &h->fenc - b;
 
+    if( h->param.psz_lookahead_load )
+    {
+        h->fenc->i_row_satd = h->fenc->i_row_satds[b-p0][p1-b];
+        h->fdec->i_row_satd = h->fdec->i_row_satds[b-p0][p1-b];
+        return x264_lookahead_cache_costs( h );
+    }
+
     /* cost should have been already calculated by x264_slicetype_decide */
     cost = frames[b]->i_cost_est[b-p0][p1-b];
     assert( cost >= 0 );
@@ -2035,7 +2286,7 @@ int x264_rc_analyse_slice( x264_t *h )
     if( h->param.rc.b_mb_tree && !h->param.rc.b_stat_read )
     {
         cost = x264_slicetype_frame_cost_recalculate( h, frames, p0, p1, b );
-        if( b && h->param.rc.i_vbv_buffer_size )
+        if( b && (h->param.rc.i_vbv_buffer_size || h->param.psz_lookahead_save) )
             x264_slicetype_frame_cost_recalculate( h, frames, b, b, b );
     }
     /* In AQ, use the weighted score instead. */
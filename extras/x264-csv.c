@@ -35,7 +35,8 @@ static const char* summaryCSVHeader =
     "Y PSNR, U PSNR, V PSNR, Global PSNR, SSIM, SSIM (dB), "
     "I count, I ave-QP, I kbps, I-PSNR Y, I-PSNR U, I-PSNR V, I-SSIM (dB), "
     "P count, P ave-QP, P kbps, P-PSNR Y, P-PSNR U, P-PSNR V, P-SSIM (dB), "
-    "B count, B ave-QP, B kbps, B-PSNR Y, B-PSNR U, B-PSNR V, B-SSIM (dB)\n";
+    "B count, B ave-QP, B kbps, B-PSNR Y, B-PSNR U, B-PSNR V, B-SSIM (dB), "
+    "Stall Count, Stall Frames, Stall ms, Min Stall MV Range\n";
 
 FILE * x264_csvlog_open( const x264_param_t* param, const char* filename, int level )
 {
@@ -80,7 +81,17 @@ FILE * x264_csvlog_open( const x264_param_t* param, const char* filename, int le
         " Average Residual Energy,"
         " Average Luma Level,"
         " Maximum Luma Level,"
-        " Minimum Luma Level \n";
+        " Minimum Luma Level,"
+        " Stall Count,"
+        " Stall ms,"
+        " Stall MV Range";
+    static const char* TimeHeader =
+        ", Lookahead ms,"
+        " Analyse ms,"
+        " Encode ms,"
+        " Entropy ms,"
+        " Filter ms,"
+        " Wait ms";
 
     FILE *csvfh = NULL;
     csvfh = x264_fopen( filename, "r" );
@@ -106,6 +117,9 @@ FILE * x264_csvlog_open( const x264_param_t* param, const char* filename, int le
                 if ( param->analyse.b_ssim )
                     fprintf( csvfh, "%s", SSIMHeader );
                 fprintf( csvfh, "%s", MBHeader );
+                if( level >= 2 )
+                    fprintf( csvfh, "%s", TimeHeader );
+                fputs( " \n", csvfh );
             }
             else
                 fputs( summaryCSVHeader, csvfh );
@@ -162,6 +176,19 @@ void x264_csvlog_frame( FILE* csvfh, const x264_param_t* param, const x264_pictu
                  pic->frameData.f_avg_luma_level,
                  pic->frameData.i_max_luma_level,
                  pic->frameData.i_min_luma_level );
+        fprintf( csvfh, ", %d, %.3f, ", pic->frameData.i_stall_count, pic->frameData.f_stall_time );
+        if( pic->frameData.i_stall_count )
+            fprintf( csvfh, "%d", pic->frameData.i_stall_mvy_range );
+        else
+            fputc( '-', csvfh );
+        if( level >= 2 )
+            fprintf( csvfh, ", %.3f, %.3f, %.3f, %.3f, %.3f, %.3f",
+                     pic->frameData.f_lookahead_time,
+                     pic->frameData.f_analyse_time,
+                     pic->frameData.f_encode_time,
+                     pic->frameData.f_entropy_time,
+                     pic->frameData.f_filter_time,
+                     pic->frameData.f_wait_time );
 
         fputs( "\n", csvfh );
     }
@@ -226,5 +253,10 @@ void x264_csvlog_encode( FILE* csvfh, const x264_param_t* param, const x264_stat
         else
             fprintf( csvfh, " -, -, -, -, -, -, -," );
     }
+    fprintf( csvfh, " %"PRId64", %d, %.3f,", stats->i_stall_count, stats->i_stall_frames, stats->f_stall_time );
+    if( stats->i_stall_frames )
+        fprintf( csvfh, " %d", stats->i_stall_mvy_range );
+    else
+        fprintf( csvfh, " -" );
     fputs( "\n", csvfh );
 }
@@ -27,9 +27,42 @@
 #define NAME "depth"
 #define FAIL_IF_ERROR( cond, ... ) FAIL_IF_ERR( cond, NAME, __VA_ARGS__ )
 
+/* Upconversion has no dependency between rows, so planes are scaled in bands of
+ * this many rows, which are spread over the threads. */
+#define BAND_HEIGHT 64
+/* Dithering carries the error of each row to the next one, so the threads work
+ * on consecutive rows as a wavefront: each row trails the one above it, which
+ * publishes its progress every DITHER_CHUNK pixels.  The output is the same as
+ * when dithering serially, whatever the number of threads. */
+#define DITHER_CHUNK 256
+#define MAX_THREADS 16
+/* planes times interleaved components, at most 4 in any supported csp */
+#define MAX_DITHER_PLANES 4
+
 cli_vid_filter_t depth_filter;
 
+typedef struct depth_hnd_t depth_hnd_t;
+
+typedef struct
+{
+    depth_hnd_t *h;
+    int index;
+    cli_image_t *out;
+    cli_image_t *img;
+} depth_job_t;
+
 typedef struct
+{
+    int plane;
+    int pitch;
+    int offset;
+    int width;
+    int height;
+    int16_t *errors;
+    int *row_done; /* pixels of each row that have been dithered */
+} dither_plane_t;
+
+struct depth_hnd_t
 {
     hnd_t prev_hnd;
     cli_vid_filter_t prev_filter;
@@ -37,8 +70,18 @@ typedef struct
     int bit_depth;
     int dst_csp;
     cli_pic_t buffer;
-    int16_t *error_buf;
-} depth_hnd_t;
+    int dither;
+    void (*plane_copy_lshift)( uint16_t *dst, intptr_t i_dst, uint8_t *src, intptr_t i_src, int w, int h, int shift );
+    int threads;
+    x264_threadpool_t *pool;
+    depth_job_t job[MAX_THREADS];
+
+    int num_dither_planes;
+    dither_plane_t dither_plane[MAX_DITHER_PLANES];
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t cv_progress;
+    int i_waiting;
+};
 
 static int depth_filter_csp_is_supported( int csp )
 {
@@ -69,91 +112,137 @@ static int csp_num_interleaved( int csp, int plane )
 /* The dithering algorithm is based on Sierra-2-4A error diffusion. It has been
  * written in such a way so that if the source has been upconverted using the
  * same algorithm as used in scale_image, dithering down to the source bit
- * depth again is lossless. */
-#define DITHER_PLANE( pitch ) \
-static void dither_plane_##pitch( pixel *dst, int dst_stride, uint16_t *src, int src_stride, \
-                                  int width, int height, int16_t *errors ) \
+ * depth again is lossless.  Dithers pixels x to end of a row; err carries the
+ * error along the row and errors holds that of the row above. */
+#define DITHER_ROW( pitch ) \
+static void dither_row_##pitch( pixel *dst, uint16_t *src, int x, int end, int16_t *errors, int *p_err ) \
 { \
     const int lshift = 16-X264_BIT_DEPTH; \
     const int rshift = 16-X264_BIT_DEPTH+2; \
     const int half = 1 << (16-X264_BIT_DEPTH+1); \
     const int pixel_max = (1 << X264_BIT_DEPTH)-1; \
-    memset( errors, 0, (width+1) * sizeof(int16_t) ); \
-    for( int y = 0; y < height; y++, src += src_stride, dst += dst_stride ) \
+    int err = *p_err; \
+    for( ; x < end; x++ ) \
     { \
-        int err = 0; \
-        for( int x = 0; x < width; x++ ) \
-        { \
-            err = err*2 + errors[x] + errors[x+1]; \
-            dst[x*pitch] = x264_clip3( ((src[x*pitch]<<2)+err+half) >> rshift, 0, pixel_max ); \
-            errors[x] = err = src[x*pitch] - (dst[x*pitch] << lshift); \
-        } \
+        err = err*2 + errors[x] + errors[x+1]; \
+        dst[x*pitch] = x264_clip3( ((src[x*pitch]<<2)+err+half) >> rshift, 0, pixel_max ); \
+        errors[x] = err = src[x*pitch] - (dst[x*pitch] << lshift); \
     } \
+    *p_err = err; \
 }
 
-DITHER_PLANE( 1 )
-DITHER_PLANE( 2 )
-DITHER_PLANE( 3 )
-DITHER_PLANE( 4 )
+DITHER_ROW( 1 )
+DITHER_ROW( 2 )
+DITHER_ROW( 3 )
+DITHER_ROW( 4 )
 
-static void dither_image( cli_image_t *out, cli_image_t *img, int16_t *error_buf )
+static void (* const dither_row[4])( pixel *dst, uint16_t *src, int x, int end, int16_t *errors, int *p_err ) =
 {
-    int csp_mask = img->csp & X264_CSP_MASK;
-    for( int i = 0; i < img->planes; i++ )
-    {
-        int num_interleaved = csp_num_interleaved( img->csp, i );
-        int height = x264_cli_csps[csp_mask].height[i] * img->height;
-        int width = x264_cli_csps[csp_mask].width[i] * img->width / num_interleaved;
+    dither_row_1, dither_row_2, dither_row_3, dither_row_4
+};
 
-#define CALL_DITHER_PLANE( pitch, off ) \
-        dither_plane_##pitch( ((pixel*)out->plane[i])+off, out->stride[i]/sizeof(pixel), \
-                ((uint16_t*)img->plane[i])+off, img->stride[i]/2, width, height, error_buf )
+/* Waits until the row above has dithered the errors the next chunk reads. */
+static void dither_wait( depth_hnd_t *h, int *row_done, int needed )
+{
+    if( x264_atomic_fetch_add( row_done, 0 ) >= needed )
+        return;
+    x264_pthread_mutex_lock( &h->mutex );
+    x264_atomic_fetch_add( &h->i_waiting, 1 );
+    while( x264_atomic_fetch_add( row_done, 0 ) < needed )
+        x264_pthread_cond_wait( &h->cv_progress, &h->mutex );
+    x264_atomic_fetch_add( &h->i_waiting, -1 );
+    x264_pthread_mutex_unlock( &h->mutex );
+}
 
-        if( num_interleaved == 4 )
-        {
-            CALL_DITHER_PLANE( 4, 0 );
-            CALL_DITHER_PLANE( 4, 1 );
-            CALL_DITHER_PLANE( 4, 2 );
-            CALL_DITHER_PLANE( 4, 3 ); //we probably can skip this one
-        }
-        else if( num_interleaved == 3 )
-        {
-            CALL_DITHER_PLANE( 3, 0 );
-            CALL_DITHER_PLANE( 3, 1 );
-            CALL_DITHER_PLANE( 3, 2 );
-        }
-        else if( num_interleaved == 2 )
-        {
-            CALL_DITHER_PLANE( 2, 0 );
-            CALL_DITHER_PLANE( 2, 1 );
-        }
-        else //if( num_interleaved == 1 )
+static void dither_signal( depth_hnd_t *h, int *row_done, int done )
+{
+    x264_atomic_fetch_add( row_done, done );
+    if( x264_atomic_fetch_add( &h->i_waiting, 0 ) )
+    {
+        x264_pthread_mutex_lock( &h->mutex );
+        x264_pthread_cond_broadcast( &h->cv_progress );
+        x264_pthread_mutex_unlock( &h->mutex );
+    }
+}
+
+/* Dithers every row of the plane whose index is congruent to the job index. */
+static void dither_plane( depth_job_t *job, dither_plane_t *p )
+{
+    depth_hnd_t *h = job->h;
+    cli_image_t *out = job->out;
+    cli_image_t *img = job->img;
+    for( int y = job->index; y < p->height; y += h->threads )
+    {
+        pixel *dst = ((pixel*)(out->plane[p->plane] + y*out->stride[p->plane])) + p->offset;
+        uint16_t *src = ((uint16_t*)(img->plane[p->plane] + y*img->stride[p->plane])) + p->offset;
+        int err = 0;
+        for( int x = 0; x < p->width; x += DITHER_CHUNK )
         {
-            CALL_DITHER_PLANE( 1, 0 );
+            int end = X264_MIN( x + DITHER_CHUNK, p->width );
+            /* errors[end] is only written by the row above once it has dithered pixel end */
+            if( y )
+                dither_wait( h, &p->row_done[y-1], X264_MIN( end + 1, p->width ) );
+            dither_row[p->pitch-1]( dst, src, x, end, p->errors, &err );
+            dither_signal( h, &p->row_done[y], end - x );
         }
     }
 }
 
-static void scale_image( cli_image_t *output, cli_image_t *img )
+static void scale_band( depth_hnd_t *h, cli_image_t *output, cli_image_t *img, int i, int y, int height )
+{
+    int csp_mask = img->csp & X264_CSP_MASK;
+    uint8_t *src = img->plane[i] + y*img->stride[i];
+    uint16_t *dst = (uint16_t*)(output->plane[i] + y*output->stride[i]);
+    int width = x264_cli_csps[csp_mask].width[i] * img->width;
+
+    h->plane_copy_lshift( dst, output->stride[i]/2, src, img->stride[i], width, height, X264_BIT_DEPTH - 8 );
+}
+
+static void *convert_rows( depth_job_t *job )
 {
+    depth_hnd_t *h = job->h;
+    cli_image_t *img = job->img;
     int csp_mask = img->csp & X264_CSP_MASK;
-    const int shift = X264_BIT_DEPTH - 8;
+    if( h->dither )
+    {
+        for( int i = 0; i < h->num_dither_planes; i++ )
+            dither_plane( job, &h->dither_plane[i] );
+        return NULL;
+    }
+    /* every band whose index is congruent to the job index */
+    int band = 0;
     for( int i = 0; i < img->planes; i++ )
     {
-        uint8_t *src = img->plane[i];
-        uint16_t *dst = (uint16_t*)output->plane[i];
         int height = x264_cli_csps[csp_mask].height[i] * img->height;
-        int width = x264_cli_csps[csp_mask].width[i] * img->width;
-
-        for( int j = 0; j < height; j++ )
-        {
-            for( int k = 0; k < width; k++ )
-                dst[k] = src[k] << shift;
+        for( int y = 0; y < height; y += BAND_HEIGHT, band++ )
+            if( band % h->threads == job->index )
+                scale_band( h, job->out, img, i, y, X264_MIN( BAND_HEIGHT, height - y ) );
+    }
+    return NULL;
+}
 
-            src += img->stride[i];
-            dst += output->stride[i]/2;
-        }
+static void convert_image( depth_hnd_t *h, cli_image_t *out, cli_image_t *img )
+{
+    for( int i = 0; h->dither && i < h->num_dither_planes; i++ )
+    {
+        dither_plane_t *p = &h->dither_plane[i];
+        memset( p->errors, 0, (p->width+1) * sizeof(int16_t) );
+        memset( p->row_done, 0, p->height * sizeof(int) );
+    }
+    for( int i = 0; i < h->threads; i++ )
+    {
+        h->job[i].out = out;
+        h->job[i].img = img;
+    }
+    if( h->pool )
+    {
+        for( int i = 0; i < h->threads; i++ )
+            x264_threadpool_run( h->pool, (void*)convert_rows, &h->job[i] );
+        for( int i = 0; i < h->threads; i++ )
+            x264_threadpool_wait( h->pool, &h->job[i] );
     }
+    else
+        convert_rows( &h->job[0] );
 }
 
 static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
@@ -163,14 +252,10 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
     if( h->prev_filter.get_frame( h->prev_hnd, output, frame ) )
         return -1;
 
-    if( h->bit_depth < 16 && output->img.csp & X264_CSP_HIGH_DEPTH )
+    h->dither = h->bit_depth < 16 && output->img.csp & X264_CSP_HIGH_DEPTH;
+    if( h->dither || (h->bit_depth > 8 && !(output->img.csp & X264_CSP_HIGH_DEPTH)) )
     {
-        dither_image( &h->buffer.img, &output->img, h->error_buf );
-        output->img = h->buffer.img;
-    }
-    else if( h->bit_depth > 8 && !(output->img.csp & X264_CSP_HIGH_DEPTH) )
-    {
-        scale_image( &h->buffer.img, &output->img );
+        convert_image( h, &h->buffer.img, &output->img );
         output->img = h->buffer.img;
     }
     return 0;
@@ -186,6 +271,10 @@ static void free_filter( hnd_t handle )
 {
     depth_hnd_t *h = handle;
     h->prev_filter.free( h->prev_hnd );
+    if( h->pool )
+        x264_threadpool_delete( h->pool );
+    x264_pthread_mutex_destroy( &h->mutex );
+    x264_pthread_cond_destroy( &h->cv_progress );
     x264_cli_pic_clean( &h->buffer );
     x264_free( h );
 }
@@ -197,16 +286,18 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info,
     int change_fmt = (info->csp ^ param->i_csp) & X264_CSP_HIGH_DEPTH;
     int csp = ~(~info->csp ^ change_fmt);
     int bit_depth = 8*x264_cli_csp_depth_factor( csp );
+    int threads = param->i_threads == X264_THREADS_AUTO ? x264_cpu_num_processors() : param->i_threads;
 
     if( opt_string )
     {
-        static const char *optlist[] = { "bit_depth", NULL };
+        static const char *optlist[] = { "bit_depth", "threads", NULL };
         char **opts = x264_split_options( opt_string, optlist );
 
         if( opts )
         {
             char *str_bit_depth = x264_get_option( "bit_depth", opts );
             bit_depth = x264_otoi( str_bit_depth, -1 );
+            threads = x264_otoi( x264_get_option( "threads", opts ), threads );
 
             ret = bit_depth < 8 || bit_depth > 16;
             csp = bit_depth > 8 ? csp | X264_CSP_HIGH_DEPTH : csp & ~X264_CSP_HIGH_DEPTH;
@@ -224,12 +315,66 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info,
     if( change_fmt || bit_depth != 8 * x264_cli_csp_depth_factor( csp ) )
     {
         FAIL_IF_ERROR( !depth_filter_csp_is_supported(csp), "unsupported colorspace.\n" )
-        depth_hnd_t *h = x264_malloc( sizeof(depth_hnd_t) + (info->width+1)*sizeof(int16_t) );
+        /* there is no point in more threads than bands in the luma plane */
+        threads = x264_clip3( threads, 1, X264_MIN( MAX_THREADS, (info->height + BAND_HEIGHT - 1) / BAND_HEIGHT ) );
+        /* each plane and interleaved component is dithered with its own error row */
+        int csp_mask = csp & X264_CSP_MASK;
+        int num_dither_planes = 0;
+        int dither_size = 0;
+        for( int i = 0; i < x264_cli_csps[csp_mask].planes; i++ )
+        {
+            int num_interleaved = csp_num_interleaved( csp, i );
+            int width = x264_cli_csps[csp_mask].width[i] * info->width / num_interleaved;
+            int height = x264_cli_csps[csp_mask].height[i] * info->height;
+            num_dither_planes += num_interleaved;
+            dither_size += num_interleaved * (ALIGN( (width+1)*sizeof(int16_t), NATIVE_ALIGN ) + ALIGN( height*sizeof(int), NATIVE_ALIGN ));
+        }
+        depth_hnd_t *h = x264_malloc( sizeof(depth_hnd_t) + dither_size );
 
         if( !h )
             return -1;
 
-        h->error_buf = (int16_t*)(h + 1);
+        x264_mc_functions_t mc;
+        x264_mc_init( param->cpu, &mc, 0 );
+        h->plane_copy_lshift = mc.plane_copy_lshift;
+        h->threads = threads;
+        h->pool = NULL;
+        h->i_waiting = 0;
+        h->num_dither_planes = num_dither_planes;
+        uint8_t *buf = (uint8_t*)(h + 1);
+        for( int i = 0, n = 0; i < x264_cli_csps[csp_mask].planes; i++ )
+        {
+            int num_interleaved = csp_num_interleaved( csp, i );
+            for( int j = 0; j < num_interleaved; j++, n++ )
+            {
+                dither_plane_t *p = &h->dither_plane[n];
+                p->plane = i;
+                p->pitch = num_interleaved;
+                p->offset = j;
+                p->width = x264_cli_csps[csp_mask].width[i] * info->width / num_interleaved;
+                p->height = x264_cli_csps[csp_mask].height[i] * info->height;
+                p->errors = (int16_t*)buf;
+                buf += ALIGN( (p->width+1)*sizeof(int16_t), NATIVE_ALIGN );
+                p->row_done = (int*)buf;
+                buf += ALIGN( p->height*sizeof(int), NATIVE_ALIGN );
+            }
+        }
+        for( int i = 0; i < threads; i++ )
+        {
+            h->job[i].h = h;
+            h->job[i].index = i;
+        }
+        if( x264_pthread_mutex_init( &h->mutex, NULL ) || x264_pthread_cond_init( &h->cv_progress, NULL ) )
+        {
+            x264_free( h );
+            return -1;
+        }
+        /* fall back to converting in the calling thread if no pool can be had */
+        if( threads > 1 && x264_threadpool_init( &h->pool, threads, NULL, NULL ) )
+        {
+            h->pool = NULL;
+            h->threads = 1;
+        }
         h->dst_csp = csp;
         h->bit_depth = bit_depth;
         h->prev_hnd = *handle;
@@ -237,6 +382,8 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info,
 
         if( x264_cli_pic_alloc( &h->buffer, h->dst_csp, info->width, info->height ) )
         {
+            if( h->pool )
+                x264_threadpool_delete( h->pool );
             x264_free( h );
             return -1;
         }
@@ -0,0 +1,290 @@
+/*****************************************************************************
+ * pipe.c: threaded filter stage
+ *****************************************************************************
+ * Copyright (C) 2010-2015 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "video.h"
+#include "internal.h"
+#define NAME "pipe"
+
+#define MAX_QUEUE 16
+
+/* Runs the filters before it on a thread of their own, which fills a bounded
+ * queue of frames ahead of the filter after it.  Stages separated by pipes
+ * therefore run concurrently with each other and with the encoder.
+ * Frames are copied out of the previous filter, as filters generally reuse
+ * their output buffer on the next get_frame.  The next filter may hold at most
+ * one frame at a time, i.e. it must release a frame before getting the next.
+ * When the next filter skips frames, e.g. select_every, and waits on a frame
+ * beyond the one being filtered, the job jumps straight to it rather than
+ * filtering the frames in between. */
+
+typedef struct
+{
+    cli_pic_t pic;
+    int frame;
+    int status;
+} pipe_frame_t;
+
+typedef struct
+{
+    hnd_t prev_hnd;
+    cli_vid_filter_t prev_filter;
+
+    x264_threadpool_t *pool;
+    int frame_total;
+
+    /* Frames filtered ahead of the next filter, oldest first.  The oldest frame
+     * stays queued while the next filter holds it. */
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t cv_fill;   /* signaled when a frame has been filtered or the job stopped */
+    x264_pthread_cond_t cv_empty;  /* signaled when a slot has been freed or the job should stop */
+    pipe_frame_t *frames;
+    int depth;
+    int i_head;
+    int i_size;
+    int next_frame; /* next frame the job will filter */
+    int skip_to;    /* frame the next filter waits on, the job skips any before it */
+    int b_running;  /* the job is still filtering */
+    int b_job;      /* the job has been started and not waited for */
+    int b_stop;
+
+    /* stats */
+    int     i_frames;
+    int     i_full;       /* times the job blocked on a full queue */
+    int     i_waits;      /* times the next filter blocked on an empty queue */
+    int     i_skipped;    /* frames the job skipped */
+    int64_t i_wait_time;
+} pipe_hnd_t;
+
+cli_vid_filter_t pipe_filter;
+
+static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
+{
+    intptr_t size = (intptr_t)opt_string;
+    /* upon a <= 0 queue request, do nothing */
+    if( size <= 0 )
+        return 0;
+    pipe_hnd_t *h = calloc( 1, sizeof(pipe_hnd_t) );
+    if( !h )
+        return -1;
+
+    h->depth = X264_MIN( size, MAX_QUEUE );
+    h->frames = calloc( h->depth, sizeof(pipe_frame_t) );
+    if( !h->frames )
+        goto fail;
+    for( int i = 0; i < h->depth; i++ )
+        if( x264_cli_pic_alloc( &h->frames[i].pic, info->csp, info->width, info->height ) )
+            goto fail;
+    h->frame_total = info->num_frames;
+
+    if( x264_pthread_mutex_init( &h->mutex, NULL ) )
+        goto fail;
+    if( x264_pthread_cond_init( &h->cv_fill, NULL ) )
+        goto fail_mutex;
+    if( x264_pthread_cond_init( &h->cv_empty, NULL ) )
+        goto fail_cv_fill;
+    if( x264_threadpool_init( &h->pool, 1, NULL, NULL ) )
+        goto fail_cv_empty;
+
+    h->prev_filter = *filter;
+    h->prev_hnd = *handle;
+    *handle = h;
+    *filter = pipe_filter;
+
+    return 0;
+
+fail_cv_empty:
+    x264_pthread_cond_destroy( &h->cv_empty );
+fail_cv_fill:
+    x264_pthread_cond_destroy( &h->cv_fill );
+fail_mutex:
+    x264_pthread_mutex_destroy( &h->mutex );
+fail:
+    if( h->frames )
+        for( int i = 0; i < h->depth; i++ )
+            x264_cli_pic_clean( &h->frames[i].pic );
+    free( h->frames );
+    free( h );
+    return -1;
+}
+
+/* Runs on the stage's thread: filters frames in order until the queue is full,
+ * then waits for a slot to be freed.  Stops at the end of the clip, on the
+ * first failed frame, or when asked to. */
+static void *filter_frames( pipe_hnd_t *h )
+{
+    x264_pthread_mutex_lock( &h->mutex );
+    while( !h->b_stop && (!h->frame_total || h->next_frame < h->frame_total) )
+    {
+        if( h->i_size == h->depth )
+        {
+            h->i_full++;
+            while( h->i_size == h->depth && !h->b_stop )
+                x264_pthread_cond_wait( &h->cv_empty, &h->mutex );
+            continue;
+        }
+        if( h->next_frame < h->skip_to )
+        {
+            h->i_skipped += h->skip_to - h->next_frame;
+            h->next_frame = h->skip_to;
+            if( h->frame_total && h->next_frame >= h->frame_total )
+                break;
+        }
+        pipe_frame_t *frame = &h->frames[(h->i_head + h->i_size) % h->depth];
+        frame->frame = h->next_frame;
+        x264_pthread_mutex_unlock( &h->mutex );
+
+        cli_pic_t temp;
+        frame->status = h->prev_filter.get_frame( h->prev_hnd, &temp, frame->frame );
+        if( !frame->status )
+        {
+            frame->status = x264_cli_pic_copy( &frame->pic, &temp );
+            if( h->prev_filter.release_frame( h->prev_hnd, &temp, frame->frame ) )
+                frame->status = -1;
+        }
+
+        x264_pthread_mutex_lock( &h->mutex );
+        h->i_size++;
+        h->next_frame++;
+        x264_pthread_cond_broadcast( &h->cv_fill );
+        if( frame->status )
+            break;
+    }
+    h->b_running = 0;
+    x264_pthread_cond_broadcast( &h->cv_fill );
+    x264_pthread_mutex_unlock( &h->mutex );
+    return NULL;
+}
+
+/* Must be called with the mutex held. */
+static void stop_filtering( pipe_hnd_t *h )
+{
+    if( h->b_job )
+    {
+        h->b_stop = 1;
+        x264_pthread_cond_broadcast( &h->cv_empty );
+        x264_pthread_mutex_unlock( &h->mutex );
+        x264_threadpool_wait( h->pool, h );
+        x264_pthread_mutex_lock( &h->mutex );
+        h->b_stop = 0;
+        h->b_job = 0;
+    }
+}
+
+/* Must be called with the mutex held. */
+static void drop_frame( pipe_hnd_t *h )
+{
+    h->i_head = (h->i_head + 1) % h->depth;
+    h->i_size--;
+    x264_pthread_cond_signal( &h->cv_empty );
+}
+
+static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
+{
+    pipe_hnd_t *h = handle;
+    int ret = -1;
+    int b_started = 0;
+
+    x264_pthread_mutex_lock( &h->mutex );
+    while( 1 )
+    {
+        /* skip frames that were filtered ahead but not asked for */
+        while( h->i_size && h->frames[h->i_head].frame < frame )
+            drop_frame( h );
+
+        if( h->i_size && h->frames[h->i_head].frame == frame )
+        {
+            pipe_frame_t *head = &h->frames[h->i_head];
+            ret = head->status;
+            if( ret )
+                drop_frame( h );
+            else
+            {
+                *output = head->pic;
+                h->i_frames++;
+            }
+            break;
+        }
+
+        if( !h->i_size && h->b_running && h->next_frame <= frame )
+        {
+            int64_t start = x264_mdate();
+            h->i_waits++;
+            h->skip_to = frame;
+            while( !h->i_size && h->b_running )
+                x264_pthread_cond_wait( &h->cv_fill, &h->mutex );
+            h->i_wait_time += x264_mdate() - start;
+            continue;
+        }
+
+        /* the frame is not coming (first frame, seek or end of the clip) */
+        if( b_started )
+            break;
+        stop_filtering( h );
+        while( h->i_size )
+            drop_frame( h );
+        h->next_frame = frame;
+        h->skip_to = frame;
+        h->b_running = 1;
+        h->b_job = 1;
+        b_started = 1;
+        x264_threadpool_run( h->pool, (void*)filter_frames, h );
+    }
+    x264_pthread_mutex_unlock( &h->mutex );
+
+    return ret;
+}
+
+static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
+{
+    pipe_hnd_t *h = handle;
+    x264_pthread_mutex_lock( &h->mutex );
+    if( h->i_size && h->frames[h->i_head].frame == frame )
+        drop_frame( h );
+    x264_pthread_mutex_unlock( &h->mutex );
+    return 0;
+}
+
+static void free_filter( hnd_t handle )
+{
+    pipe_hnd_t *h = handle;
+    x264_pthread_mutex_lock( &h->mutex );
+    stop_filtering( h );
+    x264_pthread_mutex_unlock( &h->mutex );
+    x264_threadpool_delete( h->pool );
+
+    if( h->i_frames )
+        x264_cli_log( NAME, h->i_waits > 1 ? X264_LOG_INFO : X264_LOG_DEBUG,
+                      "%s stage: queue %d, next stage waited %d times (%.1f ms), queue full %d times, %d frames skipped\n",
+                      h->prev_filter.name, h->depth, h->i_waits, h->i_wait_time / 1000.0, h->i_full, h->i_skipped );
+
+    h->prev_filter.free( h->prev_hnd );
+    for( int i = 0; i < h->depth; i++ )
+        x264_cli_pic_clean( &h->frames[i].pic );
+    x264_pthread_mutex_destroy( &h->mutex );
+    x264_pthread_cond_destroy( &h->cv_fill );
+    x264_pthread_cond_destroy( &h->cv_empty );
+    free( h->frames );
+    free( h );
+}
+
+cli_vid_filter_t pipe_filter = { NAME, NULL, init, get_frame, release_frame, free_filter, NULL };
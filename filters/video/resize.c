@@ -49,6 +49,8 @@ static int full_check( video_info_t *info, x264_param_t *param )
 #define AV_PIX_FMT_BGRA64 AV_PIX_FMT_NONE
 #endif
 
+#endif
+
 typedef struct
 {
     int width;
@@ -57,6 +59,323 @@ typedef struct
     int range;
 } frame_prop_t;
 
+/* Native separable scaler for builds without swscale, on the scale_h/scale_v
+ * kernels of common/mc.  Each plane is filtered horizontally into rows of
+ * 16-bit intermediates, which are then filtered vertically.  The filter taps
+ * are precomputed per output sample and row, with 14-bit coefficients that sum
+ * to one, and padded with zeros to the tap counts the SIMD kernels handle.
+ * Output rows are converted in bands spread over a thread pool; each job
+ * caches the horizontally filtered rows of its current window. */
+
+#define SCALE_COEF_BITS 14
+#define SCALE_BAND_HEIGHT 32
+#define SCALE_MAX_THREADS 16
+
+enum
+{
+    SCALE_POINT,
+    SCALE_AREA,
+    SCALE_BILINEAR,
+    SCALE_BICUBIC,
+    SCALE_LANCZOS
+};
+
+typedef struct
+{
+    int taps;
+    int *pos;       /* first source sample of each output sample */
+    int16_t *coef;  /* taps coefficients of each output sample */
+} scale_filter_t;
+
+/* tap counts that take the fast paths of the kernels */
+#define SCALE_ALIGN_H 8
+#define SCALE_ALIGN_V 2
+
+typedef struct native_scaler_t native_scaler_t;
+
+typedef struct
+{
+    native_scaler_t *s;
+    int index;
+    int16_t *rows;    /* window of horizontally filtered source rows */
+    int16_t **row_ptr;
+    int *row_src;     /* source row held by each row of the window */
+    cli_image_t *out;
+    cli_image_t *in;
+} scale_job_t;
+
+struct native_scaler_t
+{
+    int high_depth;
+    int planes;
+    int pitch[4];
+    int dst_width[4];   /* in samples of one component */
+    int dst_height[4];
+    scale_filter_t hfilter[4];
+    scale_filter_t vfilter[4];
+    void (*scale_h_8) ( int16_t *dst, uint8_t *src, int16_t *coef, int *pos, int taps, int width );
+    void (*scale_h_16)( int16_t *dst, uint16_t *src, int16_t *coef, int *pos, int taps, int width );
+    void (*scale_v_8) ( uint8_t *dst, int16_t **rows, int16_t *coef, int taps, int width );
+    void (*scale_v_16)( uint16_t *dst, int16_t **rows, int16_t *coef, int taps, int width );
+    int threads;
+    x264_threadpool_t *pool;
+    scale_job_t job[SCALE_MAX_THREADS];
+};
+
+static int native_method( const char *name )
+{
+    if( !strcasecmp( name, "point" ) )
+        return SCALE_POINT;
+    else if( !strcasecmp( name, "area" ) )
+        return SCALE_AREA;
+    else if( !strcasecmp( name, "fastbilinear" ) || !strcasecmp( name, "bilinear" ) )
+        return SCALE_BILINEAR;
+    else if( !strcasecmp( name, "lanczos" ) )
+        return SCALE_LANCZOS;
+    else if( !*name || !strcasecmp( name, "bicubic" ) ) // default
+        return SCALE_BICUBIC;
+    return -1;
+}
+
+static double native_kernel( int method, double x )
+{
+    x = fabs( x );
+    switch( method )
+    {
+        case SCALE_AREA:
+            return x < 0.5 ? 1 : x == 0.5 ? 0.5 : 0;
+        case SCALE_BILINEAR:
+            return x < 1 ? 1 - x : 0;
+        case SCALE_BICUBIC: /* Catmull-Rom */
+            if( x < 1 )
+                return (1.5*x - 2.5)*x*x + 1;
+            if( x < 2 )
+                return ((-0.5*x + 2.5)*x - 4)*x + 2;
+            return 0;
+        case SCALE_LANCZOS: /* 3 lobes */
+            if( x < 1e-8 )
+                return 1;
+            if( x < 3 )
+                return 3 * sin( M_PI*x ) * sin( M_PI*x/3 ) / (M_PI*M_PI*x*x);
+            return 0;
+        default:
+            return x < 0.5;
+    }
+}
+
+/* The filter of each output pixel is spread over the pitch interleaved samples
+ * of its components, and its taps rounded up to a multiple of align. */
+static int native_filter_init( scale_filter_t *f, int method, int src_size, int dst_size, int pitch, int align )
+{
+    static const double radius[] = { 0.5, 0.5, 1, 2, 3 };
+    double ratio = (double)src_size / dst_size;
+    /* widen the kernel when downscaling so that every source sample contributes */
+    double scale = method == SCALE_POINT ? 1 : X264_MAX( ratio, 1.0 );
+    double support = radius[method] * scale;
+    int window = method == SCALE_POINT ? 1 : ceil( 2*support );
+    int taps = X264_MIN( window, src_size );
+    f->taps = X264_MIN( ALIGN( (taps-1)*pitch + 1, align ), src_size*pitch );
+    f->pos = malloc( dst_size * pitch * sizeof(int) );
+    f->coef = calloc( dst_size * pitch * f->taps, sizeof(int16_t) );
+    double *weight = malloc( (window + taps) * sizeof(double) );
+    int16_t *coef = malloc( taps * sizeof(int16_t) );
+    if( !f->pos || !f->coef || !weight || !coef )
+    {
+        free( weight );
+        free( coef );
+        return -1;
+    }
+    double *folded = weight + window;
+
+    for( int i = 0; i < dst_size; i++ )
+    {
+        double center = (i + 0.5) * ratio - 0.5;
+        int start = method == SCALE_POINT ? floor( center + 0.5 ) : floor( center - support ) + 1;
+        double sum = 0;
+        for( int t = 0; t < window; t++ )
+        {
+            weight[t] = method == SCALE_POINT ? 1 : native_kernel( method, (start + t - center) / scale );
+            sum += weight[t];
+        }
+        /* samples beyond the edges are replaced by the edge samples */
+        int pos = x264_clip3( start, 0, src_size - taps );
+        memset( folded, 0, taps * sizeof(double) );
+        for( int t = 0; t < window; t++ )
+            folded[x264_clip3( start + t, 0, src_size - 1 ) - pos] += weight[t] / sum;
+
+        int total = 0, peak = 0;
+        for( int t = 0; t < taps; t++ )
+        {
+            coef[t] = lrint( folded[t] * (1 << SCALE_COEF_BITS) );
+            total += coef[t];
+            if( coef[t] > coef[peak] )
+                peak = t;
+        }
+        /* put the rounding error on the largest tap so that flat areas stay flat */
+        coef[peak] += (1 << SCALE_COEF_BITS) - total;
+
+        /* the padded filters of the last samples are moved back inside the row */
+        for( int c = 0; c < pitch; c++ )
+        {
+            int j = i*pitch + c;
+            int first = pos*pitch + c;
+            f->pos[j] = X264_MIN( first, src_size*pitch - f->taps );
+            for( int t = 0; t < taps; t++ )
+                f->coef[j*f->taps + first - f->pos[j] + t*pitch] = coef[t];
+        }
+    }
+    free( weight );
+    free( coef );
+    return 0;
+}
+
+static void native_scale_band( scale_job_t *job, int i, int y0, int height )
+{
+    native_scaler_t *s = job->s;
+    scale_filter_t *hf = &s->hfilter[i];
+    scale_filter_t *vf = &s->vfilter[i];
+    int width = s->dst_width[i] * s->pitch[i];
+    int16_t **rows = job->row_ptr;
+
+    for( int y = y0; y < y0 + height; y++ )
+    {
+        /* the window only slides down, so each source row maps to a fixed row of it */
+        for( int t = 0; t < vf->taps; t++ )
+        {
+            int src_y = vf->pos[y] + t;
+            int slot = src_y % vf->taps;
+            rows[t] = job->rows + slot * width;
+            if( job->row_src[slot] == src_y )
+                continue;
+            uint8_t *src = job->in->plane[i] + src_y * job->in->stride[i];
+            if( s->high_depth )
+                s->scale_h_16( rows[t], (uint16_t*)src, hf->coef, hf->pos, hf->taps, width );
+            else
+                s->scale_h_8( rows[t], src, hf->coef, hf->pos, hf->taps, width );
+            job->row_src[slot] = src_y;
+        }
+        uint8_t *dst = job->out->plane[i] + y * job->out->stride[i];
+        int16_t *coef = vf->coef + y * vf->taps;
+        if( s->high_depth )
+            s->scale_v_16( (uint16_t*)dst, rows, coef, vf->taps, width );
+        else
+            s->scale_v_8( dst, rows, coef, vf->taps, width );
+    }
+}
+
+/* Scales every band whose index is congruent to the job index. */
+static void *native_scale_bands( scale_job_t *job )
+{
+    native_scaler_t *s = job->s;
+    int band = 0;
+    for( int i = 0; i < s->planes; i++ )
+    {
+        for( int t = 0; t < s->vfilter[i].taps; t++ )
+            job->row_src[t] = -1;
+        for( int y = 0; y < s->dst_height[i]; y += SCALE_BAND_HEIGHT, band++ )
+            if( band % s->threads == job->index )
+                native_scale_band( job, i, y, X264_MIN( SCALE_BAND_HEIGHT, s->dst_height[i] - y ) );
+    }
+    return NULL;
+}
+
+static void native_scale( native_scaler_t *s, cli_image_t *out, cli_image_t *in )
+{
+    for( int i = 0; i < s->threads; i++ )
+    {
+        s->job[i].out = out;
+        s->job[i].in = in;
+    }
+    if( s->pool )
+    {
+        for( int i = 0; i < s->threads; i++ )
+            x264_threadpool_run( s->pool, (void*)native_scale_bands, &s->job[i] );
+        for( int i = 0; i < s->threads; i++ )
+            x264_threadpool_wait( s->pool, &s->job[i] );
+    }
+    else
+        native_scale_bands( &s->job[0] );
+}
+
+static void native_free( native_scaler_t *s )
+{
+    if( s->pool )
+        x264_threadpool_delete( s->pool );
+    for( int i = 0; i < s->planes; i++ )
+    {
+        free( s->hfilter[i].pos );
+        free( s->hfilter[i].coef );
+        free( s->vfilter[i].pos );
+        free( s->vfilter[i].coef );
+    }
+    for( int i = 0; i < SCALE_MAX_THREADS; i++ )
+    {
+        free( s->job[i].rows );
+        free( s->job[i].row_ptr );
+        free( s->job[i].row_src );
+    }
+    free( s );
+}
+
+static int native_init( native_scaler_t **ps, int csp, int method, int threads, int cpu,
+                        int src_width, int src_height, int dst_width, int dst_height )
+{
+    native_scaler_t *s = calloc( 1, sizeof(native_scaler_t) );
+    if( !s )
+        return -1;
+    x264_mc_functions_t mc;
+    x264_mc_init( cpu, &mc, 0 );
+    s->scale_h_8  = mc.scale_h_8;
+    s->scale_h_16 = mc.scale_h_16;
+    s->scale_v_8  = mc.scale_v_8;
+    s->scale_v_16 = mc.scale_v_16;
+    const x264_cli_csp_t *cli_csp = x264_cli_get_csp( csp );
+    int csp_mask = csp & X264_CSP_MASK;
+    int max_width = 0, max_taps = 0;
+    s->high_depth = !!(csp & X264_CSP_HIGH_DEPTH);
+    s->planes = cli_csp->planes;
+    for( int i = 0; i < s->planes; i++ )
+    {
+        s->pitch[i] = (csp_mask == X264_CSP_NV12 || csp_mask == X264_CSP_NV21 || csp_mask == X264_CSP_NV16) && i == 1 ? 2 :
+                      csp_mask == X264_CSP_BGR || csp_mask == X264_CSP_RGB ? 3 :
+                      csp_mask == X264_CSP_BGRA ? 4 :
+                      1;
+        s->dst_width[i]  = cli_csp->width[i]  * dst_width / s->pitch[i];
+        s->dst_height[i] = cli_csp->height[i] * dst_height;
+        if( native_filter_init( &s->hfilter[i], method, cli_csp->width[i] * src_width / s->pitch[i], s->dst_width[i],
+                                s->pitch[i], SCALE_ALIGN_H ) ||
+            native_filter_init( &s->vfilter[i], method, cli_csp->height[i] * src_height, s->dst_height[i], 1, SCALE_ALIGN_V ) )
+            goto fail;
+        max_width = X264_MAX( max_width, s->dst_width[i] * s->pitch[i] );
+        max_taps = X264_MAX( max_taps, s->vfilter[i].taps );
+    }
+
+    /* there is no point in more threads than bands in the luma plane */
+    s->threads = x264_clip3( threads, 1, X264_MIN( SCALE_MAX_THREADS, (dst_height + SCALE_BAND_HEIGHT - 1) / SCALE_BAND_HEIGHT ) );
+    for( int i = 0; i < s->threads; i++ )
+    {
+        scale_job_t *job = &s->job[i];
+        job->s = s;
+        job->index = i;
+        job->rows = malloc( max_taps * max_width * sizeof(int16_t) );
+        job->row_ptr = malloc( max_taps * sizeof(int16_t*) );
+        job->row_src = malloc( max_taps * sizeof(int) );
+        if( !job->rows || !job->row_ptr || !job->row_src )
+            goto fail;
+    }
+    /* fall back to scaling in the calling thread if no pool can be had */
+    if( s->threads > 1 && x264_threadpool_init( &s->pool, s->threads, NULL, NULL ) )
+    {
+        s->pool = NULL;
+        s->threads = 1;
+    }
+    *ps = s;
+    return 0;
+fail:
+    native_free( s );
+    return -1;
+}
+
 typedef struct
 {
     hnd_t prev_hnd;
@@ -66,8 +385,11 @@ typedef struct
     int buffer_allocated;
     int dst_csp;
     int input_range;
+#if HAVE_SWSCALE
     struct SwsContext *ctx;
     uint32_t ctx_flags;
+#endif
+    native_scaler_t *native;
     /* state of swapping chroma planes pre and post resize */
     int pre_swap_chroma;
     int post_swap_chroma;
@@ -79,7 +401,7 @@ typedef struct
 
 static void help( int longhelp )
 {
-    printf( "      "NAME":[width,height][,sar][,fittobox][,csp][,method]\n" );
+    printf( "      "NAME":[width,height][,sar][,fittobox][,csp][,method][,scaler][,threads]\n" );
     if( !longhelp )
         return;
     printf( "            resizes frames based on the given criteria:\n"
@@ -106,9 +428,16 @@ static void help( int longhelp )
             "            note: not all depths are supported by all csps.\n"
             "            - method: use resizer method [\"bicubic\"]\n"
             "               - fastbilinear, bilinear, bicubic, experimental, point,\n"
-            "               - area, bicublin, gauss, sinc, lanczos, spline\n" );
+            "               - area, bicublin, gauss, sinc, lanczos, spline\n"
+            "            - scaler: use the built-in scaler or swscale [\"%s\"]\n"
+            "               - native: built-in scaler, resolution changes only,\n"
+            "                 with the point, area, (fast)bilinear, bicubic and\n"
+            "                 lanczos methods\n"
+            "            - threads: number of threads of the native scaler [auto]\n",
+            HAVE_SWSCALE ? "swscale" : "native" );
 }
 
+#if HAVE_SWSCALE
 static uint32_t convert_method_to_flag( const char *name )
 {
     uint32_t flag = 0;
@@ -214,6 +543,8 @@ static int pick_closest_supported_csp( int csp )
     return ret;
 }
 
+#endif
+
 static int handle_opts( const char **optlist, char **opts, video_info_t *info, resizer_hnd_t *h )
 {
     uint32_t out_sar_w, out_sar_h;
@@ -360,6 +691,7 @@ static int handle_opts( const char **optlist, char **opts, video_info_t *info, r
     return 0;
 }
 
+#if HAVE_SWSCALE
 static int x264_init_sws_context( resizer_hnd_t *h )
 {
     if( h->ctx )
@@ -407,6 +739,34 @@ static int check_resizer( resizer_hnd_t *h, cli_pic_t *in )
     return 0;
 }
 
+#endif
+
+static int init_native( resizer_hnd_t *h, video_info_t *info, const char *method, int threads, int cpu )
+{
+    int native_method_id = native_method( method );
+    FAIL_IF_ERROR( native_method_id < 0, "method `%s' is not supported by the native scaler\n", method )
+    FAIL_IF_ERROR( (h->dst_csp ^ info->csp) & ~X264_CSP_VFLIP,
+                   "colorspace conversion is not supported by the native scaler\n" )
+    FAIL_IF_ERROR( h->dst.range != info->fullrange, "range conversion is not supported by the native scaler\n" )
+    FAIL_IF_ERROR( h->dst.height != info->height && info->interlaced,
+                   "the native scaler is not compatible with interlaced vertical resizing\n" )
+    /* confirm that the desired resolution meets the colorspace requirements */
+    const x264_cli_csp_t *csp = x264_cli_get_csp( h->dst_csp );
+    FAIL_IF_ERROR( h->dst.width % csp->mod_width || h->dst.height % csp->mod_height,
+                   "resolution %dx%d is not compliant with colorspace %s\n", h->dst.width, h->dst.height, csp->name )
+    h->dst_csp = info->csp;
+
+    if( h->dst.width == info->width && h->dst.height == info->height )
+        return 0;
+    x264_cli_log( NAME, X264_LOG_INFO, "resizing to %dx%d\n", h->dst.width, h->dst.height );
+    if( x264_cli_pic_alloc_aligned( &h->buffer, h->dst_csp, h->dst.width, h->dst.height ) )
+        return -1;
+    h->buffer_allocated = 1;
+    FAIL_IF_ERROR( native_init( &h->native, h->dst_csp, native_method_id, threads, cpu, info->width, info->height,
+                                h->dst.width, h->dst.height ), "native scaler init failed\n" )
+    return 0;
+}
+
 static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
 {
     /* if called for normalizing the csp to known formats and the format is not unknown, exit */
@@ -416,7 +776,7 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x2
     if( !opt_string && !full_check( info, param ) )
         return 0;
 
-    static const char *optlist[] = { "width", "height", "sar", "fittobox", "csp", "method", NULL };
+    static const char *optlist[] = { "width", "height", "sar", "fittobox", "csp", "method", "scaler", "threads", NULL };
     char **opts = x264_split_options( opt_string, optlist );
     if( !opts && opt_string )
         return -1;
@@ -432,11 +792,15 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x2
         h->dst.range  = info->fullrange; // maintain input range
         if( !strcmp( opt_string, "normcsp" ) )
         {
+#if HAVE_SWSCALE
             /* only in normalization scenarios is the input capable of changing properties */
             h->variable_input = 1;
             h->dst_csp = pick_closest_supported_csp( info->csp );
             FAIL_IF_ERROR( h->dst_csp == X264_CSP_NONE,
                            "filter get invalid input pixel format %d (colorspace %d)\n", convert_csp_to_pix_fmt( info->csp ), info->csp )
+#else
+            FAIL_IF_ERROR( 1, "not compiled with swscale support\n" )
+#endif
         }
         else if( handle_opts( optlist, opts, info, h ) )
             return -1;
@@ -448,59 +812,77 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x2
         h->dst.height = param->i_height;
         h->dst.range  = param->vui.b_fullrange; // change to libx264's range
     }
-    h->ctx_flags = convert_method_to_flag( x264_otos( x264_get_option( optlist[5], opts ), "" ) );
-    x264_free_string_array( opts );
-
-    if( h->ctx_flags != SWS_FAST_BILINEAR )
-        h->ctx_flags |= SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND;
-    h->dst.pix_fmt = convert_csp_to_pix_fmt( h->dst_csp );
-    h->scale = h->dst;
-    h->input_range = info->fullrange;
-
-    /* swap chroma planes if YV12/YV16/YV24 is involved, as libswscale works with I420/I422/I444 */
-    int src_csp = info->csp & (X264_CSP_MASK | X264_CSP_OTHER);
-    int dst_csp = h->dst_csp & (X264_CSP_MASK | X264_CSP_OTHER);
-    h->pre_swap_chroma  = src_csp == X264_CSP_YV12 || src_csp == X264_CSP_YV16 || src_csp == X264_CSP_YV24;
-    h->post_swap_chroma = dst_csp == X264_CSP_YV12 || dst_csp == X264_CSP_YV16 || dst_csp == X264_CSP_YV24;
-
-    int src_pix_fmt = convert_csp_to_pix_fmt( info->csp );
-
-    int src_pix_fmt_inv = convert_csp_to_pix_fmt( info->csp ^ X264_CSP_HIGH_DEPTH );
-    int dst_pix_fmt_inv = convert_csp_to_pix_fmt( h->dst_csp ^ X264_CSP_HIGH_DEPTH );
-
-    /* confirm swscale can support this conversion */
-    FAIL_IF_ERROR( src_pix_fmt == AV_PIX_FMT_NONE && src_pix_fmt_inv != AV_PIX_FMT_NONE,
-                   "input colorspace %s with bit depth %d is not supported\n", av_get_pix_fmt_name( src_pix_fmt_inv ),
-                   info->csp & X264_CSP_HIGH_DEPTH ? 16 : 8 );
-    FAIL_IF_ERROR( !sws_isSupportedInput( src_pix_fmt ), "input colorspace %s is not supported\n", av_get_pix_fmt_name( src_pix_fmt ) )
-    FAIL_IF_ERROR( h->dst.pix_fmt == AV_PIX_FMT_NONE && dst_pix_fmt_inv != AV_PIX_FMT_NONE,
-                   "input colorspace %s with bit depth %d is not supported\n", av_get_pix_fmt_name( dst_pix_fmt_inv ),
-                   h->dst_csp & X264_CSP_HIGH_DEPTH ? 16 : 8 );
-    FAIL_IF_ERROR( !sws_isSupportedOutput( h->dst.pix_fmt ), "output colorspace %s is not supported\n", av_get_pix_fmt_name( h->dst.pix_fmt ) )
-    FAIL_IF_ERROR( h->dst.height != info->height && info->interlaced,
-                   "swscale is not compatible with interlaced vertical resizing\n" )
-    /* confirm that the desired resolution meets the colorspace requirements */
-    const x264_cli_csp_t *csp = x264_cli_get_csp( h->dst_csp );
-    FAIL_IF_ERROR( h->dst.width % csp->mod_width || h->dst.height % csp->mod_height,
-                   "resolution %dx%d is not compliant with colorspace %s\n", h->dst.width, h->dst.height, csp->name )
-
-    if( h->dst.width != info->width || h->dst.height != info->height )
-        x264_cli_log( NAME, X264_LOG_INFO, "resizing to %dx%d\n", h->dst.width, h->dst.height );
-    if( h->dst.pix_fmt != src_pix_fmt )
-        x264_cli_log( NAME, X264_LOG_WARNING, "converting from %s to %s\n",
-                      av_get_pix_fmt_name( src_pix_fmt ), av_get_pix_fmt_name( h->dst.pix_fmt ) );
-    else if( h->dst.range != h->input_range )
-        x264_cli_log( NAME, X264_LOG_WARNING, "converting range from %s to %s\n",
-                      h->input_range ? "PC" : "TV", h->dst.range ? "PC" : "TV" );
-    h->dst_csp |= info->csp & X264_CSP_VFLIP; // preserve vflip
-
-    /* if the input is not variable, initialize the context */
-    if( !h->variable_input )
+    const char *method = x264_otos( x264_get_option( optlist[5], opts ), "" );
+    const char *scaler = x264_otos( x264_get_option( optlist[6], opts ), HAVE_SWSCALE ? "swscale" : "native" );
+    int threads = x264_otoi( x264_get_option( optlist[7], opts ),
+                             param->i_threads == X264_THREADS_AUTO ? x264_cpu_num_processors() : param->i_threads );
+    if( !strcasecmp( scaler, "native" ) )
     {
-        cli_pic_t input_pic = {{info->csp, info->width, info->height, 0}, 0};
-        if( check_resizer( h, &input_pic ) )
+        int ret = init_native( h, info, method, threads, param->cpu );
+        x264_free_string_array( opts );
+        if( ret )
             return -1;
     }
+#if HAVE_SWSCALE
+    else
+    {
+        FAIL_IF_ERROR( strcasecmp( scaler, "swscale" ), "invalid scaler `%s'\n", scaler )
+        h->ctx_flags = convert_method_to_flag( method );
+        x264_free_string_array( opts );
+        if( h->ctx_flags != SWS_FAST_BILINEAR )
+            h->ctx_flags |= SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND;
+        h->dst.pix_fmt = convert_csp_to_pix_fmt( h->dst_csp );
+        h->scale = h->dst;
+        h->input_range = info->fullrange;
+
+        /* swap chroma planes if YV12/YV16/YV24 is involved, as libswscale works with I420/I422/I444 */
+        int src_csp = info->csp & (X264_CSP_MASK | X264_CSP_OTHER);
+        int dst_csp = h->dst_csp & (X264_CSP_MASK | X264_CSP_OTHER);
+        h->pre_swap_chroma  = src_csp == X264_CSP_YV12 || src_csp == X264_CSP_YV16 || src_csp == X264_CSP_YV24;
+        h->post_swap_chroma = dst_csp == X264_CSP_YV12 || dst_csp == X264_CSP_YV16 || dst_csp == X264_CSP_YV24;
+
+        int src_pix_fmt = convert_csp_to_pix_fmt( info->csp );
+
+        int src_pix_fmt_inv = convert_csp_to_pix_fmt( info->csp ^ X264_CSP_HIGH_DEPTH );
+        int dst_pix_fmt_inv = convert_csp_to_pix_fmt( h->dst_csp ^ X264_CSP_HIGH_DEPTH );
+
+        /* confirm swscale can support this conversion */
+        FAIL_IF_ERROR( src_pix_fmt == AV_PIX_FMT_NONE && src_pix_fmt_inv != AV_PIX_FMT_NONE,
+                       "input colorspace %s with bit depth %d is not supported\n", av_get_pix_fmt_name( src_pix_fmt_inv ),
+                       info->csp & X264_CSP_HIGH_DEPTH ? 16 : 8 );
+        FAIL_IF_ERROR( !sws_isSupportedInput( src_pix_fmt ), "input colorspace %s is not supported\n", av_get_pix_fmt_name( src_pix_fmt ) )
+        FAIL_IF_ERROR( h->dst.pix_fmt == AV_PIX_FMT_NONE && dst_pix_fmt_inv != AV_PIX_FMT_NONE,
+                       "input colorspace %s with bit depth %d is not supported\n", av_get_pix_fmt_name( dst_pix_fmt_inv ),
+                       h->dst_csp & X264_CSP_HIGH_DEPTH ? 16 : 8 );
+        FAIL_IF_ERROR( !sws_isSupportedOutput( h->dst.pix_fmt ), "output colorspace %s is not supported\n", av_get_pix_fmt_name( h->dst.pix_fmt ) )
+        FAIL_IF_ERROR( h->dst.height != info->height && info->interlaced,
+                       "swscale is not compatible with interlaced vertical resizing\n" )
+        /* confirm that the desired resolution meets the colorspace requirements */
+        const x264_cli_csp_t *csp = x264_cli_get_csp( h->dst_csp );
+        FAIL_IF_ERROR( h->dst.width % csp->mod_width || h->dst.height % csp->mod_height,
+                       "resolution %dx%d is not compliant with colorspace %s\n", h->dst.width, h->dst.height, csp->name )
+
+        if( h->dst.width != info->width || h->dst.height != info->height )
+            x264_cli_log( NAME, X264_LOG_INFO, "resizing to %dx%d\n", h->dst.width, h->dst.height );
+        if( h->dst.pix_fmt != src_pix_fmt )
+            x264_cli_log( NAME, X264_LOG_WARNING, "converting from %s to %s\n",
+                          av_get_pix_fmt_name( src_pix_fmt ), av_get_pix_fmt_name( h->dst.pix_fmt ) );
+        else if( h->dst.range != h->input_range )
+            x264_cli_log( NAME, X264_LOG_WARNING, "converting range from %s to %s\n",
+                          h->input_range ? "PC" : "TV", h->dst.range ? "PC" : "TV" );
+        h->dst_csp |= info->csp & X264_CSP_VFLIP; // preserve vflip
+
+        /* if the input is not variable, initialize the context */
+        if( !h->variable_input )
+        {
+            cli_pic_t input_pic = {{info->csp, info->width, info->height, 0}, 0};
+            if( check_resizer( h, &input_pic ) )
+                return -1;
+        }
+    }
+#else
+    else FAIL_IF_ERROR( 1, "invalid scaler `%s'\n", scaler )
+#endif
 
     /* finished initing, overwrite values */
     info->csp       = h->dst_csp;
@@ -521,6 +903,13 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
     resizer_hnd_t *h = handle;
     if( h->prev_filter.get_frame( h->prev_hnd, output, frame ) )
         return -1;
+    if( h->native )
+    {
+        native_scale( h->native, &h->buffer.img, &output->img );
+        output->img = h->buffer.img;
+        return 0;
+    }
+#if HAVE_SWSCALE
     if( h->variable_input && check_resizer( h, output ) )
         return -1;
     h->working = 1;
@@ -536,6 +925,9 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
         output->img.csp = h->dst_csp;
     if( h->post_swap_chroma )
         XCHG( uint8_t*, output->img.plane[1], output->img.plane[2] );
+#else
+    output->img.csp = h->dst_csp;
+#endif
 
     return 0;
 }
@@ -550,39 +942,15 @@ static void free_filter( hnd_t handle )
 {
     resizer_hnd_t *h = handle;
     h->prev_filter.free( h->prev_hnd );
+#if HAVE_SWSCALE
     if( h->ctx )
         sws_freeContext( h->ctx );
+#endif
+    if( h->native )
+        native_free( h->native );
     if( h->buffer_allocated )
         x264_cli_pic_clean( &h->buffer );
     free( h );
 }
 
-#else /* no swscale */
-static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
-{
-    int ret = 0;
-
-    if( !opt_string )
-        ret = full_check( info, param );
-    else
-    {
-        if( !strcmp( opt_string, "normcsp" ) )
-            ret = info->csp & X264_CSP_OTHER;
-        else
-            ret = -1;
-    }
-
-    /* pass if nothing needs to be done, otherwise fail */
-    FAIL_IF_ERROR( ret, "not compiled with swscale support\n" )
-    return 0;
-}
-
-#define help NULL
-#define get_frame NULL
-#define release_frame NULL
-#define free_filter NULL
-#define convert_csp_to_pix_fmt(x) (x & X264_CSP_MASK)
-
-#endif
-
 cli_vid_filter_t resize_filter = { NAME, help, init, get_frame, release_frame, free_filter, NULL };
@@ -52,6 +52,9 @@ void x264_register_vid_filters( void )
     REGISTER_VFILTER( resize );
     REGISTER_VFILTER( select_every );
     REGISTER_VFILTER( depth );
+#if HAVE_THREAD
+    REGISTER_VFILTER( pipe );
+#endif
 #if HAVE_GPL
 #endif
 }
@@ -32,6 +32,7 @@
 #undef DECLARE_ALIGNED
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -44,6 +45,7 @@ typedef struct
     int reduce_pts;
     int vfr_input;
     int num_frames;
+    int copy_frames;
     int64_t time;
 } ffms_hnd_t;
 
@@ -138,8 +140,10 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
     info->fps_den      = videop->FPSDenominator;
     info->fps_num      = videop->FPSNumerator;
     h->vfr_input       = info->vfr;
-    /* ffms is thread unsafe as it uses a single frame buffer for all frame requests */
-    info->thread_safe  = 0;
+    /* ffms uses a single frame buffer for all frame requests, so frames can only be
+     * read ahead by the threaded input when each one is copied out of it */
+    h->copy_frames     = opt->read_ahead > 0;
+    info->thread_safe  = h->copy_frames;
 
     const FFMS_Frame *frame = FFMS_GetFrame( h->video_source, 0, &e );
     FAIL_IF_ERROR( !frame, "could not read frame 0\n" )
@@ -175,7 +179,7 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
     return 0;
 }
 
-static int picture_alloc( cli_pic_t *pic, int csp, int width, int height )
+static int picture_alloc( cli_pic_t *pic, hnd_t handle, int csp, int width, int height )
 {
     if( x264_cli_pic_alloc( pic, X264_CSP_NONE, width, height ) )
         return -1;
@@ -194,8 +198,23 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
     const FFMS_Frame *frame = FFMS_GetFrame( h->video_source, i_frame, &e );
     FAIL_IF_ERROR( !frame, "could not read frame %d \n", i_frame )
 
-    memcpy( pic->img.stride, frame->Linesize, sizeof(pic->img.stride) );
-    memcpy( pic->img.plane, frame->Data, sizeof(pic->img.plane) );
+    if( h->copy_frames )
+    {
+        /* the picture keeps its own copy, allocated on first use and pointed to by opaque */
+        if( !pic->opaque )
+        {
+            FAIL_IF_ERROR( av_image_alloc( pic->img.plane, pic->img.stride, frame->EncodedWidth, frame->EncodedHeight,
+                                           frame->EncodedPixelFormat, 32 ) < 0, "malloc failed\n" )
+            pic->opaque = pic->img.plane[0];
+        }
+        av_image_copy( pic->img.plane, pic->img.stride, (const uint8_t**)frame->Data, frame->Linesize,
+                       frame->EncodedPixelFormat, frame->EncodedWidth, frame->EncodedHeight );
+    }
+    else
+    {
+        memcpy( pic->img.stride, frame->Linesize, sizeof(pic->img.stride) );
+        memcpy( pic->img.plane, frame->Data, sizeof(pic->img.plane) );
+    }
 
     if( h->vfr_input )
     {
@@ -209,8 +228,9 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
     return 0;
 }
 
-static void picture_clean( cli_pic_t *pic )
+static void picture_clean( cli_pic_t *pic, hnd_t handle )
 {
+    av_free( pic->opaque );
     memset( pic, 0, sizeof(cli_pic_t) );
 }
 
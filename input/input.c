@@ -25,6 +25,11 @@
 
 #include "input.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 const x264_cli_csp_t x264_cli_csps[] = {
     [X264_CSP_I420] = { "i420", 3, { 1, .5, .5 }, { 1, .5, .5 }, 2, 2 },
     [X264_CSP_I422] = { "i422", 3, { 1, .5, .5 }, { 1,  1,  1 }, 2, 1 },
@@ -76,7 +81,7 @@ uint64_t x264_cli_pic_size( int csp, int width, int height )
     return size;
 }
 
-static int x264_cli_pic_alloc_internal( cli_pic_t *pic, int csp, int width, int height, int align )
+static int x264_cli_pic_init_internal( cli_pic_t *pic, int csp, int width, int height, int align, int alloc )
 {
     memset( pic, 0, sizeof(cli_pic_t) );
     int csp_mask = csp & X264_CSP_MASK;
@@ -92,10 +97,13 @@ static int x264_cli_pic_alloc_internal( cli_pic_t *pic, int csp, int width, int
         int stride = width * x264_cli_csps[csp_mask].width[i];
         stride *= x264_cli_csp_depth_factor( csp );
         stride = ALIGN( stride, align );
-        uint64_t size = (uint64_t)(height * x264_cli_csps[csp_mask].height[i]) * stride;
-        pic->img.plane[i] = x264_malloc( size );
-        if( !pic->img.plane[i] )
-            return -1;
+        if( alloc )
+        {
+            uint64_t size = (uint64_t)(height * x264_cli_csps[csp_mask].height[i]) * stride;
+            pic->img.plane[i] = x264_malloc( size );
+            if( !pic->img.plane[i] )
+                return -1;
+        }
         pic->img.stride[i] = stride;
     }
 
@@ -104,12 +112,19 @@ static int x264_cli_pic_alloc_internal( cli_pic_t *pic, int csp, int width, int
 
 int x264_cli_pic_alloc( cli_pic_t *pic, int csp, int width, int height )
 {
-    return x264_cli_pic_alloc_internal( pic, csp, width, height, 1 );
+    return x264_cli_pic_init_internal( pic, csp, width, height, 1, 1 );
 }
 
 int x264_cli_pic_alloc_aligned( cli_pic_t *pic, int csp, int width, int height )
 {
-    return x264_cli_pic_alloc_internal( pic, csp, width, height, NATIVE_ALIGN );
+    return x264_cli_pic_init_internal( pic, csp, width, height, NATIVE_ALIGN, 1 );
+}
+
+/* Sets up the picture properties and strides only; the planes are pointed at
+ * existing memory (e.g. a mapped file) by the demuxer. */
+int x264_cli_pic_init_noalloc( cli_pic_t *pic, int csp, int width, int height )
+{
+    return x264_cli_pic_init_internal( pic, csp, width, height, 1, 0 );
 }
 
 void x264_cli_pic_clean( cli_pic_t *pic )
@@ -125,3 +140,65 @@ const x264_cli_csp_t *x264_cli_get_csp( int csp )
         return NULL;
     return x264_cli_csps + (csp&X264_CSP_MASK);
 }
+
+int x264_cli_mmap_init( cli_mmap_t *h, FILE *fh )
+{
+    memset( h, 0, sizeof(cli_mmap_t) );
+#ifndef _WIN32
+    int fd = fileno( fh );
+    x264_struct_stat file_stat;
+    if( !x264_fstat( fd, &file_stat ) && S_ISREG( file_stat.st_mode ) &&
+        file_stat.st_size > 0 && (uint64_t)file_stat.st_size <= SIZE_MAX )
+    {
+        void *map = mmap( NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( map != MAP_FAILED )
+        {
+            h->map = map;
+            h->file_size = file_stat.st_size;
+            h->page_mask = sysconf( _SC_PAGESIZE ) - 1;
+            /* Frames are read front to back: ask for aggressive readahead. */
+            madvise( h->map, h->file_size, MADV_SEQUENTIAL );
+            return 0;
+        }
+    }
+#endif
+    return -1;
+}
+
+/* Returns a pointer to size bytes at offset in the file, or NULL if that is past the end.
+ * Readahead is started for the range and for the same amount of data following it. */
+void *x264_cli_mmap( cli_mmap_t *h, int64_t offset, int64_t size )
+{
+    if( offset < 0 || size < 0 || offset + size > h->file_size )
+        return NULL;
+#ifndef _WIN32
+    int64_t start = offset & ~(int64_t)h->page_mask;
+    int64_t end = X264_MIN( offset + 2 * size, h->file_size );
+    madvise( h->map + start, end - start, MADV_WILLNEED );
+#endif
+    return h->map + offset;
+}
+
+/* Releases the pages that lie entirely before the end of [addr, addr+size) and have
+ * not been released yet.  The mapping is read-only and file-backed, so this only drops
+ * them from our address space; touching them again simply reads them back in. */
+void x264_cli_munmap( cli_mmap_t *h, void *addr, int64_t size )
+{
+#ifndef _WIN32
+    int64_t end = ((uint8_t*)addr - h->map + size) & ~(int64_t)h->page_mask;
+    if( end > h->released )
+    {
+        madvise( h->map + h->released, end - h->released, MADV_DONTNEED );
+        h->released = end;
+    }
+#endif
+}
+
+void x264_cli_mmap_close( cli_mmap_t *h )
+{
+#ifndef _WIN32
+    if( h->map )
+        munmap( h->map, h->file_size );
+#endif
+    memset( h, 0, sizeof(cli_mmap_t) );
+}
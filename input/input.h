@@ -44,6 +44,7 @@ typedef struct
     int output_csp; /* convert to this csp, if applicable */
     int output_range; /* user desired output range */
     int input_range; /* user override input range */
+    int read_ahead; /* frames read ahead by the threaded input, 0 = auto; lavf and ffms only read ahead when set */
 } cli_input_opt_t;
 
 /* properties of the source given by the demuxer */
@@ -60,7 +61,7 @@ typedef struct
     uint32_t sar_width;
     uint32_t sar_height;
     int tff;
-    int thread_safe; /* demuxer is thread_input safe */
+    int thread_safe; /* demuxer is thread_input safe: frames stay valid after the next read */
     uint32_t timebase_num;
     uint32_t timebase_den;
     int vfr;
@@ -88,20 +89,20 @@ typedef struct
 typedef struct
 {
     int (*open_file)( char *psz_filename, hnd_t *p_handle, video_info_t *info, cli_input_opt_t *opt );
-    int (*picture_alloc)( cli_pic_t *pic, int csp, int width, int height );
+    int (*picture_alloc)( cli_pic_t *pic, hnd_t handle, int csp, int width, int height );
     int (*read_frame)( cli_pic_t *pic, hnd_t handle, int i_frame );
     int (*release_frame)( cli_pic_t *pic, hnd_t handle );
-    void (*picture_clean)( cli_pic_t *pic );
+    void (*picture_clean)( cli_pic_t *pic, hnd_t handle );
     int (*close_file)( hnd_t handle );
 } cli_input_t;
 
 extern const cli_input_t raw_input;
 extern const cli_input_t y4m_input;
 extern const cli_input_t avs_input;
-extern cli_input_t thread_input;
+extern const cli_input_t thread_input;
 extern const cli_input_t lavf_input;
 extern const cli_input_t ffms_input;
-extern cli_input_t timecode_input;
+extern const cli_input_t timecode_input;
 
 extern cli_input_t cli_input;
 
@@ -125,9 +126,24 @@ int      x264_cli_csp_is_invalid( int csp );
 int      x264_cli_csp_depth_factor( int csp );
 int      x264_cli_pic_alloc( cli_pic_t *pic, int csp, int width, int height );
 int      x264_cli_pic_alloc_aligned( cli_pic_t *pic, int csp, int width, int height );
+int      x264_cli_pic_init_noalloc( cli_pic_t *pic, int csp, int width, int height );
 void     x264_cli_pic_clean( cli_pic_t *pic );
 uint64_t x264_cli_pic_plane_size( int csp, int width, int height, int plane );
 uint64_t x264_cli_pic_size( int csp, int width, int height );
 const x264_cli_csp_t *x264_cli_get_csp( int csp );
 
+/* read-only mapping of a whole input file */
+typedef struct
+{
+    uint8_t *map;
+    int64_t file_size;
+    int64_t released;  /* pages before this offset have been released */
+    intptr_t page_mask;
+} cli_mmap_t;
+
+int   x264_cli_mmap_init( cli_mmap_t *h, FILE *fh );
+void *x264_cli_mmap( cli_mmap_t *h, int64_t offset, int64_t size );
+void  x264_cli_munmap( cli_mmap_t *h, void *addr, int64_t size );
+void  x264_cli_mmap_close( cli_mmap_t *h );
+
 #endif
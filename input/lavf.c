@@ -31,6 +31,7 @@
 #include <libavutil/mem.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/dict.h>
+#include <libavutil/imgutils.h>
 
 typedef struct
 {
@@ -39,6 +40,7 @@ typedef struct
     int stream_id;
     int next_frame;
     int vfr_input;
+    int copy_frames;
     cli_pic_t *first_pic;
 } lavf_hnd_t;
 
@@ -63,9 +65,10 @@ static int read_frame_internal( cli_pic_t *p_pic, lavf_hnd_t *h, int i_frame, vi
         if( !i_frame )
         {
             XCHG( cli_image_t, p_pic->img, h->first_pic->img );
+            XCHG( void*, p_pic->opaque, h->first_pic->opaque );
             p_pic->pts = h->first_pic->pts;
         }
-        lavf_input.picture_clean( h->first_pic );
+        lavf_input.picture_clean( h->first_pic, h );
         free( h->first_pic );
         h->first_pic = NULL;
         if( !i_frame )
@@ -110,8 +113,23 @@ static int read_frame_internal( cli_pic_t *p_pic, lavf_hnd_t *h, int i_frame, vi
         h->next_frame++;
     }
 
-    memcpy( p_pic->img.stride, h->frame->linesize, sizeof(p_pic->img.stride) );
-    memcpy( p_pic->img.plane, h->frame->data, sizeof(p_pic->img.plane) );
+    if( h->copy_frames )
+    {
+        /* the picture keeps its own copy, allocated on first use and pointed to by opaque */
+        if( !p_pic->opaque )
+        {
+            FAIL_IF_ERROR( av_image_alloc( p_pic->img.plane, p_pic->img.stride, c->width, c->height, c->pix_fmt, 32 ) < 0,
+                           "malloc failed\n" )
+            p_pic->opaque = p_pic->img.plane[0];
+        }
+        av_image_copy( p_pic->img.plane, p_pic->img.stride, (const uint8_t**)h->frame->data, h->frame->linesize,
+                       c->pix_fmt, c->width, c->height );
+    }
+    else
+    {
+        memcpy( p_pic->img.stride, h->frame->linesize, sizeof(p_pic->img.stride) );
+        memcpy( p_pic->img.plane, h->frame->data, sizeof(p_pic->img.plane) );
+    }
     int is_fullrange   = 0;
     p_pic->img.width   = c->width;
     p_pic->img.height  = c->height;
@@ -184,15 +202,17 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
     info->fps_den      = h->lavf->streams[i]->avg_frame_rate.den;
     info->timebase_num = h->lavf->streams[i]->time_base.num;
     info->timebase_den = h->lavf->streams[i]->time_base.den;
-    /* lavf is thread unsafe as calling av_read_frame invalidates previously read AVPackets */
-    info->thread_safe  = 0;
+    /* calling av_read_frame invalidates previously read AVPackets, so frames can only
+     * be read ahead by the threaded input when each one is copied out of the decoder */
+    h->copy_frames     = opt->read_ahead > 0;
+    info->thread_safe  = h->copy_frames;
     h->vfr_input       = info->vfr;
     FAIL_IF_ERROR( avcodec_open2( c, avcodec_find_decoder( c->codec_id ), NULL ),
                    "could not find decoder for video stream\n" )
 
     /* prefetch the first frame and set/confirm flags */
     h->first_pic = malloc( sizeof(cli_pic_t) );
-    FAIL_IF_ERROR( !h->first_pic || lavf_input.picture_alloc( h->first_pic, X264_CSP_OTHER, info->width, info->height ),
+    FAIL_IF_ERROR( !h->first_pic || lavf_input.picture_alloc( h->first_pic, h, X264_CSP_OTHER, info->width, info->height ),
                    "malloc failed\n" )
     else if( read_frame_internal( h->first_pic, h, 0, info ) )
         return -1;
@@ -215,7 +235,7 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
     return 0;
 }
 
-static int picture_alloc( cli_pic_t *pic, int csp, int width, int height )
+static int picture_alloc( cli_pic_t *pic, hnd_t handle, int csp, int width, int height )
 {
     if( x264_cli_pic_alloc( pic, X264_CSP_NONE, width, height ) )
         return -1;
@@ -229,8 +249,9 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
     return read_frame_internal( pic, handle, i_frame, NULL );
 }
 
-static void picture_clean( cli_pic_t *pic )
+static void picture_clean( cli_pic_t *pic, hnd_t handle )
 {
+    av_free( pic->opaque );
     memset( pic, 0, sizeof(cli_pic_t) );
 }
 
@@ -35,6 +35,9 @@ typedef struct
     uint64_t plane_size[4];
     uint64_t frame_size;
     int bit_depth;
+    cli_mmap_t mmap;
+    int use_mmap;
+    int zero_copy; /* planes point straight into the mapped file */
 } raw_hnd_t;
 
 static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, cli_input_opt_t *opt )
@@ -96,19 +99,42 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
         uint64_t size = ftell( h->fh );
         fseek( h->fh, 0, SEEK_SET );
         info->num_frames = size / h->frame_size;
+        h->use_mmap = !x264_cli_mmap_init( &h->mmap, h->fh );
+        /* depths other than 8 and 16 are upconverted in place, which needs a copy */
+        h->zero_copy = h->use_mmap && !(h->bit_depth & 7);
     }
 
     *p_handle = h;
     return 0;
 }
 
-static int read_frame_internal( cli_pic_t *pic, raw_hnd_t *h, int bit_depth_uc )
+static int picture_alloc( cli_pic_t *pic, hnd_t handle, int csp, int width, int height )
+{
+    raw_hnd_t *h = handle;
+    return (h->zero_copy ? x264_cli_pic_init_noalloc : x264_cli_pic_alloc)( pic, csp, width, height );
+}
+
+static int read_frame_internal( cli_pic_t *pic, raw_hnd_t *h, int i_frame, int bit_depth_uc )
 {
     int error = 0;
     int pixel_depth = x264_cli_csp_depth_factor( pic->img.csp );
+    uint8_t *frame = NULL, *src;
+    if( h->use_mmap )
+    {
+        frame = x264_cli_mmap( &h->mmap, i_frame * h->frame_size, h->frame_size );
+        if( !frame )
+            return -1;
+    }
+    src = frame;
     for( int i = 0; i < pic->img.planes && !error; i++ )
     {
-        error |= fread( pic->img.plane[i], pixel_depth, h->plane_size[i], h->fh ) != h->plane_size[i];
+        if( h->zero_copy )
+            pic->img.plane[i] = src;
+        else if( h->use_mmap )
+            memcpy( pic->img.plane[i], src, pixel_depth * h->plane_size[i] );
+        else
+            error |= fread( pic->img.plane[i], pixel_depth, h->plane_size[i], h->fh ) != h->plane_size[i];
+        src += pixel_depth * h->plane_size[i];
         if( bit_depth_uc )
         {
             /* upconvert non 16bit high depth planes to 16bit using the same
@@ -120,6 +146,9 @@ static int read_frame_internal( cli_pic_t *pic, raw_hnd_t *h, int bit_depth_uc )
                 plane[j] = plane[j] << lshift;
         }
     }
+    /* the frame has been copied out of the mapping, it is no longer needed */
+    if( frame && !h->zero_copy )
+        x264_cli_munmap( &h->mmap, frame, h->frame_size );
     return error;
 }
 
@@ -127,34 +156,53 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
 {
     raw_hnd_t *h = handle;
 
-    if( i_frame > h->next_frame )
+    if( i_frame > h->next_frame && !h->use_mmap )
     {
         if( x264_is_regular_file( h->fh ) )
             fseek( h->fh, i_frame * h->frame_size, SEEK_SET );
         else
             while( i_frame > h->next_frame )
             {
-                if( read_frame_internal( pic, h, 0 ) )
+                if( read_frame_internal( pic, h, h->next_frame, 0 ) )
                     return -1;
                 h->next_frame++;
             }
     }
 
-    if( read_frame_internal( pic, h, h->bit_depth & 7 ) )
+    if( read_frame_internal( pic, h, i_frame, h->bit_depth & 7 ) )
         return -1;
 
     h->next_frame = i_frame+1;
     return 0;
 }
 
+static int release_frame( cli_pic_t *pic, hnd_t handle )
+{
+    raw_hnd_t *h = handle;
+    if( h->zero_copy )
+        x264_cli_munmap( &h->mmap, pic->img.plane[0], h->frame_size );
+    return 0;
+}
+
+static void picture_clean( cli_pic_t *pic, hnd_t handle )
+{
+    raw_hnd_t *h = handle;
+    if( h->zero_copy )
+        memset( pic, 0, sizeof(cli_pic_t) );
+    else
+        x264_cli_pic_clean( pic );
+}
+
 static int close_file( hnd_t handle )
 {
     raw_hnd_t *h = handle;
     if( !h || !h->fh )
         return 0;
+    if( h->use_mmap )
+        x264_cli_mmap_close( &h->mmap );
     fclose( h->fh );
     free( h );
     return 0;
 }
 
-const cli_input_t raw_input = { open_file, x264_cli_pic_alloc, read_frame, NULL, x264_cli_pic_clean, close_file };
+const cli_input_t raw_input = { open_file, picture_alloc, read_frame, release_frame, picture_clean, close_file };
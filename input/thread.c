@@ -26,83 +26,198 @@
 
 #include "input.h"
 
+#define MAX_READ_AHEAD 64
+
+typedef struct
+{
+    cli_pic_t pic;
+    int i_frame;
+    int status;
+    int64_t i_read_time;
+} thread_frame_t;
+
 typedef struct
 {
     cli_input_t input;
     hnd_t p_handle;
-    cli_pic_t pic;
     x264_threadpool_t *pool;
-    int next_frame;
     int frame_total;
-    struct thread_input_arg_t *next_args;
-} thread_hnd_t;
 
-typedef struct thread_input_arg_t
-{
-    thread_hnd_t *h;
-    cli_pic_t *pic;
-    int i_frame;
-    int status;
-} thread_input_arg_t;
+    /* Frames read ahead of the encoder, oldest first.  Only the reader fills the
+     * slot after the last queued frame, and only while it is not queued yet. */
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t cv_fill;   /* signaled when a frame has been read or the reader stopped */
+    x264_pthread_cond_t cv_empty;  /* signaled when a slot has been freed or the reader should stop */
+    thread_frame_t *frames;
+    int depth;
+    int i_head;
+    int i_size;
+    int next_read;  /* next frame the reader will read */
+    int b_reading;  /* the reader is still reading */
+    int b_job;      /* the reader job has been started and not waited for */
+    int b_stop;
+
+    /* stats */
+    int     i_frames_read;
+    int64_t i_read_time;
+    int64_t i_max_read_time;
+    int     i_full;       /* times the reader blocked on a full queue */
+    int     i_waits;      /* times the encoder blocked on an empty queue */
+    int64_t i_wait_time;
+} thread_hnd_t;
 
 static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, cli_input_opt_t *opt )
 {
-    thread_hnd_t *h = malloc( sizeof(thread_hnd_t) );
-    FAIL_IF_ERR( !h || cli_input.picture_alloc( &h->pic, info->csp, info->width, info->height ),
-                 "x264", "malloc failed\n" )
+    thread_hnd_t *h = calloc( 1, sizeof(thread_hnd_t) );
+    FAIL_IF_ERR( !h, "x264", "malloc failed\n" )
     h->input = cli_input;
     h->p_handle = *p_handle;
-    h->next_frame = -1;
-    h->next_args = malloc( sizeof(thread_input_arg_t) );
-    if( !h->next_args )
-        return -1;
-    h->next_args->h = h;
-    h->next_args->status = 0;
+    h->depth = x264_clip3( opt && opt->read_ahead > 0 ? opt->read_ahead : 1, 1, MAX_READ_AHEAD );
+    h->frames = calloc( h->depth, sizeof(thread_frame_t) );
+    FAIL_IF_ERR( !h->frames, "x264", "malloc failed\n" )
+    for( int i = 0; i < h->depth; i++ )
+        FAIL_IF_ERR( h->input.picture_alloc( &h->frames[i].pic, h->p_handle, info->csp, info->width, info->height ),
+                     "x264", "malloc failed\n" )
     h->frame_total = info->num_frames;
-    thread_input.picture_alloc = h->input.picture_alloc;
-    thread_input.picture_clean = h->input.picture_clean;
 
-    if( x264_threadpool_init( &h->pool, 1, NULL, NULL ) )
+    if( x264_pthread_mutex_init( &h->mutex, NULL ) ||
+        x264_pthread_cond_init( &h->cv_fill, NULL ) ||
+        x264_pthread_cond_init( &h->cv_empty, NULL ) ||
+        x264_threadpool_init( &h->pool, 1, NULL, NULL ) )
         return -1;
 
     *p_handle = h;
     return 0;
 }
 
-static void read_frame_thread_int( thread_input_arg_t *i )
+static int picture_alloc( cli_pic_t *pic, hnd_t handle, int csp, int width, int height )
 {
-    i->status = i->h->input.read_frame( i->pic, i->h->p_handle, i->i_frame );
+    thread_hnd_t *h = handle;
+    return h->input.picture_alloc( pic, h->p_handle, csp, width, height );
 }
 
-static int read_frame( cli_pic_t *p_pic, hnd_t handle, int i_frame )
+static void picture_clean( cli_pic_t *pic, hnd_t handle )
 {
     thread_hnd_t *h = handle;
-    int ret = 0;
+    h->input.picture_clean( pic, h->p_handle );
+}
 
-    if( h->next_frame >= 0 )
+/* Runs on the input thread: reads frames in order until the queue is full,
+ * then waits for the encoder to take one.  Stops at the end of the input,
+ * on the first failed read, or when asked to. */
+static void *read_frames( thread_hnd_t *h )
+{
+    x264_pthread_mutex_lock( &h->mutex );
+    while( !h->b_stop && (!h->frame_total || h->next_read < h->frame_total) )
     {
-        x264_threadpool_wait( h->pool, h->next_args );
-        ret |= h->next_args->status;
+        if( h->i_size == h->depth )
+        {
+            h->i_full++;
+            while( h->i_size == h->depth && !h->b_stop )
+                x264_pthread_cond_wait( &h->cv_empty, &h->mutex );
+            continue;
+        }
+        thread_frame_t *frame = &h->frames[(h->i_head + h->i_size) % h->depth];
+        frame->i_frame = h->next_read;
+        x264_pthread_mutex_unlock( &h->mutex );
+
+        int64_t start = x264_mdate();
+        frame->status = h->input.read_frame( &frame->pic, h->p_handle, frame->i_frame );
+        frame->i_read_time = x264_mdate() - start;
+
+        x264_pthread_mutex_lock( &h->mutex );
+        h->i_size++;
+        h->next_read++;
+        x264_pthread_cond_broadcast( &h->cv_fill );
+        if( frame->status )
+            break;
     }
+    h->b_reading = 0;
+    x264_pthread_cond_broadcast( &h->cv_fill );
+    x264_pthread_mutex_unlock( &h->mutex );
+    return NULL;
+}
 
-    if( h->next_frame == i_frame )
-        XCHG( cli_pic_t, *p_pic, h->pic );
-    else
+/* Must be called with the mutex held. */
+static void stop_reading( thread_hnd_t *h )
+{
+    if( h->b_job )
     {
-        if( h->next_frame >= 0 )
-            thread_input.release_frame( &h->pic, handle );
-        ret |= h->input.read_frame( p_pic, h->p_handle, i_frame );
+        h->b_stop = 1;
+        x264_pthread_cond_broadcast( &h->cv_empty );
+        x264_pthread_mutex_unlock( &h->mutex );
+        x264_threadpool_wait( h->pool, h );
+        x264_pthread_mutex_lock( &h->mutex );
+        h->b_stop = 0;
+        h->b_job = 0;
     }
+}
+
+/* Must be called with the mutex held. */
+static void drop_frame( thread_hnd_t *h )
+{
+    thread_frame_t *frame = &h->frames[h->i_head];
+    if( !frame->status && h->input.release_frame )
+        h->input.release_frame( &frame->pic, h->p_handle );
+    h->i_head = (h->i_head + 1) % h->depth;
+    h->i_size--;
+    x264_pthread_cond_signal( &h->cv_empty );
+}
 
-    if( !h->frame_total || i_frame+1 < h->frame_total )
+static int read_frame( cli_pic_t *p_pic, hnd_t handle, int i_frame )
+{
+    thread_hnd_t *h = handle;
+    int ret;
+
+    x264_pthread_mutex_lock( &h->mutex );
+    while( 1 )
     {
-        h->next_frame =
-        h->next_args->i_frame = i_frame+1;
-        h->next_args->pic = &h->pic;
-        x264_threadpool_run( h->pool, (void*)read_frame_thread_int, h->next_args );
+        /* skip frames that were read ahead but not asked for */
+        while( h->i_size && h->frames[h->i_head].i_frame < i_frame )
+            drop_frame( h );
+
+        if( h->i_size && h->frames[h->i_head].i_frame == i_frame )
+        {
+            thread_frame_t *frame = &h->frames[h->i_head];
+            XCHG( cli_pic_t, *p_pic, frame->pic );
+            ret = frame->status;
+            h->i_frames_read++;
+            h->i_read_time += frame->i_read_time;
+            h->i_max_read_time = X264_MAX( h->i_max_read_time, frame->i_read_time );
+            h->i_head = (h->i_head + 1) % h->depth;
+            h->i_size--;
+            x264_pthread_cond_signal( &h->cv_empty );
+            break;
+        }
+
+        if( !h->i_size && h->b_reading && h->next_read <= i_frame )
+        {
+            int64_t start = x264_mdate();
+            h->i_waits++;
+            while( !h->i_size && h->b_reading )
+                x264_pthread_cond_wait( &h->cv_fill, &h->mutex );
+            h->i_wait_time += x264_mdate() - start;
+            continue;
+        }
+
+        /* The frame is not coming from the queue (first frame, seek or end of input):
+         * read it here and start reading ahead after it. */
+        stop_reading( h );
+        while( h->i_size )
+            drop_frame( h );
+        x264_pthread_mutex_unlock( &h->mutex );
+        ret = h->input.read_frame( p_pic, h->p_handle, i_frame );
+        x264_pthread_mutex_lock( &h->mutex );
+        if( !ret && (!h->frame_total || i_frame+1 < h->frame_total) )
+        {
+            h->next_read = i_frame+1;
+            h->b_reading = 1;
+            h->b_job = 1;
+            x264_threadpool_run( h->pool, (void*)read_frames, h );
+        }
+        break;
     }
-    else
-        h->next_frame = -1;
+    x264_pthread_mutex_unlock( &h->mutex );
 
     return ret;
 }
@@ -118,12 +233,28 @@ static int release_frame( cli_pic_t *pic, hnd_t handle )
 static int close_file( hnd_t handle )
 {
     thread_hnd_t *h = handle;
+    x264_pthread_mutex_lock( &h->mutex );
+    stop_reading( h );
+    while( h->i_size )
+        drop_frame( h );
+    x264_pthread_mutex_unlock( &h->mutex );
     x264_threadpool_delete( h->pool );
+
+    if( h->i_frames_read )
+        x264_cli_log( "thread", h->i_waits > 1 ? X264_LOG_INFO : X264_LOG_DEBUG,
+                      "read-ahead %d: read avg %.2f ms max %.2f ms, encoder waited %d times (%.1f ms), queue full %d times\n",
+                      h->depth, h->i_read_time / 1000.0 / h->i_frames_read, h->i_max_read_time / 1000.0,
+                      h->i_waits, h->i_wait_time / 1000.0, h->i_full );
+
+    for( int i = 0; i < h->depth; i++ )
+        h->input.picture_clean( &h->frames[i].pic, h->p_handle );
     h->input.close_file( h->p_handle );
-    h->input.picture_clean( &h->pic );
-    free( h->next_args );
+    x264_pthread_mutex_destroy( &h->mutex );
+    x264_pthread_cond_destroy( &h->cv_fill );
+    x264_pthread_cond_destroy( &h->cv_empty );
+    free( h->frames );
     free( h );
     return 0;
 }
 
-cli_input_t thread_input = { open_file, NULL, read_frame, release_frame, NULL, close_file };
+const cli_input_t thread_input = { open_file, picture_alloc, read_frame, release_frame, picture_clean, close_file };
@@ -36,6 +36,10 @@ typedef struct
     uint64_t frame_size;
     uint64_t plane_size[3];
     int bit_depth;
+    cli_mmap_t mmap;
+    int use_mmap;
+    int zero_copy;     /* planes point straight into the mapped file */
+    int64_t frame_pos; /* file offset of the next frame header when mapped */
 } y4m_hnd_t;
 
 #define Y4M_MAGIC "YUV4MPEG2"
@@ -64,7 +68,7 @@ static int parse_csp_and_depth( char *csp_name, int *bit_depth )
 
 static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, cli_input_opt_t *opt )
 {
-    y4m_hnd_t *h = malloc( sizeof(y4m_hnd_t) );
+    y4m_hnd_t *h = calloc( 1, sizeof(y4m_hnd_t) );
     int i;
     uint32_t n, d;
     char header[MAX_YUV4_HEADER+10];
@@ -217,21 +221,40 @@ static int open_file( char *psz_filename, hnd_t *p_handle, video_info_t *info, c
         uint64_t i_size = ftell( h->fh );
         fseek( h->fh, init_pos, SEEK_SET );
         info->num_frames = (i_size - h->seq_header_len) / h->frame_size;
+        h->use_mmap = !x264_cli_mmap_init( &h->mmap, h->fh );
+        h->frame_pos = h->seq_header_len;
+        /* Planes are only used in place at 8-bit: other depths are upconverted in place,
+         * and 16-bit samples would not be aligned after an odd-length frame header. */
+        h->zero_copy = h->use_mmap && h->bit_depth == 8;
     }
 
     *p_handle = h;
     return 0;
 }
 
+static int picture_alloc( cli_pic_t *pic, hnd_t handle, int csp, int width, int height )
+{
+    y4m_hnd_t *h = handle;
+    return (h->zero_copy ? x264_cli_pic_init_noalloc : x264_cli_pic_alloc)( pic, csp, width, height );
+}
+
 static int read_frame_internal( cli_pic_t *pic, y4m_hnd_t *h, int bit_depth_uc )
 {
     size_t slen = strlen( Y4M_FRAME_MAGIC );
     int pixel_depth = x264_cli_csp_depth_factor( pic->img.csp );
     int i = 0;
     char header[16];
+    uint8_t *frame = NULL;
 
     /* Read frame header - without terminating '\n' */
-    if( fread( header, 1, slen, h->fh ) != slen )
+    if( h->use_mmap )
+    {
+        int64_t header_size = X264_MIN( h->mmap.file_size - h->frame_pos, (int64_t)slen + MAX_FRAME_HEADER );
+        if( header_size < (int64_t)slen || !(frame = x264_cli_mmap( &h->mmap, h->frame_pos, header_size )) )
+            return -1;
+        memcpy( header, frame, slen );
+    }
+    else if( fread( header, 1, slen, h->fh ) != slen )
         return -1;
 
     header[slen] = 0;
@@ -239,16 +262,41 @@ static int read_frame_internal( cli_pic_t *pic, y4m_hnd_t *h, int bit_depth_uc )
                    M32(header), header )
 
     /* Skip most of it */
-    while( i < MAX_FRAME_HEADER && fgetc( h->fh ) != '\n' )
-        i++;
+    if( h->use_mmap )
+    {
+        int64_t header_size = X264_MIN( h->mmap.file_size - h->frame_pos - (int64_t)slen, MAX_FRAME_HEADER );
+        while( i < header_size && frame[slen+i] != '\n' )
+            i++;
+        if( i == header_size )
+            i = MAX_FRAME_HEADER;
+    }
+    else
+        while( i < MAX_FRAME_HEADER && fgetc( h->fh ) != '\n' )
+            i++;
     FAIL_IF_ERROR( i == MAX_FRAME_HEADER, "bad frame header!\n" )
     h->frame_size = h->frame_size - h->frame_header_len + i+slen+1;
     h->frame_header_len = i+slen+1;
 
+    uint8_t *src = NULL;
+    if( h->use_mmap )
+    {
+        frame = x264_cli_mmap( &h->mmap, h->frame_pos, h->frame_size );
+        if( !frame )
+            return -1;
+        src = frame + h->frame_header_len;
+        h->frame_pos += h->frame_size;
+    }
+
     int error = 0;
     for( i = 0; i < pic->img.planes && !error; i++ )
     {
-        error |= fread( pic->img.plane[i], pixel_depth, h->plane_size[i], h->fh ) != h->plane_size[i];
+        if( h->zero_copy )
+            pic->img.plane[i] = src;
+        else if( h->use_mmap )
+            memcpy( pic->img.plane[i], src, pixel_depth * h->plane_size[i] );
+        else
+            error |= fread( pic->img.plane[i], pixel_depth, h->plane_size[i], h->fh ) != h->plane_size[i];
+        src += pixel_depth * h->plane_size[i];
         if( bit_depth_uc )
         {
             /* upconvert non 16bit high depth planes to 16bit using the same
@@ -260,6 +308,9 @@ static int read_frame_internal( cli_pic_t *pic, y4m_hnd_t *h, int bit_depth_uc )
                 plane[j] = plane[j] << lshift;
         }
     }
+    /* the frame has been copied out of the mapping, it is no longer needed */
+    if( frame && !h->zero_copy )
+        x264_cli_munmap( &h->mmap, frame, h->frame_size );
     return error;
 }
 
@@ -269,7 +320,9 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
 
     if( i_frame > h->next_frame )
     {
-        if( x264_is_regular_file( h->fh ) )
+        if( h->use_mmap )
+            h->frame_pos = h->frame_size * i_frame + h->seq_header_len;
+        else if( x264_is_regular_file( h->fh ) )
             fseek( h->fh, h->frame_size * i_frame + h->seq_header_len, SEEK_SET );
         else
             while( i_frame > h->next_frame )
@@ -287,14 +340,33 @@ static int read_frame( cli_pic_t *pic, hnd_t handle, int i_frame )
     return 0;
 }
 
+static int release_frame( cli_pic_t *pic, hnd_t handle )
+{
+    y4m_hnd_t *h = handle;
+    if( h->zero_copy )
+        x264_cli_munmap( &h->mmap, pic->img.plane[0], h->frame_size - h->frame_header_len );
+    return 0;
+}
+
+static void picture_clean( cli_pic_t *pic, hnd_t handle )
+{
+    y4m_hnd_t *h = handle;
+    if( h->zero_copy )
+        memset( pic, 0, sizeof(cli_pic_t) );
+    else
+        x264_cli_pic_clean( pic );
+}
+
 static int close_file( hnd_t handle )
 {
     y4m_hnd_t *h = handle;
     if( !h || !h->fh )
         return 0;
+    if( h->use_mmap )
+        x264_cli_mmap_close( &h->mmap );
     fclose( h->fh );
     free( h );
     return 0;
 }
 
-const cli_input_t y4m_input = { open_file, x264_cli_pic_alloc, read_frame, NULL, x264_cli_pic_clean, close_file };
+const cli_input_t y4m_input = { open_file, picture_alloc, read_frame, release_frame, picture_clean, close_file };
@@ -173,6 +173,7 @@ static void print_bench(void)
                 continue;
             printf( "%s_%s%s: %"PRId64"\n", benchs[i].name,
 #if HAVE_MMX
+                    b->cpu&X264_CPU_AVX512 ? "avx512" :
                     b->cpu&X264_CPU_AVX2 ? "avx2" :
                     b->cpu&X264_CPU_FMA3 ? "fma3" :
                     b->cpu&X264_CPU_FMA4 ? "fma4" :
@@ -1443,6 +1444,110 @@ static int check_mc( int cpu_ref, int cpu_new )
         }
     }
 
+    if( mc_a.plane_copy_lshift != mc_ref.plane_copy_lshift )
+    {
+        set_func_name( "plane_copy_lshift" );
+        used_asm = 1;
+        for( int i = 0; i < sizeof(plane_specs)/sizeof(*plane_specs); i++ )
+        {
+            int w = (plane_specs[i].w + 1) >> 1;
+            int h = plane_specs[i].h;
+            int shift = i % 9;
+            intptr_t src_stride = plane_specs[i].src_stride;
+            intptr_t dst_stride = (w + 63) & ~31;
+            assert( dst_stride * h * sizeof(uint16_t) <= 0x1000*sizeof(pixel) );
+            uint8_t *src1 = (uint8_t*)pbuf1 + X264_MAX(0, -src_stride) * (h-1);
+            uint16_t *dst_c = (uint16_t*)pbuf3;
+            uint16_t *dst_a = (uint16_t*)pbuf4;
+            memset( pbuf3, 0, 0x1000*sizeof(pixel) );
+            memset( pbuf4, 0, 0x1000*sizeof(pixel) );
+            call_c( mc_c.plane_copy_lshift, dst_c, dst_stride, src1, src_stride, w, h, shift );
+            call_a( mc_a.plane_copy_lshift, dst_a, dst_stride, src1, src_stride, w, h, shift );
+            for( int y = 0; y < h; y++ )
+                if( memcmp( dst_c+y*dst_stride, dst_a+y*dst_stride, w*sizeof(uint16_t) ) )
+                {
+                    ok = 0;
+                    fprintf( stderr, "plane_copy_lshift FAILED: w=%d h=%d stride=%d shift=%d\n", w, h, (int)src_stride, shift );
+                    break;
+                }
+        }
+    }
+
+    /* random filters with coefficients summing to 1<<14, as the resize filter builds them */
+#define SCALE_INIT_COEF( coef, taps, n )\
+    for( int k = 0; k < (n); k++ )\
+    {\
+        int sum = 0;\
+        for( int t = 0; t < (taps)-1; t++ )\
+            sum += (coef)[k*(taps)+t] = (rand() & 511) - 256;\
+        (coef)[k*(taps)+(taps)-1] = (1<<14) - sum;\
+    }
+
+#define TEST_SCALE_H( bits )\
+    if( mc_a.scale_h_##bits != mc_ref.scale_h_##bits )\
+    {\
+        static const int taps_list[] = { 6, 8, 16, 24 };\
+        static const int width_list[] = { 3, 17, 61, 64 };\
+        ALIGNED_16( int16_t coef[64*24] );\
+        ALIGNED_16( int pos[64] );\
+        set_func_name( "scale_h_%d", bits );\
+        used_asm = 1;\
+        for( int i = 0; i < 4; i++ )\
+            for( int j = 0; j < 4; j++ )\
+            {\
+                int taps = taps_list[i];\
+                int width = width_list[j];\
+                int16_t *dst_c = (int16_t*)pbuf3;\
+                int16_t *dst_a = (int16_t*)pbuf4;\
+                SCALE_INIT_COEF( coef, taps, width );\
+                for( int x = 0; x < width; x++ )\
+                    pos[x] = rand() % (257 - taps);\
+                memset( pbuf3, 0, 0x1000*sizeof(pixel) );\
+                memset( pbuf4, 0, 0x1000*sizeof(pixel) );\
+                call_c( mc_c.scale_h_##bits, dst_c, (uint##bits##_t*)pbuf1, coef, pos, taps, width );\
+                call_a( mc_a.scale_h_##bits, dst_a, (uint##bits##_t*)pbuf1, coef, pos, taps, width );\
+                if( memcmp( dst_c, dst_a, width*sizeof(int16_t) ) )\
+                {\
+                    ok = 0;\
+                    fprintf( stderr, "scale_h_%d FAILED: taps=%d width=%d\n", bits, taps, width );\
+                }\
+            }\
+    }
+
+#define TEST_SCALE_V( bits )\
+    if( mc_a.scale_v_##bits != mc_ref.scale_v_##bits )\
+    {\
+        static const int width_list[] = { 5, 8, 16, 17, 33, 100 };\
+        ALIGNED_16( int16_t coef[8] );\
+        int16_t *rows[8];\
+        set_func_name( "scale_v_%d", bits );\
+        used_asm = 1;\
+        for( int taps = 2; taps <= 8; taps += 2 )\
+            for( int j = 0; j < 6; j++ )\
+            {\
+                int width = width_list[j];\
+                uint##bits##_t *dst_c = (uint##bits##_t*)pbuf3;\
+                uint##bits##_t *dst_a = (uint##bits##_t*)pbuf4;\
+                SCALE_INIT_COEF( coef, taps, 1 );\
+                for( int t = 0; t < taps; t++ )\
+                    rows[t] = (int16_t*)pbuf1 + (rand() % (0x700/sizeof(int16_t) - width));\
+                memset( pbuf3, 0, 0x1000*sizeof(pixel) );\
+                memset( pbuf4, 0, 0x1000*sizeof(pixel) );\
+                call_c( mc_c.scale_v_##bits, dst_c, rows, coef, taps, width );\
+                call_a( mc_a.scale_v_##bits, dst_a, rows, coef, taps, width );\
+                if( memcmp( dst_c, dst_a, width*sizeof(uint##bits##_t) ) )\
+                {\
+                    ok = 0;\
+                    fprintf( stderr, "scale_v_%d FAILED: taps=%d width=%d\n", bits, taps, width );\
+                }\
+            }\
+    }
+
+    TEST_SCALE_H( 8 );
+    TEST_SCALE_H( 16 );
+    TEST_SCALE_V( 8 );
+    TEST_SCALE_V( 16 );
+
     if( mc_a.plane_copy_interleave != mc_ref.plane_copy_interleave )
     {
         set_func_name( "plane_copy_interleave" );
@@ -2762,6 +2867,8 @@ static int check_all_flags( void )
             cpu1 &= ~X264_CPU_LZCNT;
         }
     }
+    if( cpu_detect & X264_CPU_AVX512 )
+        ret |= add_flags( &cpu0, &cpu1, X264_CPU_AVX512, "AVX512" );
     if( cpu_detect & X264_CPU_BMI1 )
     {
         ret |= add_flags( &cpu0, &cpu1, X264_CPU_BMI1, "BMI1" );
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+#
+# stats_convert.py: convert x264 2-pass stats between the text and binary formats
+#
+# usage: stats_convert.py <input stats> <output stats>
+#
+# The format of the input is detected; the output is written in the other one.
+# Binary stats are in native byte order, like the files written by --stats-binary.
+# The layout must match stats_header_t and stats_record_t in encoder/ratecontrol.c.
+
+import re
+import struct
+import sys
+
+MAGIC = b"x264stat"
+VERSION = 1
+HEADER = struct.Struct("=8siiii")
+RECORD = struct.Struct("=qqiiffiiiiii16i2h6hBBB5x")
+
+ENTRY = re.compile(r"\s*in:(-?\d+) out:(-?\d+) type:(.) dur:(-?\d+) cpbdur:(-?\d+) q:(\S+) aq:(\S+) "
+                   r"tex:(-?\d+) mv:(-?\d+) misc:(-?\d+) imb:(-?\d+) pmb:(-?\d+) smb:(-?\d+) d:(.) ref:([-\d ]*)(?:w:([-\d,]+))?")
+
+def read_text(data):
+    text = data.decode("ascii")
+    header, _, body = text.partition("\n")
+    if not header.startswith("#options: "):
+        sys.exit("options list in stats file not valid")
+    records = []
+    for i, entry in enumerate(body.split(";")[:-1]):
+        m = ENTRY.match(entry)
+        if not m:
+            sys.exit("statistics are damaged at line %d" % i)
+        g = m.groups()
+        refcount = [int(r) for r in g[14].split()][:16]
+        denom = [-1, -1]
+        weight = [0] * 6
+        if g[15]:
+            w = [int(v) for v in g[15].split(",")]
+            if len(w) >= 3:
+                denom[0], weight[0], weight[1] = w[0:3]
+            if len(w) == 8:
+                denom[1], weight[2], weight[3], weight[4], weight[5] = w[3:8]
+        records.append(RECORD.pack(int(g[3]), int(g[4]), int(g[0]), int(g[1]), float(g[5]), float(g[6]),
+                                   *([int(v) for v in g[7:13]] + refcount + [0] * (16 - len(refcount)) + denom + weight +
+                                     [ord(g[2]), ord(g[13]), len(refcount)])))
+    return header[len("#options: "):], records
+
+def write_binary(options, records):
+    options = options.encode("ascii")
+    size = (len(options) + 8) & ~7
+    return HEADER.pack(MAGIC, VERSION, RECORD.size, size, 0) + options + b"\0" * (size - len(options)) + b"".join(records)
+
+def read_binary(data):
+    magic, version, record_size, options_size, _ = HEADER.unpack_from(data)
+    if version != VERSION or record_size != RECORD.size:
+        sys.exit("binary stats file version %d is not supported" % version)
+    options = data[HEADER.size:HEADER.size + options_size].split(b"\0")[0].decode("ascii")
+    start = HEADER.size + options_size
+    count = (len(data) - start) // RECORD.size
+    return options, [RECORD.unpack_from(data, start + i * RECORD.size) for i in range(count)]
+
+def write_text(options, records):
+    lines = ["#options: %s\n" % options]
+    for r in records:
+        dur, cpbdur, frame, coded, qp_rc, qp_aq = r[0:6]
+        tex, mv, misc, imb, pmb, smb = r[6:12]
+        refcount = r[12:28]
+        denom = r[28:30]
+        weight = r[30:36]
+        c_type, c_direct, refs = r[36:39]
+        line = "in:%d out:%d type:%c dur:%d cpbdur:%d q:%.2f aq:%.2f tex:%d mv:%d misc:%d imb:%d pmb:%d smb:%d d:%c ref:" % \
+               (frame, coded, c_type, dur, cpbdur, qp_rc, qp_aq, tex, mv, misc, imb, pmb, smb, c_direct)
+        line += "".join("%d " % c for c in refcount[:refs])
+        if denom[0] >= 0:
+            line += "w:%d,%d,%d" % (denom[0], weight[0], weight[1])
+            if denom[1] >= 0:
+                line += ",%d,%d,%d,%d,%d " % (denom[1], weight[2], weight[3], weight[4], weight[5])
+            else:
+                line += " "
+        lines.append(line + ";\n")
+    return "".join(lines).encode("ascii")
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: %s <input stats> <output stats>" % sys.argv[0])
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    if data[:len(MAGIC)] == MAGIC:
+        output = write_text(*read_binary(data))
+    else:
+        output = write_binary(*read_text(data))
+    with open(sys.argv[2], "wb") as f:
+        f.write(output)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+#
+# stats_merge.py: merge the 2-pass stats of 1st passes run on consecutive chunks
+#
+# usage: stats_merge.py <output stats> <chunk stats>...
+#
+# The chunks must be given in order, and each must start with an IDR frame.
+# Frame numbers are offset so the merged stats describe the whole video, and the
+# MB-tree files (<stats>.mbtree) are concatenated when present.  The merged stats
+# are written in the format of the first chunk; the 2nd pass can then encode the
+# whole video, or each chunk separately with --chunk-start.
+
+import os
+import sys
+
+import stats_convert
+
+def read_stats(name):
+    with open(name, "rb") as f:
+        data = f.read()
+    if data[:len(stats_convert.MAGIC)] == stats_convert.MAGIC:
+        return True, stats_convert.read_binary(data)
+    return False, stats_convert.read_text(data)
+
+def offset_record(record, offset):
+    record = list(record)
+    record[2] += offset
+    record[3] += offset
+    return stats_convert.RECORD.pack(*record)
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("usage: %s <output stats> <chunk stats>..." % sys.argv[0])
+
+    binary = None
+    options = None
+    records = []
+    for name in sys.argv[2:]:
+        b, (o, r) = read_stats(name)
+        if binary is None:
+            binary, options = b, o
+        elif o != options:
+            sys.stderr.write("warning: options of `%s' differ from those of the first chunk\n" % name)
+        if not b:
+            r = [stats_convert.RECORD.unpack(x) for x in r]
+        if r and chr(min(r, key=lambda x: x[3])[36]) != "I":
+            sys.exit("`%s' doesn't start with an IDR frame" % name)
+        offset = len(records)
+        records += [offset_record(x, offset) for x in r]
+
+    if binary:
+        output = stats_convert.write_binary(options, records)
+    else:
+        output = stats_convert.write_text(options, [stats_convert.RECORD.unpack(x) for x in records])
+    with open(sys.argv[1], "wb") as f:
+        f.write(output)
+
+    mbtree = [name + ".mbtree" for name in sys.argv[2:]]
+    if all(os.path.exists(name) for name in mbtree):
+        with open(sys.argv[1] + ".mbtree", "wb") as out:
+            for name in mbtree:
+                with open(name, "rb") as f:
+                    out.write(f.read())
+    elif any(os.path.exists(name) for name in mbtree):
+        sys.exit("some chunks have no MB-tree stats")
+
+if __name__ == "__main__":
+    main()
@@ -45,6 +45,7 @@
 #include "input/input.h"
 #include "output/output.h"
 #include "filters/filters.h"
+#include "filters/video/internal.h"
 
 #define FAIL_IF_ERROR( cond, ... ) FAIL_IF_ERR( cond, "x264", __VA_ARGS__ )
 
@@ -147,6 +148,44 @@ static void sigint_handler( int a )
     b_ctrl_c = 1;
 }
 
+#define MAX_LADDER_RUNGS 8
+
+/* A lower rung of an ABR ladder: its own resize of the top rung's frames,
+ * encoder and output file. */
+typedef struct
+{
+    char *psz_output;
+    hnd_t hin;
+    cli_vid_filter_t filter;
+    hnd_t hout;
+    x264_t *h;
+    x264_param_t param;
+    int i_csp;
+    int64_t i_file;
+    int     i_frame_output;
+    int64_t last_dts;
+} ladder_rung_t;
+
+typedef struct
+{
+    cli_pic_t pic[MAX_LADDER_RUNGS];
+    int64_t i_pts;
+    int     i_pic_struct;
+    int     i_type; /* X264_TYPE_AUTO until the top rung has output the frame */
+} ladder_frame_t;
+
+typedef struct
+{
+    int i_rungs;
+    ladder_rung_t rung[MAX_LADDER_RUNGS];
+    cli_pic_t *source; /* frame of the top rung being fanned out */
+    /* frames waiting for the top rung's frame type decision, in display order */
+    ladder_frame_t *frames;
+    int i_max_frames;
+    int i_head;
+    int i_size;
+} cli_ladder_t;
+
 typedef struct {
     int b_progress;
     int i_seek;
@@ -156,6 +195,7 @@ typedef struct {
     FILE *tcfile_out;
     double timebase_convert_multiplier;
     int i_pulldown;
+    cli_ladder_t *ladder;
 } cli_opt_t;
 
 /* file i/o operation structs */
@@ -263,6 +303,7 @@ static const float pulldown_frame_duration[10] = { 0.0, 1, 0.5, 0.5, 1, 1, 1.5,
 static void help( x264_param_t *defaults, int longhelp );
 static int  parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt );
 static int  encode( x264_param_t *param, cli_opt_t *opt, int argc, char **argv );
+static void ladder_free( cli_ladder_t *ladder );
 
 /* logging and printing for within the cli system */
 static int cli_log_level;
@@ -389,6 +430,8 @@ int main( int argc, char **argv )
         cli_input.close_file( opt.hin );
     if( opt.hout )
         cli_output.close_file( opt.hout, 0, 0 );
+    if( opt.ladder )
+        ladder_free( opt.ladder );
     if( opt.tcfile_out )
         fclose( opt.tcfile_out );
     if( opt.qpfile )
@@ -746,6 +789,16 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - 2: Last pass, does not overwrite stats file\n" );
     H2( "                                  - 3: Nth pass, overwrites stats file\n" );
     H1( "      --stats <string>        Filename for 2 pass stats [\"%s\"]\n", defaults->rc.psz_stat_out );
+    H2( "      --stats-binary          Write the stats file in the binary format, which\n"
+        "                              the next pass reads much faster.\n"
+        "                              tools/stats_convert.py converts between formats\n" );
+    H2( "      --chunk-start <integer> 2nd pass: encode the chunk of the stats starting\n"
+        "                              at this frame, for --frames frames, with\n"
+        "                              --seek set to the same frame.  Chunks must\n"
+        "                              start at IDR frames, and keep the bitrate\n"
+        "                              and VBV plan of the whole 1st pass.  Use with\n"
+        "                              --stitchable; tools/stats_merge.py merges the\n"
+        "                              stats of 1st passes run on chunks\n" );
     H2( "      --no-mbtree             Disable mb-tree ratecontrol.\n");
     H2( "      --qcomp <float>         QP curve compression [%.2f]\n", defaults->rc.f_qcompress );
     H2( "      --cplxblur <float>      Reduce fluctuations in QP (before curve compression) [%.1f]\n", defaults->rc.f_complexity_blur );
@@ -782,7 +835,9 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - hex: hexagonal search, radius 2\n"
         "                                  - umh: uneven multi-hexagon search\n"
         "                                  - esa: exhaustive search\n"
-        "                                  - tesa: hadamard exhaustive search (slow)\n" );
+        "                                  - tesa: hadamard exhaustive search (slow)\n"
+        "                                  - pyr: coarse-to-fine search from the\n"
+        "                                         lookahead's lowres vectors\n" );
     else H1( "                                  - dia, hex, umh\n" );
     H2( "      --merange <integer>     Maximum motion vector search range [%d]\n", defaults->analyse.i_me_range );
     H2( "      --mvrange <integer>     Maximum motion vector length [-1 (auto)]\n" );
@@ -806,6 +861,11 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --no-psy                Disable all visual optimizations that worsen\n"
         "                              both PSNR and SSIM.\n" );
     H2( "      --no-mixed-refs         Don't decide references on a per partition basis\n" );
+    H2( "      --me-multiref           Rank the references of 16x16 searches in P-frames\n"
+        "                              and B-frame list 0 by their cost at the predicted\n"
+        "                              mv, then search the best first and skip the\n"
+        "                              unlikely ones.\n"
+        "                              Speeds up high --ref.  Ignored with subme 11\n" );
     H2( "      --no-chroma-me          Ignore chroma in motion estimation\n" );
     H1( "      --no-8x8dct             Disable adaptive spatial transform size\n" );
     H1( "  -t, --trellis <integer>     Trellis RD quantization. [%d]\n"
@@ -813,6 +873,9 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - 1: enabled only on the final encode of a MB\n"
         "                                  - 2: enabled on all mode decisions\n", defaults->analyse.i_trellis );
     H2( "      --no-fast-pskip         Disables early SKIP detection on P-frames\n" );
+    H2( "      --adaptive-partitions   Skip P-frame sub-16x16 partition searches in\n"
+        "                              contexts where they have rarely been chosen\n"
+        "                              so far.  Ignored with subme 11\n" );
     H2( "      --no-dct-decimate       Disables coefficient thresholding on P-frames\n" );
     H1( "      --nr <integer>          Noise reduction [%d]\n", defaults->analyse.i_noise_reduction );
     H2( "\n" );
@@ -897,6 +960,18 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - 50, 100, 200\n" );
     H1( "      --stitchable            Don't optimize headers based on video content\n"
         "                              Ensures ability to recombine a segmented encode\n" );
+    H1( "      --ladder <string>       Also encode lower resolutions from the same input:\n"
+        "                                  <width>x<height>[:<kbit/s>][,...]\n"
+        "                              Each rung is written to <output>_<width>x<height>\n"
+        "                              and follows the frame types of the main encode\n" );
+    H1( "      --analysis-save <string> Save the mode, reference and mv of every macroblock\n" );
+    H1( "      --analysis-load <string> Seed the P-frame motion search from a saved analysis\n"
+        "                              of the same input, at any resolution\n" );
+    H1( "      --lookahead-save <string> Save the frame types and lookahead costs\n" );
+    H1( "      --lookahead-load <string> Take frame types and costs from a saved lookahead\n"
+        "                              of the same input instead of running the lookahead\n"
+        "                              Same output as the save with the same settings,\n"
+        "                              except --me pyr with B-frames\n" );
     H1( "\n" );
     H1( "  -v, --verbose               Print stats for each frame\n" );
     H1( "      --no-progress           Don't show the progress indicator while encoding\n" );
@@ -910,7 +985,15 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --lookahead-threads <integer> Force a specific number of lookahead threads\n" );
     H2( "      --sliced-threads        Low-latency but lower-efficiency threading\n" );
     H2( "      --thread-input          Run Avisynth in its own thread\n" );
+    H2( "      --read-ahead <integer>  Number of frames the threaded input reads ahead [auto]\n"
+        "                                  - lavf and ffms input is only threaded when\n"
+        "                                    this is given, and then copies each frame\n" );
+    H2( "      --filter-queue <integer> Run resize and depth conversion in their own threads,\n"
+        "                              queueing this many frames after each [auto, 0 = off]\n" );
     H2( "      --sync-lookahead <integer> Number of buffer frames for threaded lookahead\n" );
+    H2( "      --frame-pool-budget <integer> Max MiB of idle frame buffers kept for reuse [0 = unlimited]\n" );
+    H2( "      --huge-pages            Use explicit huge pages for frame buffers when available\n" );
+    H2( "      --numa-node <integer>   Run threads and allocate frame buffers on this NUMA node\n" );
     H2( "      --non-deterministic     Slightly improve quality of SMP, at the cost of repeatability\n" );
     H2( "      --cpu-independent       Ensure exact reproducibility across different cpus,\n"
         "                                  as opposed to letting them select different algorithms\n" );
@@ -941,7 +1024,8 @@ static void help( x264_param_t *defaults, int longhelp )
     x264_vid_filter_help( longhelp );
     H0( "\n" );
     H1( "       --csv <string>          Comma separated log file(csv file) per frame \n" );
-    H1( "       --csv-log-level <integer> Level of csv logging, if csv-log-level > 0 frame level statistics \n" );
+    H1( "       --csv-log-level <integer> Level of csv logging, if csv-log-level > 0 frame level statistics \n"
+        "                                  if csv-log-level > 1 also per-stage timings (ms) \n" );
     H0( "\n" );
 }
 
@@ -977,7 +1061,10 @@ typedef enum
     OPT_DTS_COMPRESSION,
     OPT_OUTPUT_CSP,
     OPT_INPUT_RANGE,
-    OPT_RANGE
+    OPT_RANGE,
+    OPT_READ_AHEAD,
+    OPT_FILTER_QUEUE,
+    OPT_LADDER
 } OptionsOPT;
 
 static char short_options[] = "8A:B:b:f:hI:i:m:o:p:q:r:t:Vvw";
@@ -1054,12 +1141,14 @@ static struct option long_options[] =
     { "psy",               no_argument, NULL, 0 },
     { "mixed-refs",        no_argument, NULL, 0 },
     { "no-mixed-refs",     no_argument, NULL, 0 },
+    { "me-multiref",       no_argument, NULL, 0 },
     { "no-chroma-me",      no_argument, NULL, 0 },
     { "8x8dct",            no_argument, NULL, '8' },
     { "no-8x8dct",         no_argument, NULL, 0 },
     { "trellis",     required_argument, NULL, 't' },
     { "fast-pskip",        no_argument, NULL, 0 },
     { "no-fast-pskip",     no_argument, NULL, 0 },
+    { "adaptive-partitions", no_argument, NULL, 0 },
     { "no-dct-decimate",   no_argument, NULL, 0 },
     { "aq-strength", required_argument, NULL, 0 },
     { "aq-mode",     required_argument, NULL, 0 },
@@ -1076,6 +1165,8 @@ static struct option long_options[] =
     { "chroma-qp-offset", required_argument, NULL, 0 },
     { "pass",        required_argument, NULL, 'p' },
     { "stats",       required_argument, NULL, 0 },
+    { "stats-binary",      no_argument, NULL, 0 },
+    { "chunk-start", required_argument, NULL, 0 },
     { "qcomp",       required_argument, NULL, 0 },
     { "mbtree",            no_argument, NULL, 0 },
     { "no-mbtree",         no_argument, NULL, 0 },
@@ -1093,7 +1184,17 @@ static struct option long_options[] =
     { "slices",            required_argument, NULL, 0 },
     { "slices-max",        required_argument, NULL, 0 },
     { "thread-input",      no_argument, NULL, OPT_THREAD_INPUT },
+    { "read-ahead",        required_argument, NULL, OPT_READ_AHEAD },
+    { "filter-queue",      required_argument, NULL, OPT_FILTER_QUEUE },
+    { "ladder",            required_argument, NULL, OPT_LADDER },
+    { "analysis-save",     required_argument, NULL, 0 },
+    { "analysis-load",     required_argument, NULL, 0 },
+    { "lookahead-save",    required_argument, NULL, 0 },
+    { "lookahead-load",    required_argument, NULL, 0 },
     { "sync-lookahead",    required_argument, NULL, 0 },
+    { "frame-pool-budget", required_argument, NULL, 0 },
+    { "huge-pages",        no_argument, NULL, 0 },
+    { "numa-node",         required_argument, NULL, 0 },
     { "non-deterministic", no_argument, NULL, 0 },
     { "cpu-independent",   no_argument, NULL, 0 },
     { "psnr",              no_argument, NULL, 0 },
@@ -1267,14 +1368,27 @@ static int select_input( const char *demuxer, char *used_demuxer, char *filename
     return 0;
 }
 
-static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info, x264_param_t *param, int output_csp )
+/* Initializes a filter, and if it does the heavy lifting of a resize or a depth
+ * conversion, puts it on a thread of its own behind a queue of frames. */
+static int init_vid_filter_stage( const char *name, hnd_t *handle, video_info_t *info, x264_param_t *param,
+                                  char *opt_string, int queue )
+{
+    hnd_t prev_hnd = *handle;
+    if( x264_init_vid_filter( name, handle, &filter, info, param, opt_string ) )
+        return -1;
+    if( queue > 0 && *handle != prev_hnd && (!strcasecmp( name, "resize" ) || !strcasecmp( name, "depth" )) )
+        return x264_init_vid_filter( "pipe", handle, &filter, info, param, (char*)(intptr_t)queue );
+    return 0;
+}
+
+static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info, x264_param_t *param, int output_csp, int queue )
 {
     x264_register_vid_filters();
 
     /* intialize baseline filters */
     if( x264_init_vid_filter( "source", handle, &filter, info, param, NULL ) ) /* wrap demuxer into a filter */
         return -1;
-    if( x264_init_vid_filter( "resize", handle, &filter, info, param, "normcsp" ) ) /* normalize csps to be of a known/supported format */
+    if( init_vid_filter_stage( "resize", handle, info, param, "normcsp", queue ) ) /* normalize csps to be of a known/supported format */
         return -1;
     if( x264_init_vid_filter( "fix_vfr_pts", handle, &filter, info, param, NULL ) ) /* fix vfr pts */
         return -1;
@@ -1288,7 +1402,7 @@ static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info,
         int name_len = strcspn( p, ":" );
         p[name_len] = 0;
         name_len += name_len != tok_len;
-        if( x264_init_vid_filter( p, handle, &filter, info, param, p + name_len ) )
+        if( init_vid_filter_stage( p, handle, info, param, p + name_len, queue ) )
             return -1;
         p += X264_MIN( tok_len+1, p_len );
     }
@@ -1315,18 +1429,116 @@ static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info,
     if( param->vui.b_fullrange == RANGE_AUTO )
         param->vui.b_fullrange = info->fullrange;
 
-    if( x264_init_vid_filter( "resize", handle, &filter, info, param, NULL ) )
+    if( init_vid_filter_stage( "resize", handle, info, param, NULL, queue ) )
         return -1;
 
     char args[20];
     sprintf( args, "bit_depth=%d", x264_bit_depth );
 
-    if( x264_init_vid_filter( "depth", handle, &filter, info, param, args ) )
+    if( init_vid_filter_stage( "depth", handle, info, param, args, queue ) )
         return -1;
 
     return 0;
 }
 
+/* The lower rungs of a ladder pull the frame of the top rung that is being encoded. */
+static int ladder_get_frame( hnd_t handle, cli_pic_t *output, int frame )
+{
+    cli_ladder_t *ladder = handle;
+    *output = *ladder->source;
+    return 0;
+}
+
+static int ladder_release_frame( hnd_t handle, cli_pic_t *pic, int frame )
+{
+    return 0;
+}
+
+static void ladder_source_free( hnd_t handle )
+{
+}
+
+static const cli_vid_filter_t ladder_source = { "ladder", NULL, NULL, ladder_get_frame, ladder_release_frame, ladder_source_free, NULL };
+
+static int init_ladder( char *sequence, cli_opt_t *opt, x264_param_t *param, video_info_t *info,
+                        const char *output_filename, cli_output_opt_t *output_opt )
+{
+    FAIL_IF_ERROR( param->rc.b_stat_write || param->rc.b_stat_read, "--ladder does not support multipass encoding\n" )
+    cli_ladder_t *ladder = opt->ladder = calloc( 1, sizeof(cli_ladder_t) );
+    FAIL_IF_ERROR( !ladder, "malloc failed\n" )
+
+    const char *ext = strrchr( output_filename, '.' );
+    if( !ext || strchr( ext, '/' ) || strchr( ext, '\\' ) )
+        ext = output_filename + strlen( output_filename );
+    for( char *p = sequence; p && *p; )
+    {
+        int width, height, bitrate = 0;
+        FAIL_IF_ERROR( ladder->i_rungs == MAX_LADDER_RUNGS, "--ladder supports at most %d rungs\n", MAX_LADDER_RUNGS )
+        FAIL_IF_ERROR( sscanf( p, "%dx%d:%d", &width, &height, &bitrate ) < 2 || width <= 0 || height <= 0 || bitrate < 0,
+                       "invalid ladder rung `%s'\n", p )
+        p = strchr( p, ',' );
+        p += !!p;
+
+        ladder_rung_t *rung = &ladder->rung[ladder->i_rungs++];
+        x264_param_t *rp = &rung->param;
+        *rp = *param;
+
+        /* resize the top rung's frames, keeping the display aspect ratio */
+        video_info_t rung_info = *info;
+        char args[64];
+        sprintf( args, "width=%d,height=%d", width, height );
+        rung->hin = ladder;
+        rung->filter = ladder_source;
+        if( x264_init_vid_filter( "resize", &rung->hin, &rung->filter, &rung_info, rp, args ) )
+            return -1;
+        rung->i_csp  = rung_info.csp;
+        rp->i_width  = rung_info.width;
+        rp->i_height = rung_info.height;
+        rp->vui.i_sar_width  = rung_info.sar_width;
+        rp->vui.i_sar_height = rung_info.sar_height;
+
+        /* scale the rate control targets with the bitrate, or with the area if none is given */
+        double ratio = (double)width * height / (param->i_width * param->i_height);
+        if( bitrate )
+        {
+            if( param->rc.i_rc_method == X264_RC_ABR )
+                ratio = (double)bitrate / param->rc.i_bitrate;
+            else if( param->rc.i_vbv_max_bitrate > 0 )
+                ratio = (double)bitrate / param->rc.i_vbv_max_bitrate;
+            rp->rc.i_rc_method = X264_RC_ABR;
+            rp->rc.i_bitrate = bitrate;
+        }
+        else if( param->rc.i_rc_method == X264_RC_ABR )
+            rp->rc.i_bitrate = X264_MAX( param->rc.i_bitrate * ratio, 1 );
+        if( param->rc.i_vbv_max_bitrate > 0 )
+        {
+            rp->rc.i_vbv_max_bitrate = X264_MAX( param->rc.i_vbv_max_bitrate * ratio, 1 );
+            rp->rc.i_vbv_buffer_size = X264_MAX( param->rc.i_vbv_buffer_size * ratio, 1 );
+        }
+
+        /* frame types come from the top rung, so skip deciding them */
+        rp->i_scenecut_threshold = 0;
+        rp->i_bframe_adaptive = X264_B_ADAPT_NONE;
+        rp->i_log_level = X264_MIN( param->i_log_level, X264_LOG_WARNING );
+        rp->psz_dump_yuv = NULL;
+        rp->csv_filename = NULL;
+        rp->psz_analysis_save = NULL;
+        rp->psz_lookahead_save = NULL;
+        rp->psz_lookahead_load = NULL;
+        rp->p_nal_ring = NULL;
+        rp->i_nal_ring_size = 0;
+
+        int name_len = ext - output_filename;
+        rung->psz_output = malloc( strlen( output_filename ) + 32 );
+        FAIL_IF_ERROR( !rung->psz_output, "malloc failed\n" )
+        sprintf( rung->psz_output, "%.*s_%dx%d%s", name_len, output_filename, rp->i_width, rp->i_height, ext );
+        FAIL_IF_ERROR( cli_output.open_file( rung->psz_output, &rung->hout, output_opt ),
+                       "could not open output file `%s'\n", rung->psz_output )
+    }
+    FAIL_IF_ERROR( !ladder->i_rungs, "empty ladder\n" )
+    return 0;
+}
+
 static int parse_enum_name( const char *arg, const char * const *names, const char **dst )
 {
     for( int i = 0; names[i]; i++ )
@@ -1359,6 +1571,7 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
     x264_param_t defaults;
     char *profile = NULL;
     char *vid_filters = NULL;
+    char *ladder = NULL;
     int b_thread_input = 0;
     int b_turbo = 1;
     int b_user_ref = 0;
@@ -1377,6 +1590,7 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
     input_opt.bit_depth = 8;
     input_opt.input_range = input_opt.output_range = param->vui.b_fullrange = RANGE_AUTO;
     int output_csp = defaults.i_csp;
+    int filter_queue = -1;
     opt->b_progress = 1;
 
     /* Presets are applied before all other options. */
@@ -1457,6 +1671,14 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
             case OPT_THREAD_INPUT:
                 b_thread_input = 1;
                 break;
+            case OPT_READ_AHEAD:
+                input_opt.read_ahead = atoi( optarg );
+                FAIL_IF_ERROR( input_opt.read_ahead < 0, "invalid read-ahead depth `%s'\n", optarg )
+                break;
+            case OPT_FILTER_QUEUE:
+                filter_queue = atoi( optarg );
+                FAIL_IF_ERROR( filter_queue < 0, "invalid filter queue depth `%s'\n", optarg )
+                break;
             case OPT_QUIET:
                 cli_log_level = param->i_log_level = X264_LOG_NONE;
                 break;
@@ -1508,6 +1730,9 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
             case OPT_VIDEO_FILTER:
                 vid_filters = optarg;
                 break;
+            case OPT_LADDER:
+                ladder = optarg;
+                break;
             case OPT_INPUT_FMT:
                 input_opt.format = optarg;
                 break;
@@ -1606,6 +1831,9 @@ generic_option:
     info.vfr        = param->b_vfr_input;
 
     input_opt.seek = opt->i_seek;
+    /* the chunk is located in the stats by frame number, so the input must start there too */
+    FAIL_IF_ERROR( param->rc.b_stat_read && param->rc.i_chunk_start >= 0 && param->rc.i_chunk_start != opt->i_seek,
+                   "--chunk-start %d does not match --seek %d\n", param->rc.i_chunk_start, opt->i_seek )
     input_opt.progress = opt->b_progress;
     input_opt.output_csp = output_csp;
 
@@ -1630,11 +1858,23 @@ generic_option:
     else FAIL_IF_ERROR( !info.vfr && input_opt.timebase, "--timebase is incompatible with cfr input\n" )
 
     /* init threaded input while the information about the input video is unaltered by filtering */
+    int b_threaded_input = HAVE_THREAD && info.thread_safe && (b_thread_input || param->i_threads > 1
+        || (param->i_threads == X264_THREADS_AUTO && x264_cpu_num_processors() > 1));
+    if( input_opt.read_ahead && !b_threaded_input )
+        x264_cli_log( "x264", X264_LOG_WARNING, "--read-ahead ignored, %s\n",
+                      !HAVE_THREAD ? "not compiled with thread support" :
+                      !info.thread_safe ? "the input cannot be read in its own thread" :
+                      "the input is not threaded (use --thread-input)" );
 #if HAVE_THREAD
-    if( info.thread_safe && (b_thread_input || param->i_threads > 1
-        || (param->i_threads == X264_THREADS_AUTO && x264_cpu_num_processors() > 1)) )
+    if( b_threaded_input )
     {
-        if( thread_input.open_file( NULL, &opt->hin, &info, NULL ) )
+        /* by default keep roughly one frame queued for every four encoder threads */
+        if( !input_opt.read_ahead )
+        {
+            int threads = param->i_threads == X264_THREADS_AUTO ? x264_cpu_num_processors() : param->i_threads;
+            input_opt.read_ahead = x264_clip3( threads / 4, 1, 8 );
+        }
+        if( thread_input.open_file( NULL, &opt->hin, &info, &input_opt ) )
         {
             fprintf( stderr, "x264 [error]: threaded input failed\n" );
             return -1;
@@ -1686,7 +1926,10 @@ generic_option:
     if( input_opt.input_range != RANGE_AUTO )
         info.fullrange = input_opt.input_range;
 
-    if( init_vid_filters( vid_filters, &opt->hin, &info, param, output_csp ) )
+    /* by default run the filter stages concurrently when the encoder is threaded */
+    if( filter_queue < 0 )
+        filter_queue = HAVE_THREAD && (param->i_threads > 1 || (param->i_threads == X264_THREADS_AUTO && x264_cpu_num_processors() > 1)) ? 2 : 0;
+    if( init_vid_filters( vid_filters, &opt->hin, &info, param, output_csp, filter_queue ) )
         return -1;
 
     /* set param flags from the post-filtered video */
@@ -1740,6 +1983,9 @@ generic_option:
             }
     }
 
+    if( ladder && init_ladder( ladder, opt, param, &info, output_filename, &output_opt ) )
+        return -1;
+
     return 0;
 }
 
@@ -1781,7 +2027,20 @@ static void parse_qpfile( cli_opt_t *opt, x264_picture_t *pic, int i_frame )
     }
 }
 
-static int encode_frame( x264_t *h, hnd_t hout, x264_picture_t *pic, int64_t *last_dts, cli_opt_t *opt )
+static void ladder_set_type( cli_ladder_t *ladder, x264_picture_t *pic_out )
+{
+    for( int i = 0; i < ladder->i_size; i++ )
+    {
+        ladder_frame_t *frame = &ladder->frames[(ladder->i_head + i) % ladder->i_max_frames];
+        if( frame->i_pts == pic_out->i_pts )
+        {
+            frame->i_type = pic_out->i_type;
+            return;
+        }
+    }
+}
+
+static int encode_frame( x264_t *h, hnd_t hout, x264_picture_t *pic, int64_t *last_dts, cli_ladder_t *ladder )
 {
     x264_picture_t pic_out;
     x264_nal_t *nal;
@@ -1796,6 +2055,9 @@ static int encode_frame( x264_t *h, hnd_t hout, x264_picture_t *pic, int64_t *la
     {
         i_frame_size = cli_output.write_frame( hout, nal[0].p_payload, i_frame_size, &pic_out );
         *last_dts = pic_out.i_dts;
+        /* the top rung of a ladder decides the frame types of the others */
+        if( ladder )
+            ladder_set_type( ladder, &pic_out );
     }
 
     return i_frame_size;
@@ -1838,6 +2100,139 @@ static void convert_cli_to_lib_pic( x264_picture_t *lib, cli_pic_t *cli )
     lib->i_pts = cli->pts;
 }
 
+static int ladder_open( cli_ladder_t *ladder, x264_t *h, x264_param_t *param )
+{
+    /* frames stay queued from their input until the top rung outputs them,
+     * plus the frames decided out of display order ahead of them */
+    ladder->i_max_frames = x264_encoder_maximum_delayed_frames( h ) + param->i_bframe + 2;
+    ladder->frames = calloc( ladder->i_max_frames, sizeof(ladder_frame_t) );
+    FAIL_IF_ERROR( !ladder->frames, "malloc failed\n" )
+    for( int r = 0; r < ladder->i_rungs; r++ )
+    {
+        ladder_rung_t *rung = &ladder->rung[r];
+        rung->param.b_pulldown     = param->b_pulldown;
+        rung->param.b_pic_struct   = param->b_pic_struct;
+        rung->param.i_timebase_num = param->i_timebase_num;
+        rung->param.i_timebase_den = param->i_timebase_den;
+        rung->h = x264_encoder_open( &rung->param );
+        FAIL_IF_ERROR( !rung->h, "x264_encoder_open failed for the %dx%d rung\n", rung->param.i_width, rung->param.i_height )
+        x264_encoder_parameters( rung->h, &rung->param );
+        FAIL_IF_ERROR( cli_output.set_param( rung->hout, &rung->param ), "can't set outfile param\n" )
+        if( !rung->param.b_repeat_headers )
+        {
+            x264_nal_t *headers;
+            int i_nal;
+            FAIL_IF_ERROR( x264_encoder_headers( rung->h, &headers, &i_nal ) < 0, "x264_encoder_headers failed\n" )
+            FAIL_IF_ERROR( (rung->i_file = cli_output.write_headers( rung->hout, headers )) < 0,
+                           "error writing headers to output file\n" )
+        }
+        for( int i = 0; i < ladder->i_max_frames; i++ )
+            FAIL_IF_ERROR( x264_cli_pic_alloc( &ladder->frames[i].pic[r], rung->i_csp, rung->param.i_width, rung->param.i_height ),
+                           "malloc failed\n" )
+    }
+    return 0;
+}
+
+/* Resizes the top rung's frame for every lower rung and queues it until its type is known. */
+static int ladder_push( cli_ladder_t *ladder, cli_pic_t *cli_pic, x264_picture_t *pic, int i_frame )
+{
+    FAIL_IF_ERROR( ladder->i_size == ladder->i_max_frames, "ladder frame queue overflow\n" )
+    ladder_frame_t *frame = &ladder->frames[(ladder->i_head + ladder->i_size) % ladder->i_max_frames];
+    ladder->source = cli_pic;
+    for( int r = 0; r < ladder->i_rungs; r++ )
+    {
+        ladder_rung_t *rung = &ladder->rung[r];
+        cli_pic_t out;
+        if( rung->filter.get_frame( rung->hin, &out, i_frame ) ||
+            x264_cli_pic_copy( &frame->pic[r], &out ) ||
+            rung->filter.release_frame( rung->hin, &out, i_frame ) )
+            return -1;
+    }
+    frame->i_pts = pic->i_pts;
+    frame->i_pic_struct = pic->i_pic_struct;
+    frame->i_type = X264_TYPE_AUTO;
+    ladder->i_size++;
+    return 0;
+}
+
+static int ladder_encode_frame( ladder_rung_t *rung, x264_picture_t *pic )
+{
+    int i_frame_size = encode_frame( rung->h, rung->hout, pic, &rung->last_dts, NULL );
+    if( i_frame_size < 0 )
+        return -1;
+    if( i_frame_size )
+    {
+        rung->i_file += i_frame_size;
+        rung->i_frame_output++;
+    }
+    return 0;
+}
+
+/* Encodes the queued frames whose type the top rung has decided, in display order.
+ * When flushing, encodes all of them and the lower rungs' delayed frames. */
+static int ladder_encode( cli_ladder_t *ladder, int b_flush )
+{
+    while( ladder->i_size && (b_flush || ladder->frames[ladder->i_head].i_type != X264_TYPE_AUTO) )
+    {
+        ladder_frame_t *frame = &ladder->frames[ladder->i_head];
+        for( int r = 0; r < ladder->i_rungs; r++ )
+        {
+            x264_picture_t pic;
+            x264_picture_init( &pic );
+            convert_cli_to_lib_pic( &pic, &frame->pic[r] );
+            pic.i_pts = frame->i_pts;
+            pic.i_pic_struct = frame->i_pic_struct;
+            pic.i_type = frame->i_type;
+            if( ladder_encode_frame( &ladder->rung[r], &pic ) )
+                return -1;
+        }
+        ladder->i_head = (ladder->i_head + 1) % ladder->i_max_frames;
+        ladder->i_size--;
+    }
+    if( b_flush )
+        for( int r = 0; r < ladder->i_rungs; r++ )
+            while( x264_encoder_delayed_frames( ladder->rung[r].h ) )
+                if( ladder_encode_frame( &ladder->rung[r], NULL ) )
+                    return -1;
+    return 0;
+}
+
+static void ladder_close( cli_ladder_t *ladder, int64_t largest_pts, int64_t second_largest_pts, double duration )
+{
+    for( int r = 0; r < ladder->i_rungs; r++ )
+    {
+        ladder_rung_t *rung = &ladder->rung[r];
+        if( rung->h )
+            x264_encoder_close( rung->h );
+        rung->h = NULL;
+        if( rung->hout )
+            cli_output.close_file( rung->hout, largest_pts, second_largest_pts );
+        rung->hout = NULL;
+        if( rung->i_frame_output > 0 )
+            fprintf( stderr, "ladder %dx%d: encoded %d frames, %.2f kb/s\n", rung->param.i_width, rung->param.i_height,
+                     rung->i_frame_output, (double)rung->i_file * 8 / (1000 * duration) );
+    }
+}
+
+static void ladder_free( cli_ladder_t *ladder )
+{
+    for( int r = 0; r < ladder->i_rungs; r++ )
+    {
+        ladder_rung_t *rung = &ladder->rung[r];
+        if( rung->filter.free )
+            rung->filter.free( rung->hin );
+        if( rung->h )
+            x264_encoder_close( rung->h );
+        if( rung->hout )
+            cli_output.close_file( rung->hout, 0, 0 );
+        for( int i = 0; i < ladder->i_max_frames; i++ )
+            x264_cli_pic_clean( &ladder->frames[i].pic[r] );
+        free( rung->psz_output );
+    }
+    free( ladder->frames );
+    free( ladder );
+}
+
 #define FAIL_IF_ERROR2( cond, ... )\
 if( cond )\
 {\
@@ -1908,6 +2303,12 @@ static int encode( x264_param_t *param, cli_opt_t *opt, int argc, char **argv )
         FAIL_IF_ERROR2( (i_file = cli_output.write_headers( opt->hout, headers )) < 0, "error writing headers to output file\n" );
     }
 
+    if( opt->ladder && ladder_open( opt->ladder, h, param ) )
+    {
+        retval = -1;
+        goto fail;
+    }
+
     if( opt->tcfile_out )
         fprintf( opt->tcfile_out, "# timecode format v2\n" );
 
@@ -1951,8 +2352,11 @@ static int encode( x264_param_t *param, cli_opt_t *opt, int argc, char **argv )
             parse_qpfile( opt, &pic, i_frame + opt->i_seek );
 
         prev_dts = last_dts;
-        i_frame_size = encode_frame( h, opt->hout, &pic, &last_dts, opt );
-        if( i_frame_size < 0 )
+        if( opt->ladder && ladder_push( opt->ladder, &cli_pic, &pic, i_frame + opt->i_seek ) )
+            i_frame_size = -1;
+        else
+            i_frame_size = encode_frame( h, opt->hout, &pic, &last_dts, opt->ladder );
+        if( i_frame_size < 0 || (opt->ladder && ladder_encode( opt->ladder, 0 )) )
         {
             b_ctrl_c = 1; /* lie to exit the loop */
             retval = -1;
@@ -1976,7 +2380,7 @@ static int encode( x264_param_t *param, cli_opt_t *opt, int argc, char **argv )
     while( !b_ctrl_c && x264_encoder_delayed_frames( h ) )
     {
         prev_dts = last_dts;
-        i_frame_size = encode_frame( h, opt->hout, NULL, &last_dts, opt );
+        i_frame_size = encode_frame( h, opt->hout, NULL, &last_dts, opt->ladder );
         if( i_frame_size < 0 )
         {
             b_ctrl_c = 1; /* lie to exit the loop */
@@ -1992,6 +2396,9 @@ static int encode( x264_param_t *param, cli_opt_t *opt, int argc, char **argv )
         if( opt->b_progress && i_frame_output )
             i_previous = print_status( i_start, i_previous, i_frame_output, param->i_frame_total, i_file, param, 2 * last_dts - prev_dts - first_dts );
     }
+    /* the top rung has decided every frame type, finish the lower rungs */
+    if( !b_ctrl_c && opt->ladder && ladder_encode( opt->ladder, 1 ) )
+        retval = -1;
 fail:
     if( pts_warning_cnt >= MAX_PTS_WARNING && cli_log_level < X264_LOG_DEBUG )
         x264_cli_log( "x264", X264_LOG_WARNING, "%d suppressed nonmonotonic pts warnings\n", pts_warning_cnt-MAX_PTS_WARNING );
@@ -2030,6 +2437,8 @@ fail:
         fprintf( stderr, "encoded %d frames, %.2f fps, %.2f kb/s\n", i_frame_output, fps,
                  (double) i_file * 8 / ( 1000 * duration ) );
     }
+    if( opt->ladder )
+        ladder_close( opt->ladder, largest_pts, second_largest_pts, duration );
 
     return retval;
 }
@@ -45,7 +45,7 @@ extern "C" {
 
 #include "x264_config.h"
 
-#define X264_BUILD 148
+#define X264_BUILD 150
 
 /* Application developers planning to link against a shared library version of
  * libx264 from a Microsoft Visual Studio or similar development environment
@@ -152,6 +152,7 @@ typedef struct x264_nal_t
                                              * new SLOW flags. */
 #define X264_CPU_SLOW_PSHUFB     0x2000000  /* such as on the Intel Atom */
 #define X264_CPU_SLOW_PALIGNR    0x4000000  /* such as on the AMD Bobcat */
+#define X264_CPU_AVX512          0x8000000  /* AVX-512 {F, CD, BW, DQ, VL}, requires OS support */
 
 /* PowerPC */
 #define X264_CPU_ALTIVEC         0x0000001
@@ -180,6 +181,7 @@ typedef struct x264_nal_t
 #define X264_ME_UMH                  2
 #define X264_ME_ESA                  3
 #define X264_ME_TESA                 4
+#define X264_ME_PYR                  5
 #define X264_CQM_FLAT                0
 #define X264_CQM_JVT                 1
 #define X264_CQM_CUSTOM              2
@@ -204,7 +206,7 @@ typedef struct x264_nal_t
 #define X264_KEYINT_MAX_INFINITE     (1<<30)
 
 static const char * const x264_direct_pred_names[] = { "none", "spatial", "temporal", "auto", 0 };
-static const char * const x264_motion_est_names[] = { "dia", "hex", "umh", "esa", "tesa", 0 };
+static const char * const x264_motion_est_names[] = { "dia", "hex", "umh", "esa", "tesa", "pyr", 0 };
 static const char * const x264_b_pyramid_names[] = { "none", "strict", "normal", 0 };
 static const char * const x264_overscan_names[] = { "undef", "show", "crop", 0 };
 static const char * const x264_vidformat_names[] = { "component", "pal", "ntsc", "secam", "mac", "undef", 0 };
@@ -284,6 +286,9 @@ typedef struct x264_param_t
     int         b_deterministic; /* whether to allow non-deterministic optimizations when threaded */
     int         b_cpu_independent; /* force canonical behavior rather than cpu-dependent optimal algorithms */
     int         i_sync_lookahead; /* threaded lookahead buffer */
+    int         i_frame_pool_budget; /* max MiB of idle frame buffers kept for reuse, 0 = unlimited */
+    int         b_huge_pages;  /* back frame buffers with explicit (hugetlbfs) huge pages when available */
+    int         i_numa_node;   /* run encoder threads and place frame buffers on this NUMA node, -1 = any */
 
     /* Video Properties */
     int         i_width;
@@ -381,8 +386,10 @@ typedef struct x264_param_t
         int          i_subpel_refine; /* subpixel motion estimation quality */
         int          b_chroma_me; /* chroma ME for subpel and mode decision in P-frames */
         int          b_mixed_references; /* allow each mb partition to have its own reference number */
+        int          b_me_multiref; /* rank the references of P and B list 0 16x16 searches together and skip unlikely ones */
         int          i_trellis;  /* trellis RD quantization */
         int          b_fast_pskip; /* early SKIP detection on P-frames */
+        int          b_adaptive_partitions; /* skip P-frame sub-16x16 partition searches that rarely pay off, learned while encoding */
         int          b_dct_decimate; /* transform coefficient thresholding on P-frames */
         int          i_noise_reduction; /* adaptive pseudo-deadzone */
         float        f_psy_rd; /* Psy RD strength */
@@ -433,6 +440,9 @@ typedef struct x264_param_t
         char        *psz_stat_out;  /* output filename (in UTF-8) of the 2pass stats file */
         int         b_stat_read;    /* Read stat from psz_stat_in and use it */
         char        *psz_stat_in;   /* input filename (in UTF-8) of the 2pass stats file */
+        int         b_stat_binary;  /* Write the stats file in the binary format (both formats can be read) */
+        int         i_chunk_start;  /* Encode the chunk of the 1st pass starting at this frame, with i_frame_total frames.
+                                     * -1 = off.  The input must start at the same frame. */
 
         /* 2pass params (same as ffmpeg ones) */
         float       f_qcompress;    /* 0.0 => cbr, 1.0 => constant qp */
@@ -552,8 +562,50 @@ typedef struct x264_param_t
      */
     void (*nalu_process) ( x264_t *h, x264_nal_t *nal, void *opaque );
 
-    int         i_csv_log_level; /* Level of csv logging. */
+    /* Optional zero-copy output ring, owned by the caller.
+     *
+     * When set, each NAL unit is escaped straight into this memory as soon as it is
+     * finished, instead of being copied into an internal buffer when the frame completes.
+     * NALs are placed one after another and the write position wraps back to the start
+     * of the ring whenever the next NAL might not fit before the end.  The data of a NAL
+     * remains valid until the ring wraps around onto it, so the caller must consume it
+     * before that happens; the ring must also be larger than the largest escaped NAL.
+     *
+     * If nalu_process is also set, the NALs passed to it are already encoded and it must
+     * not call x264_nal_encode.  The NALs returned by x264_encoder_encode and
+     * x264_encoder_headers point into the ring as well, except when the ring wrapped
+     * between them (or slice threads finished out of order): their payloads are then
+     * copied into the usual internal buffer, so that they stay sequential in memory.
+     * Everything returned by one call must fit in the ring, or its first NALs are
+     * overwritten before the call returns.
+     *
+     * Like nalu_process, this does not work with frame-based threads or AVC-Intra. */
+    uint8_t *p_nal_ring;
+    int     i_nal_ring_size;
+
+    int         i_csv_log_level; /* Level of csv logging: 1 = per-frame stats, 2 = also per-stage timings. */
     const char* csv_filename;    /* filename of CSV log. */
+
+    /* Analysis reuse between encodes of the same content, e.g. the renditions of an ABR ladder.
+     * psz_analysis_save writes the final mode, references and motion vectors of every macroblock
+     * to a file.  psz_analysis_load reads such a file, possibly written at another resolution, and
+     * uses it to seed the motion search of P-frames: the 16x16 search only tries the saved
+     * reference, starting from the saved motion vector (scaled to the current resolution), and
+     * the macroblock's searches use at most a hexagon.  The frames must be the same in both encodes;
+     * hints are only used where the frame types also match. */
+    char        *psz_analysis_save;
+    char        *psz_analysis_load;
+
+    /* Lookahead reuse between encodes of the same source at different bitrates.
+     * psz_lookahead_save writes the frame types, lowres costs, mb-tree qp offsets, weighted
+     * prediction weights, VBV plans and the lowres mvs of the first references decided by the
+     * lookahead to a file.  psz_lookahead_load takes all of them from such a file instead of
+     * running the lookahead.  The settings the lookahead depends on (frame type decision,
+     * mb-tree, aq, weightp, fps) must be the same in both encodes; the source is checked
+     * against a hash of each frame.  With the same settings the loaded encode is identical,
+     * except with X264_ME_PYR and B-frames, which seeds from lowres mvs that aren't saved. */
+    char        *psz_lookahead_save;
+    char        *psz_lookahead_load;
 } x264_param_t;
 
 void x264_nal_encode( x264_t *h, uint8_t *dst, x264_nal_t *nal );
@@ -727,6 +779,11 @@ typedef struct x264_stats_t
     double  f_encode_time;
     double  f_fps;
     int     i_frame_count[3];
+    /* Frame threading stalls on reference rows that were not yet encoded */
+    int64_t i_stall_count;
+    int     i_stall_frames;    /* frames that stalled at least once */
+    double  f_stall_time;      /* milliseconds */
+    int     i_stall_mvy_range; /* smallest vertical mv range (pixels) available when a stall began */
 } x264_stats_t;
 
 /* Arbitrary user SEI:
@@ -839,8 +896,36 @@ typedef struct x264_frame_stats_t
     int             i_mb_count[19];
     uint16_t        i_max_luma_level;
     uint16_t        i_min_luma_level;
+    /* Frame threading stalls on reference rows */
+    int             i_stall_count;
+    int             i_stall_mvy_range;
+    double          f_stall_time;  /* milliseconds */
+    /* Wall-clock time per stage in milliseconds, only collected when i_csv_log_level >= 2.
+     * Analyse excludes the time spent waiting on reference frame rows, which is in wait. */
+    double          f_lookahead_time;
+    double          f_analyse_time;
+    double          f_encode_time;
+    double          f_entropy_time;
+    double          f_filter_time;
+    double          f_wait_time;
 } x264_frame_stats_t;
 
+/* Frame buffer pool statistics, indexed by X264_FRAME_POOL_* */
+#define X264_FRAME_POOL_FENC  0 /* input frames, including lowres and mbtree data */
+#define X264_FRAME_POOL_FDEC  1 /* reconstructed/reference frames */
+#define X264_FRAME_POOL_BLANK 2 /* duplicate frame headers for weightp */
+typedef struct x264_frame_pool_stats_t
+{
+    int64_t i_budget;        /* bytes of idle frames that may be kept for reuse, 0 = unlimited */
+    int64_t i_pooled_bytes;  /* bytes of idle frames currently kept for reuse */
+    int64_t i_peak_bytes;    /* peak of the total allocated bytes */
+    int64_t i_bytes[3];      /* currently allocated bytes */
+    int     i_frames[3];     /* currently allocated frames */
+    int64_t i_allocs[3];     /* requests served by a new allocation */
+    int64_t i_reuses[3];     /* requests served from the pool */
+    int64_t i_evictions[3];  /* idle frames freed to bring the pool back under the budget */
+} x264_frame_pool_stats_t;
+
 typedef struct x264_picture_t
 {
     /* In: force picture type (if not auto)
@@ -887,6 +972,9 @@ typedef struct x264_picture_t
 	int poc;
     /* Frame level statistics */
     x264_frame_stats_t frameData;
+    /* Private: the encoder frame backing img when obtained from x264_encoder_input_picture_get,
+     * NULL otherwise.  Do not modify. */
+    void *input_frame;
 } x264_picture_t;
 
 /* x264_picture_init:
@@ -941,6 +1029,9 @@ int     x264_encoder_reconfig( x264_t *, x264_param_t * );
  *      note that the data accessible through pointers in the returned param struct
  *      (e.g. filenames) should not be modified by the calling application. */
 void    x264_encoder_parameters( x264_t *, x264_param_t * );
+/* x264_encoder_frame_pool_stats:
+ *      fill stats with the memory accounting and reuse counters of the encoder's frame buffer pool. */
+void    x264_encoder_frame_pool_stats( x264_t *, x264_frame_pool_stats_t *stats );
 /* x264_encoder_headers:
  *      return the SPS and PPS that will be used for the whole stream.
  *      *pi_nal is the number of NAL units outputted in pp_nal.
@@ -1007,6 +1098,22 @@ void    x264_encoder_intra_refresh( x264_t * );
  *
  *      Returns 0 on success, negative on failure. */
 int x264_encoder_invalidate_reference( x264_t *, int64_t pts );
+/* x264_encoder_input_picture_get:
+ *      zero-copy input.  Initializes pic with planes pointing directly into a padded frame buffer
+ *      owned by the encoder, so that x264_encoder_encode does not have to copy the input image.
+ *      pic->img.i_csp is set to the encoder's internal colorspace (X264_CSP_NV12, X264_CSP_NV16 or
+ *      X264_CSP_I444, plus X264_CSP_HIGH_DEPTH in high bit depth builds) and the image must be written
+ *      in that layout using the returned strides.  Fill in the image and any other input fields, then
+ *      pass pic as pic_in to x264_encoder_encode, which takes the buffer back.
+ *
+ *      A picture that will not be encoded must be handed back with x264_encoder_input_picture_release.
+ *      Multiple pictures may be outstanding at once.  Should not be called during an x264_encoder_encode.
+ *
+ *      Returns 0 on success, negative on failure. */
+int x264_encoder_input_picture_get( x264_t *, x264_picture_t *pic );
+/* x264_encoder_input_picture_release:
+ *      return a picture obtained from x264_encoder_input_picture_get without encoding it. */
+void x264_encoder_input_picture_release( x264_t *, x264_picture_t *pic );
 
 #ifdef __cplusplus
 }